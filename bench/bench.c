@@ -0,0 +1,300 @@
+// bench/bench.c - benchmark harness for EZC, which runs representative
+//                   workloads through `ec` and reports timings
+//
+// Each benchmark is ran as a separate `ec` process (with its output sent to
+//   /dev/null), a few times to warm up, then `-n` times to measure. The median
+//   and 99th percentile wall times are reported, along with operations per
+//   second (where an `op` is a unit of work specific to each workload, like a
+//   function call or a loop iteration)
+//
+// Results can be saved with `--json FILE`, and compared against a previous
+//   run with `--baseline FILE`, in which case any benchmark whose median is
+//   slower by more than `--threshold` percent is flagged, and the exit code
+//   is nonzero
+//
+// Usage: bench/bench [-n reps] [-w warmup] [--ec path] [--json out.json]
+//                    [--baseline base.json] [--threshold pct] [names...]
+//
+// @author   : Cade Brown <cade@chemicaldevelopment.us>
+// @license  : WTFPL (http://www.wtfpl.net/)
+// @date     : 2019-12-05
+//
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+// number of `-e` programs passed to `ec` for the `small_e` benchmark
+#define SMALL_E_N 20000
+
+// maximum number of benchmarks in a baseline
+#define MAX_BENCH 64
+
+// a single benchmark
+typedef struct {
+    // name of the benchmark (used for filtering, and in baselines)
+    const char* name;
+    // the file in `bench/` to run, or NULL for the `-e` programs
+    const char* file;
+    // number of operations the workload performs, for reporting ops/sec
+    double ops;
+    // what an `op` is
+    const char* op_name;
+} bench_t;
+
+// the workloads (see the `.ezc` files for what each one does)
+static bench_t benches[] = {
+    { "fib",     "fib.ezc",     150049,  "calls" },
+    { "gcd",     "gcd.ezc",     30000,   "gcds" },
+    { "fact",    "fact.ezc",    420000,  "calls" },
+    { "sqrt",    "sqrt.ezc",    100000,  "sqrts" },
+    { "reduce",  "reduce.ezc",  1500000, "items" },
+    { "strcat",  "strcat.ezc",  200000,  "appends" },
+    { "deep",    "deep.ezc",    2200000, "items" },
+    { "small_e", NULL,          SMALL_E_N, "programs" },
+};
+
+#define N_BENCHES ((int)(sizeof(benches) / sizeof(benches[0])))
+
+// results from a previous run
+typedef struct {
+    char name[64];
+    double median;
+} baseline_t;
+
+/* timing */
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1.0e-9 * ts.tv_nsec;
+}
+
+// runs `argv` to completion (with stdout/stderr to /dev/null), and returns the
+//   wall time in seconds, or a negative number if it failed
+static double run_once(char** argv) {
+    double st = now();
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return -1;
+    } else if (pid == 0) {
+        int devnull = open("/dev/null", O_WRONLY);
+        if (devnull >= 0) {
+            dup2(devnull, STDOUT_FILENO);
+            dup2(devnull, STDERR_FILENO);
+            close(devnull);
+        }
+        execv(argv[0], argv);
+        _exit(127);
+    }
+
+    int wstatus = 0;
+    if (waitpid(pid, &wstatus, 0) < 0) {
+        perror("waitpid");
+        return -1;
+    }
+    double el = now() - st;
+    if (!WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != 0) {
+        return -1;
+    }
+    return el;
+}
+
+static int cmp_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// returns the `q`th quantile (0 <= q <= 1) of sorted `v[0:n]`
+static double quantile(double* v, int n, double q) {
+    double pos = q * (n - 1);
+    int lo = (int)pos;
+    if (lo >= n - 1) return v[n - 1];
+    double fr = pos - lo;
+    return v[lo] * (1 - fr) + v[lo + 1] * fr;
+}
+
+/* baselines */
+
+// reads a JSON file written by `--json`. This only understands our own
+//   format, which has one benchmark per line
+static int read_baseline(const char* fname, baseline_t* base) {
+    FILE* fp = fopen(fname, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "bench: couldn't open baseline '%s'\n", fname);
+        return -1;
+    }
+    int n = 0;
+    char line[1024];
+    while (n < MAX_BENCH && fgets(line, sizeof(line), fp) != NULL) {
+        char* pn = strstr(line, "\"name\":");
+        char* pm = strstr(line, "\"median\":");
+        if (pn == NULL || pm == NULL) continue;
+        if (sscanf(pn, "\"name\": \"%63[^\"]\"", base[n].name) != 1) continue;
+        if (sscanf(pm, "\"median\": %lf", &base[n].median) != 1) continue;
+        n++;
+    }
+    fclose(fp);
+    return n;
+}
+
+static baseline_t* find_baseline(baseline_t* base, int n, const char* name) {
+    int i;
+    for (i = 0; i < n; ++i) {
+        if (strcmp(base[i].name, name) == 0) return &base[i];
+    }
+    return NULL;
+}
+
+int main(int argc, char** argv) {
+    int reps = 10, warmup = 2;
+    double threshold = 5.0;
+    const char* ec = "./ec/ec";
+    const char* dir = "./bench";
+    const char* json_out = NULL;
+    const char* baseline_file = NULL;
+
+    // names to run (all if none given)
+    const char** only = malloc(sizeof(char*) * argc);
+    int n_only = 0;
+
+    int i, j;
+    for (i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            reps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            warmup = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--ec") == 0 && i + 1 < argc) {
+            ec = argv[++i];
+        } else if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc) {
+            dir = argv[++i];
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_out = argv[++i];
+        } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baseline_file = argv[++i];
+        } else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            threshold = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            printf("Usage: %s [-n reps] [-w warmup] [--ec path] [--dir benchdir] [--json out.json] [--baseline base.json] [--threshold pct] [names...]\n", argv[0]);
+            return 0;
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "bench: unknown option '%s'\n", argv[i]);
+            return 1;
+        } else {
+            only[n_only++] = argv[i];
+        }
+    }
+    if (reps < 1) reps = 1;
+
+    baseline_t base[MAX_BENCH];
+    int n_base = 0;
+    if (baseline_file != NULL) {
+        n_base = read_baseline(baseline_file, base);
+        if (n_base < 0) return 1;
+    }
+
+    FILE* jfp = NULL;
+    if (json_out != NULL) {
+        jfp = fopen(json_out, "w");
+        if (jfp == NULL) {
+            fprintf(stderr, "bench: couldn't open '%s'\n", json_out);
+            return 1;
+        }
+        fprintf(jfp, "{\"reps\": %d, \"benchmarks\": [\n", reps);
+    }
+
+    // the argument list for `small_e`
+    char** small_argv = malloc(sizeof(char*) * (2 * SMALL_E_N + 2));
+    char** small_progs = malloc(sizeof(char*) * SMALL_E_N);
+    small_argv[0] = (char*)ec;
+    for (i = 0; i < SMALL_E_N; ++i) {
+        small_progs[i] = malloc(64);
+        snprintf(small_progs[i], 64, "%d :* %d + %d %%", i, i + 1, 97);
+        small_argv[1 + 2 * i] = "-e";
+        small_argv[2 + 2 * i] = small_progs[i];
+    }
+    small_argv[1 + 2 * SMALL_E_N] = NULL;
+
+    double* times = malloc(sizeof(double) * reps);
+
+    printf("%-10s %12s %12s %16s\n", "benchmark", "median (ms)", "p99 (ms)", "ops/sec");
+    int n_regress = 0, n_json = 0, n_failed = 0;
+    for (i = 0; i < N_BENCHES; ++i) {
+        bench_t* b = &benches[i];
+        if (n_only > 0) {
+            for (j = 0; j < n_only && strcmp(only[j], b->name) != 0; ++j);
+            if (j == n_only) continue;
+        }
+
+        char path[1024];
+        char* file_argv[3];
+        char** run_argv = small_argv;
+        if (b->file != NULL) {
+            snprintf(path, sizeof(path), "%s/%s", dir, b->file);
+            file_argv[0] = (char*)ec;
+            file_argv[1] = path;
+            file_argv[2] = NULL;
+            run_argv = file_argv;
+        }
+
+        bool failed = false;
+        for (j = 0; j < warmup + reps; ++j) {
+            double t = run_once(run_argv);
+            if (t < 0) {
+                failed = true;
+                break;
+            }
+            if (j >= warmup) times[j - warmup] = t;
+        }
+        if (failed) {
+            printf("%-10s FAILED (couldn't run '%s')\n", b->name, b->file != NULL ? path : "-e ...");
+            n_failed++;
+            continue;
+        }
+
+        qsort(times, reps, sizeof(double), cmp_double);
+        double med = quantile(times, reps, 0.5), p99 = quantile(times, reps, 0.99);
+        printf("%-10s %12.3f %12.3f %16.0f", b->name, 1e3 * med, 1e3 * p99, b->ops / med);
+
+        if (n_base > 0) {
+            baseline_t* bb = find_baseline(base, n_base, b->name);
+            if (bb != NULL && bb->median > 0) {
+                double pct = 100.0 * (med - bb->median) / bb->median;
+                printf("  %+7.2f%%", pct);
+                if (pct > threshold) {
+                    printf("  REGRESSION");
+                    n_regress++;
+                }
+            } else {
+                printf("  (no baseline)");
+            }
+        }
+        printf("\n");
+
+        if (jfp != NULL) {
+            fprintf(jfp, "%s  {\"name\": \"%s\", \"median\": %.9f, \"p99\": %.9f, \"ops_per_sec\": %.3f, \"op\": \"%s\"}",
+                n_json > 0 ? ",\n" : "", b->name, med, p99, b->ops / med, b->op_name);
+            n_json++;
+        }
+    }
+
+    if (jfp != NULL) {
+        fprintf(jfp, "\n]}\n");
+        fclose(jfp);
+    }
+
+    if (n_regress > 0) {
+        printf("\n%d benchmark(s) regressed by more than %.1f%%\n", n_regress, threshold);
+    }
+
+    return (n_regress > 0 || n_failed > 0) ? 1 : 0;
+}
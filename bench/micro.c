@@ -0,0 +1,532 @@
+// bench/micro.c - microbenchmarks for libezc's core primitives: stacks,
+//                   strings, function lookup and calls, the parser, and
+//                   array kernels
+//
+// Each benchmark is calibrated so a single sample takes at least `-t`
+//   milliseconds, then `-s` samples are taken. Outliers (more than 3 scaled
+//   median absolute deviations from the median) are rejected, and the mean of
+//   the rest is reported along with its relative spread, which should be well
+//   under 5% for comparisons between builds to be meaningful
+//
+// The process is pinned to a single CPU (`-c`, default 0) to avoid migrations
+//
+// Usage: bench/micro [-c cpu] [-s samples] [-t ms] [names...]
+//
+// @author   : Cade Brown <cade@chemicaldevelopment.us>
+// @license  : WTFPL (http://www.wtfpl.net/)
+// @date     : 2019-12-06
+//
+
+// for sched_setaffinity
+#define _GNU_SOURCE
+
+#include "ezc.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#define EZC_MODULE_NAME std
+#include "ezc-module.h"
+
+// maximum number of samples
+#define MAX_SAMPLES 1000
+
+// a value the compiler can't optimize away
+static volatile long g_sink = 0;
+
+// the arguments of each benchmark
+typedef struct {
+    // size parameter (meaning depends on the benchmark)
+    long size;
+    // prepared state (i.e. a VM, a source string)
+    void* state;
+} micro_arg;
+
+// a single benchmark
+typedef struct {
+    // name of the benchmark
+    const char* name;
+    // runs `iters` iterations of the benchmark
+    void (*f_run)(long iters, micro_arg* arg);
+    // the size parameter
+    long size;
+    // units per iteration (i.e. bytes parsed), for the throughput column
+    double units;
+    // name of the units, or NULL to report ops/sec
+    const char* unit_name;
+    // prepares & frees `arg->state` (can be NULL)
+    void (*f_setup)(micro_arg* arg);
+    void (*f_teardown)(micro_arg* arg);
+} micro_t;
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1.0e-9 * ts.tv_nsec;
+}
+
+static int cmp_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/* ezc_stk */
+
+// pushes `size` objects, then pops them all
+static void run_stk_pushpop(long iters, micro_arg* arg) {
+    ezc_stk stk = EZC_STK_EMPTY;
+    ezc_obj obj = (ezc_obj){ .type = EZC_TYPE_INT, ._int = 1 };
+    long i, j, s = 0;
+    for (i = 0; i < iters; ) {
+        long n = arg->size < iters - i ? arg->size : iters - i;
+        for (j = 0; j < n; ++j) {
+            obj._int = j;
+            ezc_stk_push(&stk, obj);
+        }
+        for (j = 0; j < n; ++j) {
+            s += ezc_stk_pop(&stk)._int;
+        }
+        i += n;
+    }
+    ezc_stk_free(&stk);
+    g_sink += s;
+}
+
+// grows and shrinks the stack by `size` objects at a time
+static void run_stk_resize(long iters, micro_arg* arg) {
+    ezc_stk stk = EZC_STK_EMPTY;
+    long i;
+    for (i = 0; i < iters; ++i) {
+        ezc_stk_resize(&stk, stk.n + arg->size);
+        if (stk.n > 64 * arg->size) ezc_stk_resize(&stk, 0);
+    }
+    g_sink += stk.n;
+    ezc_stk_free(&stk);
+}
+
+/* ezc_str */
+
+// builds a string of `size` characters, one at a time
+static void run_str_append_c(long iters, micro_arg* arg) {
+    ezc_str str = EZC_STR_NULL;
+    long i;
+    for (i = 0; i < iters; ++i) {
+        if (str.len >= arg->size) str.len = 0;
+        ezc_str_append_c(&str, 'a' + (i & 15));
+    }
+    g_sink += str.len;
+    ezc_str_free(&str);
+}
+
+// builds a string of `size` characters, 16 at a time (each one fresh, so
+//   growth is included)
+static void run_str_append(long iters, micro_arg* arg) {
+    ezc_str piece = EZC_STR_CONST("0123456789abcdef");
+    long i;
+    for (i = 0; i < iters; ) {
+        ezc_str str = EZC_STR_NULL;
+        long j;
+        for (j = 0; j < arg->size && i < iters; j += piece.len, ++i) {
+            ezc_str_append(&str, piece);
+        }
+        g_sink += str.len;
+        ezc_str_free(&str);
+    }
+}
+
+// concatenates two strings of `size` characters into a new string
+static void run_str_concat(long iters, micro_arg* arg) {
+    ezc_str* AB = arg->state;
+    long i;
+    for (i = 0; i < iters; ++i) {
+        ezc_str res = EZC_STR_NULL;
+        ezc_str_concat(&res, AB[0], AB[1]);
+        g_sink += res.len;
+        ezc_str_free(&res);
+    }
+}
+
+static void setup_str_concat(micro_arg* arg) {
+    ezc_str* AB = malloc(2 * sizeof(ezc_str));
+    AB[0] = AB[1] = EZC_STR_NULL;
+    long i;
+    for (i = 0; i < arg->size; ++i) {
+        ezc_str_append_c(&AB[0], 'a');
+        ezc_str_append_c(&AB[1], 'b');
+    }
+    arg->state = AB;
+}
+
+static void teardown_str_concat(micro_arg* arg) {
+    ezc_str* AB = arg->state;
+    ezc_str_free(&AB[0]);
+    ezc_str_free(&AB[1]);
+    free(AB);
+}
+
+/* ezc_vm_getfunci */
+
+// the names looked up for `getfunci` (so formatting isn't measured)
+typedef struct {
+    ezc_vm vm;
+    ezc_str* names;
+} getfunci_state;
+
+static int micro_nop(ezc_vm* vm) {
+    return 0;
+}
+
+// a VM with the standard library, plus `size` user functions
+static void setup_getfunci(micro_arg* arg) {
+    getfunci_state* st = malloc(sizeof(getfunci_state));
+    st->vm = EZC_VM_EMPTY;
+    F_std_register_module(&st->vm);
+    st->names = malloc(sizeof(ezc_str) * arg->size);
+    long i;
+    char tmp[64];
+    for (i = 0; i < arg->size; ++i) {
+        snprintf(tmp, sizeof(tmp), "user_func_%ld", i);
+        st->names[i] = EZC_STR_NULL;
+        ezc_str_copy_cp(&st->names[i], tmp, strlen(tmp));
+        ezc_vm_addfunc(&st->vm, st->names[i], EZC_FUNC_C(micro_nop));
+    }
+    arg->state = st;
+}
+
+static void teardown_getfunci(micro_arg* arg) {
+    getfunci_state* st = arg->state;
+    long i;
+    for (i = 0; i < arg->size; ++i) ezc_str_free(&st->names[i]);
+    free(st->names);
+    ezc_vm_free(&st->vm);
+    free(st);
+}
+
+// looks up names spread across the whole table
+static void run_getfunci(long iters, micro_arg* arg) {
+    getfunci_state* st = arg->state;
+    long i, s = 0;
+    for (i = 0; i < iters; ++i) {
+        s += ezc_vm_getfunci(&st->vm, st->names[(i * 7919) % arg->size]);
+    }
+    g_sink += s;
+}
+
+/* ezc_vm_call */
+
+// a VM with a function `sq` defined in EZC, looked up once
+typedef struct {
+    ezc_vm vm;
+    ezcp* prog;
+    ezcp* call_prog;
+    ezc_funcref sq;
+    ezc_obj* args;
+    ezc_obj* res;
+} call_state;
+
+static void setup_call(micro_arg* arg) {
+    call_state* st = malloc(sizeof(call_state));
+    st->vm = EZC_VM_EMPTY;
+    F_std_register_module(&st->vm);
+    st->prog = ezcp_new();
+    ezcp_init(st->prog, EZC_STR_CONST("micro"), EZC_STR_CONST("{:*} sq funcdef!"));
+    ezc_vm_exec(&st->vm, *st->prog);
+    // the same call, as a program
+    st->call_prog = ezcp_new();
+    ezcp_init(st->call_prog, EZC_STR_CONST("micro"), EZC_STR_CONST("3 sq!"));
+    ezc_vm_getfunc(&st->vm, EZC_STR_CONST("sq"), &st->sq);
+    st->args = malloc(sizeof(ezc_obj) * arg->size);
+    st->res = malloc(sizeof(ezc_obj) * arg->size);
+    arg->state = st;
+}
+
+static void teardown_call(micro_arg* arg) {
+    call_state* st = arg->state;
+    ezc_funcref_free(&st->sq);
+    ezcp_decref(st->call_prog);
+    ezcp_decref(st->prog);
+    ezc_vm_free(&st->vm);
+    free(st->args);
+    free(st->res);
+    free(st);
+}
+
+// calls `sq` with one argument, and pops the result
+static void run_call(long iters, micro_arg* arg) {
+    call_state* st = arg->state;
+    long i, s = 0;
+    for (i = 0; i < iters; ++i) {
+        ezc_obj x = (ezc_obj){ .type = EZC_TYPE_INT, ._int = 3 };
+        ezc_vm_call(&st->vm, &st->sq, 1, &x);
+        s += ezc_stk_pop(&st->vm.stk)._int;
+    }
+    g_sink += s;
+}
+
+// same, but by executing the program `3 sq!`
+static void run_call_exec(long iters, micro_arg* arg) {
+    call_state* st = arg->state;
+    long i, s = 0;
+    for (i = 0; i < iters; ++i) {
+        ezc_vm_exec(&st->vm, *st->call_prog);
+        s += ezc_stk_pop(&st->vm.stk)._int;
+    }
+    g_sink += s;
+}
+
+// calls `sq` on `size` arguments at once
+static void run_call_batch(long iters, micro_arg* arg) {
+    call_state* st = arg->state;
+    long i, j, s = 0;
+    for (i = 0; i < iters; ++i) {
+        for (j = 0; j < arg->size; ++j) {
+            st->args[j] = (ezc_obj){ .type = EZC_TYPE_INT, ._int = j };
+        }
+        ezc_vm_call_batch(&st->vm, &st->sq, arg->size, 1, st->args, st->res);
+        s += st->res[arg->size - 1]._int;
+    }
+    g_sink += s;
+}
+
+/* ezcp_init */
+
+// a synthetic source, mixing all the kinds of tokens
+static void setup_parse(micro_arg* arg) {
+    static const char* lines[] = {
+        "{:0== {`1} {:1-my_fact!*} ifel!} my_fact funcdef!\n",
+        "# a comment, which should be skipped quickly by the lexer\n",
+        "12 34+ 5.75 2^ <> _ $ | 10 X! {2*} foreach! print!\n",
+        "\"a string\\twith\\nescapes\" \"and one without\" + repr!\n",
+        "  some_identifier another_one\tthird_ident   :: `` == %\n",
+    };
+    ezc_str* src = malloc(sizeof(ezc_str));
+    *src = EZC_STR_NULL;
+    long i;
+    for (i = 0; src->len < arg->size; ++i) {
+        // NOTE: EZC_STR_CONST evaluates its argument twice
+        const char* line = lines[i % (sizeof(lines) / sizeof(lines[0]))];
+        ezc_str_append(src, EZC_STR_CONST(line));
+    }
+    arg->state = src;
+}
+
+static void teardown_parse(micro_arg* arg) {
+    ezc_str_free(arg->state);
+    free(arg->state);
+}
+
+// parses the source `iters` times
+static void run_parse(long iters, micro_arg* arg) {
+    long i;
+    for (i = 0; i < iters; ++i) {
+        ezcp prog = EZCP_EMPTY;
+        ezcp_init(&prog, EZC_STR_CONST("micro"), *(ezc_str*)arg->state);
+        g_sink += prog.body._block.n;
+        ezcp_free(&prog);
+    }
+}
+
+// same, but borrowing the source instead of copying it
+static void run_parse_borrow(long iters, micro_arg* arg) {
+    long i;
+    for (i = 0; i < iters; ++i) {
+        ezcp prog = EZCP_EMPTY;
+        ezcp_init_borrow(&prog, EZC_STR_CONST("micro"), *(ezc_str*)arg->state);
+        g_sink += prog.body._block.n;
+        ezcp_free(&prog);
+    }
+}
+
+/* ezc_vec_* */
+
+// two arrays of `size` reals, and two of `size` ints
+static void setup_vec(micro_arg* arg) {
+    void** arrs = malloc(4 * sizeof(void*));
+    ezc_real* ra = arrs[0] = malloc(arg->size * sizeof(ezc_real));
+    ezc_real* rb = arrs[1] = malloc(arg->size * sizeof(ezc_real));
+    ezc_int* ia = arrs[2] = malloc(arg->size * sizeof(ezc_int));
+    ezc_int* ib = arrs[3] = malloc(arg->size * sizeof(ezc_int));
+    long i;
+    for (i = 0; i < arg->size; ++i) {
+        ra[i] = 0.5 * i;
+        rb[i] = 1.0 + i;
+        ia[i] = i;
+        ib[i] = 3 * i + 1;
+    }
+    arg->state = arrs;
+}
+
+static void teardown_vec(micro_arg* arg) {
+    void** arrs = arg->state;
+    int i;
+    for (i = 0; i < 4; ++i) free(arrs[i]);
+    free(arrs);
+}
+
+// adds two real arrays, into the first
+static void run_vec_add_real(long iters, micro_arg* arg) {
+    void** arrs = arg->state;
+    long i;
+    for (i = 0; i < iters; ++i) {
+        ezc_vec_real(EZC_VEC_ADD, arg->size, arrs[0], arrs[0], false, arrs[1], false);
+    }
+    g_sink += (long)((ezc_real*)arrs[0])[0];
+}
+
+// adds a scalar to an int array, in place
+static void run_vec_add_int(long iters, micro_arg* arg) {
+    void** arrs = arg->state;
+    ezc_int k = 1;
+    long i;
+    for (i = 0; i < iters; ++i) {
+        ezc_vec_int(EZC_VEC_ADD, arg->size, arrs[2], arrs[2], false, &k, true);
+    }
+    g_sink += (long)((ezc_int*)arrs[2])[0];
+}
+
+// sums a real array (pairwise)
+static void run_vec_sum_real(long iters, micro_arg* arg) {
+    void** arrs = arg->state;
+    ezc_real s = 0.0;
+    long i;
+    for (i = 0; i < iters; ++i) {
+        s += ezc_vec_reduce_real(EZC_VEC_ADD, arg->size, arrs[1]);
+    }
+    g_sink += (long)s;
+}
+
+static micro_t micros[] = {
+    { "stk_pushpop_64",     run_stk_pushpop,   64,      1,        NULL,    NULL, NULL },
+    { "stk_pushpop_64k",    run_stk_pushpop,   65536,   1,        NULL,    NULL, NULL },
+    { "stk_resize_16",      run_stk_resize,    16,      1,        NULL,    NULL, NULL },
+    { "stk_resize_4k",      run_stk_resize,    4096,    1,        NULL,    NULL, NULL },
+    { "str_append_c_64",    run_str_append_c,  64,      1,        NULL,    NULL, NULL },
+    { "str_append_c_64k",   run_str_append_c,  65536,   1,        NULL,    NULL, NULL },
+    { "str_append_1k",      run_str_append,    1024,    16,       "MB/s",  NULL, NULL },
+    { "str_append_1m",      run_str_append,    1 << 20, 16,       "MB/s",  NULL, NULL },
+    { "str_concat_16",      run_str_concat,    16,      32,       "MB/s",  setup_str_concat, teardown_str_concat },
+    { "str_concat_64k",     run_str_concat,    65536,   131072,   "MB/s",  setup_str_concat, teardown_str_concat },
+    { "getfunci_0",         run_getfunci,      1,       1,        NULL,    setup_getfunci, teardown_getfunci },
+    { "getfunci_64",        run_getfunci,      64,      1,        NULL,    setup_getfunci, teardown_getfunci },
+    { "getfunci_1k",        run_getfunci,      1024,    1,        NULL,    setup_getfunci, teardown_getfunci },
+    { "call",               run_call,          1,       1,        NULL,    setup_call, teardown_call },
+    { "call_exec",          run_call_exec,     1,       1,        NULL,    setup_call, teardown_call },
+    { "call_batch_1k",      run_call_batch,    1024,    1024,     "Mcall/s", setup_call, teardown_call },
+    { "parse_4k",           run_parse,         4096,    4096,     "MB/s",  setup_parse, teardown_parse },
+    { "parse_256k",         run_parse,         1 << 18, 1 << 18,  "MB/s",  setup_parse, teardown_parse },
+    { "parse_8m",           run_parse,         1 << 23, 1 << 23,  "MB/s",  setup_parse, teardown_parse },
+    { "parse_borrow_8m",    run_parse_borrow,  1 << 23, 1 << 23,  "MB/s",  setup_parse, teardown_parse },
+    { "vec_add_real_4k",    run_vec_add_real,  4096,    4096,     "Melem/s", setup_vec, teardown_vec },
+    { "vec_add_int_4k",     run_vec_add_int,   4096,    4096,     "Melem/s", setup_vec, teardown_vec },
+    { "vec_sum_real_4k",    run_vec_sum_real,  4096,    4096,     "Melem/s", setup_vec, teardown_vec },
+};
+
+#define N_MICROS ((int)(sizeof(micros) / sizeof(micros[0])))
+
+int main(int argc, char** argv) {
+    int cpu = 0, n_samples = 21;
+    double min_ms = 20;
+
+    const char** only = malloc(sizeof(char*) * argc);
+    int n_only = 0;
+
+    int i, j;
+    for (i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            cpu = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            n_samples = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            min_ms = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            printf("Usage: %s [-c cpu] [-s samples] [-t ms] [names...]\n", argv[0]);
+            return 0;
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "micro: unknown option '%s'\n", argv[i]);
+            return 1;
+        } else {
+            only[n_only++] = argv[i];
+        }
+    }
+    if (n_samples < 3) n_samples = 3;
+    if (n_samples > MAX_SAMPLES) n_samples = MAX_SAMPLES;
+
+    ezc_init();
+
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        fprintf(stderr, "micro: couldn't pin to CPU %d, results may be noisier\n", cpu);
+    }
+#endif
+
+    double samples[MAX_SAMPLES], kept[MAX_SAMPLES], dev[MAX_SAMPLES];
+
+    printf("%-20s %12s %10s %8s %14s\n", "benchmark", "ns/op", "spread", "outliers", "throughput");
+    for (i = 0; i < N_MICROS; ++i) {
+        micro_t* m = &micros[i];
+        if (n_only > 0) {
+            for (j = 0; j < n_only && strstr(m->name, only[j]) == NULL; ++j);
+            if (j == n_only) continue;
+        }
+
+        micro_arg arg = { .size = m->size, .state = NULL };
+        if (m->f_setup != NULL) m->f_setup(&arg);
+
+        // calibrate: double the iterations until a sample is long enough
+        long iters = 1;
+        for (;;) {
+            double st = now();
+            m->f_run(iters, &arg);
+            if (1e3 * (now() - st) >= min_ms || iters > (1L << 40)) break;
+            iters *= 2;
+        }
+
+        // take samples (seconds per iteration)
+        for (j = 0; j < n_samples; ++j) {
+            double st = now();
+            m->f_run(iters, &arg);
+            samples[j] = (now() - st) / iters;
+        }
+
+        // reject outliers by the median absolute deviation
+        memcpy(kept, samples, sizeof(double) * n_samples);
+        qsort(kept, n_samples, sizeof(double), cmp_double);
+        double med = kept[n_samples / 2];
+        for (j = 0; j < n_samples; ++j) dev[j] = fabs(samples[j] - med);
+        qsort(dev, n_samples, sizeof(double), cmp_double);
+        double mad = 1.4826 * dev[n_samples / 2];
+
+        int n_kept = 0;
+        double sum = 0, sum2 = 0;
+        for (j = 0; j < n_samples; ++j) {
+            if (mad == 0 || fabs(samples[j] - med) <= 3 * mad) {
+                sum += samples[j];
+                sum2 += samples[j] * samples[j];
+                n_kept++;
+            }
+        }
+        double mean = sum / n_kept;
+        double sd = n_kept > 1 ? sqrt(fmax(0, (sum2 - n_kept * mean * mean) / (n_kept - 1))) : 0;
+
+        printf("%-20s %12.3f %9.2f%% %8d", m->name, 1e9 * mean, 100 * sd / mean, n_samples - n_kept);
+        if (m->unit_name != NULL) {
+            printf(" %9.1f %s\n", m->units / mean / 1e6, m->unit_name);
+        } else {
+            printf(" %9.1f Mop/s\n", m->units / mean / 1e6);
+        }
+        fflush(stdout);
+
+        if (m->f_teardown != NULL) m->f_teardown(&arg);
+    }
+
+    return 0;
+}
@@ -0,0 +1,205 @@
+// bench/stress.c - a multi-threaded stress test of libezc's threading model
+//                    (see docs/threading.md), meant to be ran under
+//                    ThreadSanitizer with `make tsan`
+//
+// Each thread repeatedly creates a VM from a shared template, and on it:
+//   * executes a program compiled once and shared by all threads
+//   * compiles and executes a program of its own, and defines a function
+//   * calls a function through a reference looked up on the template
+//   * runs `pforeach!` and `preduce!` (on the shared pool, or inline when
+//       another thread has it)
+//   * reads the lines of a file opened with `openr!`, which all the threads
+//       map at once
+// while all the VMs record into one tracer. Every result is checked, and the
+//   exit status is nonzero if any was wrong
+//
+// Usage: bench/stress [-t threads] [-n iterations]
+//
+// @author   : Cade Brown <cade@chemicaldevelopment.us>
+// @license  : WTFPL (http://www.wtfpl.net/)
+// @date     : 2019-12-08
+//
+
+// for mkstemp
+#define _DEFAULT_SOURCE
+
+#include "ezc.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define EZC_MODULE_NAME std
+#include "ezc-module.h"
+
+// maximum number of threads
+#define MAX_THREADS 64
+
+// the library defined on the template
+static const char* g_lib_src = "{:*} sq funcdef! {sq! +} addsq funcdef!";
+
+// the file read by each thread, and the lines it should give
+static const char* g_file_src = "a\nbb\nccc\n";
+static const char* g_file_lines[] = { "a!", "bb!", "ccc!" };
+
+// state shared by all threads
+static struct {
+    // the template every VM is created from
+    ezc_vm tmpl;
+    // the program shared by all threads
+    ezcp* prog;
+    // `sq`, looked up on the template
+    ezc_funcref sq;
+    // the tracer every VM is attached to
+    ezc_tracer tracer;
+    // the source of the program reading the file
+    char file_src[256];
+    // iterations per thread
+    int n_iters;
+    // number of wrong results
+    int n_fails;
+} g;
+
+// reports a wrong result
+static void stress_fail(int tid, int iter, const char* what, long long got, long long expect) {
+    fprintf(stderr, "stress: thread %d, iteration %d: %s gave %lld (expected %lld)\n", tid, iter, what, got, expect);
+    __atomic_add_fetch(&g.n_fails, 1, __ATOMIC_RELAXED);
+}
+
+// executes `prog`, then checks that it left one int, `expect`
+static void stress_check(ezc_vm* vm, ezcp prog, int tid, int iter, const char* what, long long expect) {
+    if (ezc_vm_exec(vm, prog) != 0 || vm->stk.n != 1 || ezc_stk_peek(&vm->stk).type != EZC_TYPE_INT) {
+        stress_fail(tid, iter, what, -1, expect);
+    } else if (ezc_stk_peek(&vm->stk)._int != expect) {
+        stress_fail(tid, iter, what, ezc_stk_peek(&vm->stk)._int, expect);
+    }
+    while (vm->stk.n > 0) {
+        ezc_obj top = ezc_stk_pop(&vm->stk);
+        ezc_obj_free(vm, &top);
+    }
+}
+
+static void* stress_thread(void* _arg) {
+    int tid = (int)(intptr_t)_arg, i;
+    char src[256];
+
+    for (i = 0; i < g.n_iters; ++i) {
+        ezc_vm vm;
+        ezc_vm_init_shared(&vm, &g.tmpl);
+        ezc_tracer_attach(&g.tracer, &vm);
+
+        // the shared program, using the template's functions
+        stress_check(&vm, *g.prog, tid, i, "shared program", 338350);
+
+        // a program of our own, which defines a function on this VM only. The
+        //   program is released right away, so the function must keep it alive
+        ezcp* own = ezcp_new();
+        snprintf(src, sizeof(src), "{%d +} addn funcdef! 0 1000 range! {} {+} preduce! addn!", tid);
+        if (ezcp_init(own, EZC_STR_CONST("stress"), EZC_STR_CONST(src)) != 0) {
+            stress_fail(tid, i, "compiling", -1, 0);
+        } else {
+            stress_check(&vm, *own, tid, i, "own program", 499500 + tid);
+        }
+        ezcp_decref(own);
+        ezcp* call = ezcp_new();
+        ezcp_init(call, EZC_STR_CONST("stress"), EZC_STR_CONST("| 0 100 range! {addn!} pforeach! sum!"));
+        stress_check(&vm, *call, tid, i, "pforeach!", 4950 + 100 * tid);
+        ezcp_decref(call);
+
+        // calling through the template's reference
+        ezc_obj x = (ezc_obj){ .type = EZC_TYPE_INT, ._int = tid + i };
+        if (ezc_vm_call(&vm, &g.sq, 1, &x) != 0 || vm.stk.n != 1) {
+            stress_fail(tid, i, "ezc_vm_call", -1, (long long)(tid + i) * (tid + i));
+        } else {
+            ezc_obj r = ezc_stk_pop(&vm.stk);
+            if (r._int != (long long)(tid + i) * (tid + i)) stress_fail(tid, i, "ezc_vm_call", r._int, (long long)(tid + i) * (tid + i));
+        }
+
+        // the lines of the shared file, which outlive the file itself
+        ezcp* lines = ezcp_new();
+        ezcp_init(lines, EZC_STR_CONST("stress"), EZC_STR_CONST(g.file_src));
+        if (ezc_vm_exec(&vm, *lines) != 0 || vm.stk.n != 3) {
+            stress_fail(tid, i, "openr!", vm.stk.n, 3);
+        }
+        while (vm.stk.n > 0) {
+            ezc_obj top = ezc_stk_pop(&vm.stk);
+            const char* expect = vm.stk.n < 3 ? g_file_lines[vm.stk.n] : "";
+            if (top.type != EZC_TYPE_STR || (size_t)top._str.len != strlen(expect) || memcmp(top._str._, expect, top._str.len) != 0) {
+                stress_fail(tid, i, "openr! (the length of a line)", top.type == EZC_TYPE_STR ? top._str.len : -1, (long long)strlen(expect));
+            }
+            ezc_obj_free(&vm, &top);
+        }
+        ezcp_decref(lines);
+
+        ezc_out_flush(&vm);
+        ezc_vm_free(&vm);
+    }
+    return NULL;
+}
+
+int main(int argc, char** argv) {
+    int n_threads = 8, i;
+    g.n_iters = 20;
+
+    for (i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            n_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            g.n_iters = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            printf("Usage: %s [-t threads] [-n iterations]\n", argv[0]);
+            return 0;
+        } else {
+            fprintf(stderr, "stress: unknown option '%s'\n", argv[i]);
+            return 1;
+        }
+    }
+    if (n_threads < 1) n_threads = 1;
+    if (n_threads > MAX_THREADS) n_threads = MAX_THREADS;
+
+    ezc_init();
+    // make sure the pool has several workers, even on a single CPU
+    ezc_pool_set_workers(4);
+
+    // the file every thread reads
+    char fname[] = "/tmp/ezc-stress-XXXXXX";
+    int fd = mkstemp(fname);
+    if (fd < 0 || write(fd, g_file_src, strlen(g_file_src)) != (ssize_t)strlen(g_file_src)) {
+        fprintf(stderr, "stress: couldn't create a temporary file\n");
+        return 1;
+    }
+    close(fd);
+    snprintf(g.file_src, sizeof(g.file_src), "| \"%s\" openr! {} lines! {\"!\" +} pforeach!", fname);
+
+    // the template, and the programs shared with it
+    g.tmpl = EZC_VM_EMPTY;
+    F_std_register_module(&g.tmpl);
+    ezcp* lib = ezcp_new();
+    ezcp_init(lib, EZC_STR_CONST("lib"), EZC_STR_CONST(g_lib_src));
+    ezc_vm_exec(&g.tmpl, *lib);
+    ezc_vm_getfunc(&g.tmpl, EZC_STR_CONST("sq"), &g.sq);
+    g.prog = ezcp_new();
+    ezcp_init(g.prog, EZC_STR_CONST("shared"), EZC_STR_CONST("0 1 101 {addsq!} forrange!"));
+    ezc_tracer_init(&g.tracer);
+
+    pthread_t threads[MAX_THREADS];
+    for (i = 0; i < n_threads; ++i) {
+        pthread_create(&threads[i], NULL, stress_thread, (void*)(intptr_t)i);
+    }
+    for (i = 0; i < n_threads; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    printf("stress: %d threads x %d iterations, %d events traced, %d failures\n", n_threads, g.n_iters, g.tracer.evs.n, g.n_fails);
+
+    ezc_tracer_free(&g.tracer);
+    ezcp_decref(g.prog);
+    ezc_funcref_free(&g.sq);
+    ezc_vm_free(&g.tmpl);
+    ezcp_decref(lib);
+    unlink(fname);
+    ezc_finalize();
+
+    return g.n_fails == 0 ? 0 : 1;
+}
@@ -11,6 +11,9 @@ self.$config = {
     },
     {
       title: 'Installing', path: '/installing'
+    },
+    {
+      title: 'Threading', path: '/threading'
     }
   ]
 }
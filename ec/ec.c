@@ -7,6 +7,9 @@
 // @date     : 2019-11-21
 //
 
+// for mmap
+#define _DEFAULT_SOURCE
+
 #include "ec.h"
 
 // just include standard library for IO/printing/etc
@@ -16,6 +19,12 @@
 
 #include <getopt.h>
 #include <unistd.h>
+#include <limits.h>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 // force include the standard module (which should be linked wit -lezc)
 #define EZC_MODULE_NAME std
@@ -29,6 +38,247 @@
 
 static ezc_vm vm;
 
+// hardware performance counters (only opened with `--perf-stat`)
+static ezc_perf perf;
+
+// the tracer, and where to write it (only used with `--trace-out`)
+static ezc_tracer tracer;
+static char* trace_out = NULL;
+
+// long-only options (which don't have a single character version)
+enum {
+    EC_OPT_ANNOTATE = 256,
+    EC_OPT_ANNOTATE_TIMER,
+    EC_OPT_PERF_STAT,
+    EC_OPT_TRACE_OUT,
+    EC_OPT_STREAM,
+    EC_OPT_JOBS,
+    EC_OPT_UNBUFFERED
+};
+
+// something given on the commandline to run, in the order they were given
+typedef struct {
+    // what kind of job (see EC_JOB_*)
+    int kind;
+    // the expression or file name
+    const char* arg;
+    // the program (allocated up front, so it doesn't move)
+    ezcp* prog;
+    // for files, whether it has been compiled yet (0), or it has (1), or it
+    //   couldn't be opened (-1), or it had errors (-2), or it is too large to
+    //   read whole, so it should be streamed instead (-3). Guarded by
+    //   `compile_lock`
+    int state;
+} ec_job;
+
+enum {
+    // `-e`, compiled right before it is executed
+    EC_JOB_EXPR = 0,
+    // a file, compiled in the background (see `ec_compile_start`)
+    EC_JOB_FILE,
+    // a file (or stdin) which is streamed (compiled as it is read)
+    EC_JOB_STREAM,
+    // `-i`, an interactive prompt
+    EC_JOB_REPL
+};
+
+// the files being compiled in the background. Workers take the next file in
+//   order, compile it, then signal `compile_done` so `main` can execute it
+static struct {
+    ec_job* jobs;
+    int n_jobs;
+    // the next job to look at
+    int next;
+    int n_threads;
+    pthread_t* threads;
+} compile;
+static pthread_mutex_t compile_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t compile_done = PTHREAD_COND_INITIALIZER;
+
+// allocates a new program. These are never freed, and must not move, since
+//   instructions (and so functions and blocks) hold a pointer to the program
+//   they were compiled under
+static ezcp* ec_newprog() {
+    ezcp* prog = ezc_malloc(sizeof(ezcp));
+    *prog = EZCP_EMPTY;
+    return prog;
+}
+
+// executes a top level program on the global VM, tracing it if requested
+static int ec_exec(ezcp* prog) {
+    if (trace_out != NULL) ezc_tracer_begin(&tracer, &vm, prog->src_name);
+    int status = ezc_vm_exec(&vm, *prog);
+    if (trace_out != NULL) ezc_tracer_end(&tracer, &vm, prog->src_name);
+    return status;
+}
+
+// reads a whole file into `*src` (which is never freed, since the program
+//   compiled from it borrows it), returning 0, or -1 if it couldn't be opened,
+//   or -3 if it is a regular file too large to read at once (over INT_MAX
+//   bytes, the most a program can hold). The file is memory mapped if
+//   possible, so it isn't copied at all
+static int ec_readfile(const char* fname, char** src, int* size) {
+    int fd = open(fname, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat sb;
+    bool is_reg = fstat(fd, &sb) == 0 && S_ISREG(sb.st_mode);
+    if (is_reg && sb.st_size > INT_MAX) {
+        close(fd);
+        return -3;
+    }
+    if (is_reg && sb.st_size > 0) {
+        char* map = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            close(fd);
+            *src = map;
+            *size = (int)sb.st_size;
+            return 0;
+        }
+    }
+
+    // otherwise (i.e. empty files, pipes), just read it all, up to INT_MAX bytes
+    char* buf = NULL;
+    int len = 0, max_len = 0;
+    ssize_t got;
+    do {
+        if (len == max_len) {
+            if (max_len == INT_MAX) {
+                ezc_error("File '%s' is too large to read at once (use --stream)", fname);
+                ezc_free(buf);
+                close(fd);
+                return -2;
+            }
+            size_t next = 2 * (size_t)max_len + 4096;
+            max_len = next > INT_MAX ? INT_MAX : (int)next;
+            buf = ezc_realloc(buf, max_len);
+        }
+        got = read(fd, buf + len, max_len - len);
+        if (got > 0) len += got;
+    } while (got > 0);
+    if (got < 0) ezc_warn("File wasn't read correctly... '%s'", fname);
+    close(fd);
+
+    *src = buf;
+    *size = len;
+    return 0;
+}
+
+// reads and compiles a file, returning its state (see `ec_job.state`)
+static int ec_compile_file(ezcp* prog, const char* fname) {
+    char* src = NULL;
+    int size = 0;
+    int status = ec_readfile(fname, &src, &size);
+    if (status != 0) return status;
+    return ezcp_init_borrow(prog, EZC_STR_CONST(fname), EZC_STR_VIEW(src, size)) == 0 ? 1 : -2;
+}
+
+// a background compiler, which takes files in order until there are none left
+static void* ec_compile_worker(void* arg) {
+    pthread_mutex_lock(&compile_lock);
+    for (;;) {
+        while (compile.next < compile.n_jobs && compile.jobs[compile.next].kind != EC_JOB_FILE) compile.next++;
+        if (compile.next >= compile.n_jobs) break;
+        ec_job* job = &compile.jobs[compile.next++];
+
+        // compile without holding the lock
+        pthread_mutex_unlock(&compile_lock);
+        int state = ec_compile_file(job->prog, job->arg);
+        pthread_mutex_lock(&compile_lock);
+
+        job->state = state;
+        pthread_cond_broadcast(&compile_done);
+    }
+    pthread_mutex_unlock(&compile_lock);
+    return NULL;
+}
+
+// starts compiling all the files in `jobs`, on up to `n_threads` threads
+//   (or in `ec_compile_wait`, if there's only one file)
+static void ec_compile_start(ec_job* jobs, int n_jobs, int n_threads) {
+    compile.jobs = jobs;
+    compile.n_jobs = n_jobs;
+    compile.next = 0;
+
+    int i, n_files = 0;
+    for (i = 0; i < n_jobs; ++i) n_files += jobs[i].kind == EC_JOB_FILE;
+
+    // the first file will be waited on anyway, so it's only worth it for more
+    if (n_threads > n_files) n_threads = n_files;
+    if (n_files < 2 || n_threads < 1) n_threads = 0;
+
+    compile.threads = ezc_malloc(sizeof(pthread_t) * (n_threads + 1));
+    compile.n_threads = 0;
+    for (i = 0; i < n_threads; ++i) {
+        if (pthread_create(&compile.threads[compile.n_threads], NULL, ec_compile_worker, NULL) != 0) {
+            ezc_warn("Couldn't start a compile thread, compiling serially");
+            break;
+        }
+        compile.n_threads++;
+    }
+    ezc_debug("Compiling %d file(s) on %d thread(s)", n_files, compile.n_threads);
+}
+
+// waits for a file to be compiled, returning its state
+static int ec_compile_wait(ec_job* job) {
+    pthread_mutex_lock(&compile_lock);
+    if (compile.n_threads == 0 && job->state == 0) {
+        // no workers, so just compile it here
+        pthread_mutex_unlock(&compile_lock);
+        job->state = ec_compile_file(job->prog, job->arg);
+        return job->state;
+    }
+    while (job->state == 0) pthread_cond_wait(&compile_done, &compile_lock);
+    int state = job->state;
+    pthread_mutex_unlock(&compile_lock);
+    return state;
+}
+
+// waits for all the compile threads to finish
+static void ec_compile_join() {
+    int i;
+    for (i = 0; i < compile.n_threads; ++i) pthread_join(compile.threads[i], NULL);
+    ezc_free(compile.threads);
+    compile.threads = NULL;
+    compile.n_threads = 0;
+}
+
+// compiles and executes a file while it is being read (`-` for stdin), so
+//   that execution starts right away, and the whole file is never in memory.
+//   Returns -1 if it couldn't be opened, 1 if it couldn't be read or
+//   compiled, or 0 (even if executing it failed, like a file read whole)
+static int ec_exec_stream(ezcp* prog, const char* fname) {
+    bool is_stdin = strcmp(fname, "-") == 0;
+    FILE* fp = is_stdin ? stdin : fopen(fname, "r");
+    if (fp == NULL) {
+        ezc_error("Couldn't open file '%s'", fname);
+        return -1;
+    }
+    ezc_debug("Streaming: %s", fname);
+
+    ezc_str src_name = EZC_STR_CONST(fname);
+    if (trace_out != NULL) ezc_tracer_begin(&tracer, &vm, src_name);
+    int status = ezc_vm_exec_file(&vm, prog, src_name, fp);
+    if (trace_out != NULL) ezc_tracer_end(&tracer, &vm, src_name);
+
+    if (!is_stdin) fclose(fp);
+    return status == 1 ? 1 : 0;
+}
+
+// writes out whatever is still buffered at exit (i.e. after an error)
+static void ec_atexit_flush() {
+    ezc_out_flush(&vm);
+}
+
+// writes out the trace at exit (this also catches `exit!`)
+static void ec_atexit() {
+    if (trace_out != NULL) {
+        ezc_tracer_write(&tracer, trace_out);
+        ezc_tracer_free(&tracer);
+        trace_out = NULL;
+    }
+}
+
 // if there is no readline support, run a non-interactive version
 #ifndef EZC_HAVE_READLINE
 
@@ -38,9 +288,6 @@ void ec_run_repl(ezc_vm* vm) {
     // read from stdin
     bool do_prompt = isatty(STDIN_FILENO);
 
-    ezcp* progs = NULL;
-    int n_progs = 0;
-
     if (do_prompt) printf("%s", EC_PROMPT);
 
     int lines = 0;
@@ -48,13 +295,15 @@ void ec_run_repl(ezc_vm* vm) {
 
         char c = fgetc(stdin);
         if (c == EOF || c == '\n') {
-            // execute
-            int pidx = n_progs++;
-            progs = realloc(progs, sizeof(ezcp) * n_progs);
-            progs[pidx] = EZCP_EMPTY;
-            ezcp_init(&progs[pidx], EZC_STR_CONST("-"), curline);
-
-            int status = ezc_vm_exec(vm, progs[pidx]);
+            // execute, then let go of the line, which is freed unless it left
+            //   a block on the stack, or defined a function
+            //   (a line that doesn't compile is skipped)
+            ezcp* prog = ezcp_new();
+            if (ezcp_init(prog, EZC_STR_CONST("-"), curline) == 0) {
+                ezc_vm_exec(vm, *prog);
+                ezc_out_flush(vm);
+            }
+            ezcp_decref(prog);
 
             ezc_str_copy(&curline, EZC_STR_CONST(""));
 
@@ -66,8 +315,7 @@ void ec_run_repl(ezc_vm* vm) {
         if (c == EOF) break;
 
     }
-
-    free(progs);
+    ezc_str_free(&curline);
 
     //while (getline(&line, &size, stdin) != -1) {
     //    if (do_prompt) printf("%s", EC_PROMPT)0;
@@ -117,9 +365,6 @@ char** ec_rl_completion(const char *text, int start, int end) {
 // begins a repl, using readline for easier usage
 void ec_run_repl_rl(ezc_vm* vm) {
 
-    ezcp* progs = NULL;
-    int n_progs = 0;
-
     char * cur_line = NULL;
 
     //rl_parse_and_bind("TAB: menu-complete");
@@ -137,19 +382,19 @@ void ec_run_repl_rl(ezc_vm* vm) {
 
     while ((cur_line = readline(interact)) != NULL) {
         //runnable_free(&cur_runnable);
-        int pidx = n_progs++;
-        progs = realloc(progs, sizeof(ezcp) * n_progs);
-        progs[pidx] = EZCP_EMPTY;
-        ezcp_init(&progs[pidx], EZC_STR_CONST("-"), EZC_STR_VIEW(cur_line, strlen(cur_line)));
-
-        int status = ezc_vm_exec(vm, progs[pidx]);
+        // each line is freed once nothing refers to it anymore (see `ezcp_new`)
+        //   (a line that doesn't compile is skipped)
+        ezcp* prog = ezcp_new();
+        if (ezcp_init(prog, EZC_STR_CONST("-"), EZC_STR_VIEW(cur_line, strlen(cur_line))) == 0) {
+            ezc_vm_exec(vm, *prog);
+            ezc_out_flush(vm);
+        }
+        ezcp_decref(prog);
 
         // this will allow readline to display prior command when the user hits the up arrow
         if (cur_line && *cur_line) add_history(cur_line);
         free(cur_line);
     }
-
-    free(progs);
 }
 
 #endif
@@ -159,17 +404,28 @@ int main(int argc, char** argv) {
     ezc_init();
 
     vm = EZC_VM_EMPTY;
+    atexit(ec_atexit_flush);
 
     // this should be defined by `ezc-module.h`, for module standard 
     F_std_register_module(&vm);
 
-    // here are the programs to be executed
+    // here are the programs to be executed, in order
     int status = 0;
-    int n_progs = 0;
-    ezcp* progs = NULL;
+    int n_progs = 0, n_jobs = 0;
+    ec_job* jobs = NULL;
+
+    // number of threads to compile files on, and to run `pforeach!` on
+    //   (default: one per CPU)
+    long n_threads = sysconf(_SC_NPROCESSORS_ONLN);
 
     // storing flags
     bool fA = false;
+    // whether to print an annotated profile at the end
+    bool fP = false;
+    // whether to report hardware counters at the end
+    bool fS = false;
+    // whether to stream files (compile & execute as they are read)
+    bool fR = false;
 
     // long options for commandline parsing
     static struct option long_options[] = {
@@ -179,11 +435,24 @@ int main(int argc, char** argv) {
         {"all", no_argument, NULL, 'A'},
         {"v", no_argument, NULL, 'v'},
         {"help", no_argument, NULL, 'h'},
+        {"annotate", optional_argument, NULL, EC_OPT_ANNOTATE},
+        {"annotate-timer", required_argument, NULL, EC_OPT_ANNOTATE_TIMER},
+        {"perf-stat", optional_argument, NULL, EC_OPT_PERF_STAT},
+        {"trace-out", required_argument, NULL, EC_OPT_TRACE_OUT},
+        {"stream", no_argument, NULL, EC_OPT_STREAM},
+        {"jobs", required_argument, NULL, EC_OPT_JOBS},
+        {"unbuffered", no_argument, NULL, EC_OPT_UNBUFFERED},
 
         {NULL, 0, NULL, 0}
     };
 
-    int c;
+    int c, i;
+
+    // adds a job to run, in the order they were given
+    #define EC_ADD_JOB(_kind, _arg) { \
+        jobs = ezc_realloc(jobs, sizeof(ec_job) * ++n_jobs); \
+        jobs[n_jobs - 1] = (ec_job){ .kind = (_kind), .arg = (_arg), .prog = ec_newprog(), .state = 0 }; \
+    }
 
     while ((c = getopt_long (argc, argv, "e:f:Aivh", long_options, NULL)) != -1)
     switch (c){
@@ -191,39 +460,62 @@ int main(int argc, char** argv) {
             fA = true;
             break;
         case 'i':
-            #ifdef EZC_HAVE_READLINE
-            ec_run_repl_rl(&vm);
-            #else
-            ec_run_repl(&vm);
-            #endif
+            EC_ADD_JOB(EC_JOB_REPL, NULL);
             break;
         case 'e':
-            progs = ezc_realloc(progs, sizeof(ezcp) * ++n_progs);
-            progs[n_progs - 1] = EZCP_EMPTY;
-            ezcp_init(&progs[n_progs - 1], EZC_STR_CONST("-e"), EZC_STR_CONST(optarg));
-            ezc_debug("Running `-e`: '%s' (compiled to %d instructions)", progs[n_progs - 1].src._, progs[n_progs - 1].body._block.n);
-            ezc_vm_exec(&vm, progs[n_progs - 1]);
-
+            EC_ADD_JOB(EC_JOB_EXPR, optarg);
+            n_progs++;
             break;
         case 'f':
-            progs = ezc_realloc(progs, sizeof(ezcp) * ++n_progs);
-            progs[n_progs - 1] = EZCP_EMPTY;
-            FILE* fp = fopen(optarg, "r");
-            if (fp == NULL) {
-                ezc_error("Couldn't open file '%s'", optarg);
-                return 1;
-            } else {
-                fseek(fp, 0, SEEK_END);
-                int size = ftell(fp);
-                fseek(fp, 0, SEEK_SET);
-                char* src = ezc_malloc(size+1);
-                if (size != fread(src, 1, size, fp)) ezc_warn("File wasn't read correctly... '%s'", optarg);
-                src[size] = '\0';
-                ezc_debug("Running `-f`: %s (compiled to %d instructions)", progs[n_progs - 1].src_name._, progs[n_progs - 1].body._block.n);
-                ezcp_init(&progs[n_progs - 1], EZC_STR_CONST(optarg), EZC_STR_VIEW(src, size));
-                ezc_free(src);
-                ezc_vm_exec(&vm, progs[n_progs - 1]);
+            EC_ADD_JOB(EC_JOB_FILE, optarg);
+            n_progs++;
+            break;
+        case EC_OPT_ANNOTATE:
+            // sample every N instructions (default: every instruction)
+            fP = true;
+            ezc_prof_start(&vm, optarg != NULL ? atoi(optarg) : 1);
+            break;
+        case EC_OPT_ANNOTATE_TIMER:
+            // sample every N microseconds of CPU time
+            fP = true;
+            ezc_prof_start_timer(&vm, atoi(optarg));
+            break;
+        case EC_OPT_PERF_STAT:
+            // count the whole run, and optionally each user function
+            if (!fS) {
+                fS = true;
+                ezc_perf_open(&perf);
+            }
+            if (optarg != NULL) {
+                if (strcmp(optarg, "func") == 0) {
+                    ezc_perf_attach(&perf, &vm);
+                } else {
+                    ezc_error("Unknown argument for --perf-stat: '%s' (expected 'func')", optarg);
+                    return 1;
+                }
+            }
+            break;
+        case EC_OPT_TRACE_OUT:
+            // record spans for programs & user functions, written at exit
+            if (trace_out == NULL) {
+                ezc_tracer_init(&tracer);
+                ezc_tracer_attach(&tracer, &vm);
+                atexit(ec_atexit);
             }
+            trace_out = optarg;
+            break;
+        case EC_OPT_STREAM:
+            // compile & execute files as they are read
+            fR = true;
+            break;
+        case EC_OPT_JOBS:
+            // number of threads to compile files on, and for `pforeach!`
+            n_threads = atoi(optarg);
+            ezc_pool_set_workers((int)n_threads);
+            break;
+        case EC_OPT_UNBUFFERED:
+            // write out everything as soon as it's printed
+            ezc_out_set_mode(&vm, EZC_OUT_UNBUFFERED);
             break;
         case 'v':
             // get more verbose
@@ -233,8 +525,15 @@ int main(int argc, char** argv) {
             printf("Usage: %s [-e expr|-f file] [-A,-h] [files...]\n", argv[0]);
             printf("  -h,--help              Prints this help message\n");
             printf("  -e,--expr [EXPR]       Compiles [EXPR], then executes it\n");
-            printf("  -f,--file [FILE]       Reads [FILE], compiles it, then executes it\n");
+            printf("  -f,--file [FILE]       Reads [FILE], compiles it, then executes it ('-' streams stdin)\n");
             printf("  -A,--all               Prints out the entire stack after execution\n");
+            printf("  --annotate[=N]         Samples every N instructions, then prints the annotated source\n");
+            printf("  --annotate-timer=USEC  Samples every USEC microseconds of CPU time, then prints the annotated source\n");
+            printf("  --perf-stat[=func]     Prints hardware counters for the run (and for each function, with =func)\n");
+            printf("  --trace-out=FILE       Writes a Chrome trace (JSON) of programs and function calls to FILE\n");
+            printf("  --stream               Compiles and executes files as they are read, instead of reading them whole\n");
+            printf("  --jobs=N               Compiles up to N files at once, and runs `pforeach!` on N threads (default: one per CPU)\n");
+            printf("  --unbuffered           Writes out everything as soon as it's printed (by default, output is buffered unless it's a terminal)\n");
             return 0;
             break;
         case '?':
@@ -252,26 +551,8 @@ int main(int argc, char** argv) {
 
     while (optind < argc) {
         // treat the input as a file
-        optarg = argv[optind];
-        progs = ezc_realloc(progs, sizeof(ezcp) * ++n_progs);
-        progs[n_progs - 1] = EZCP_EMPTY;
-        FILE* fp = fopen(optarg, "r");
-        if (fp == NULL) {
-            ezc_error("Couldn't open file '%s'", optarg);
-            return 1;
-        } else {
-            fseek(fp, 0, SEEK_END);
-            int size = ftell(fp);
-            fseek(fp, 0, SEEK_SET);
-            char* src = ezc_malloc(size+1);
-            if (size != fread(src, 1, size, fp)) ezc_warn("File wasn't read correctly... '%s'", optarg);
-            src[size] = '\0';
-            ezc_debug("Running `-f`: %s (compiled to %d instructions)", progs[n_progs - 1].src_name._, progs[n_progs - 1].body._block.n);
-            ezcp_init(&progs[n_progs - 1], EZC_STR_CONST(optarg), EZC_STR_VIEW(src, size));
-            ezc_free(src);
-            ezc_vm_exec(&vm, progs[n_progs - 1]);
-        }
-
+        EC_ADD_JOB(EC_JOB_FILE, argv[optind]);
+        n_progs++;
         optind++;
     }
     // shouldn't happen
@@ -279,6 +560,76 @@ int main(int argc, char** argv) {
         ezc_error("Unhandled arguments!");
     }
 
+    if (n_progs == 0 && !isatty(STDIN_FILENO)) {
+        // no programs/tasks passed, but input is piped in, so run it as it comes
+        EC_ADD_JOB(EC_JOB_STREAM, "-");
+        n_progs++;
+    }
+
+    // files which are streamed are read as they are executed, not beforehand
+    for (i = 0; i < n_jobs; ++i) {
+        if (jobs[i].kind == EC_JOB_FILE && (fR || strcmp(jobs[i].arg, "-") == 0)) jobs[i].kind = EC_JOB_STREAM;
+    }
+
+    // the exit code, which is nonzero if any program didn't compile (or
+    //   couldn't be read)
+    int ret = 0;
+
+    // compile the files in the background, while running them in order
+    ec_compile_start(jobs, n_jobs, (int)n_threads);
+    for (i = 0; i < n_jobs; ++i) {
+        ec_job* job = &jobs[i];
+        if (job->kind == EC_JOB_EXPR) {
+            if (ezcp_init(job->prog, EZC_STR_CONST("-e"), EZC_STR_CONST(job->arg)) != 0) {
+                // the error was printed, and none of it is ran
+                ret = 1;
+                continue;
+            }
+            ezc_debug("Running `-e`: '%s' (compiled to %d instructions)", job->prog->src._, job->prog->body._block.n);
+            ec_exec(job->prog);
+        } else if (job->kind == EC_JOB_FILE) {
+            int state = ec_compile_wait(job);
+            if (state == -2) {
+                ret = 1;
+                continue;
+            } else if (state == -3) {
+                // too large to hold at once, so it's compiled as it's read
+                ezc_debug("Streaming `-f`: %s (too large to read whole)", job->arg);
+                int status = ec_exec_stream(job->prog, job->arg);
+                if (status < 0) {
+                    ec_compile_join();
+                    return 1;
+                } else if (status > 0) {
+                    ret = 1;
+                }
+                continue;
+            } else if (state < 0) {
+                ezc_error("Couldn't open file '%s'", job->arg);
+                // the other files may still be being compiled
+                ec_compile_join();
+                return 1;
+            }
+            ezc_debug("Running `-f`: %s (compiled to %d instructions)", job->arg, job->prog->body._block.n);
+            ec_exec(job->prog);
+        } else if (job->kind == EC_JOB_STREAM) {
+            int status = ec_exec_stream(job->prog, job->arg);
+            if (status < 0) {
+                ec_compile_join();
+                return 1;
+            } else if (status > 0) {
+                // the error was printed, and the rest of it wasn't ran
+                ret = 1;
+            }
+        } else if (job->kind == EC_JOB_REPL) {
+            #ifdef EZC_HAVE_READLINE
+            ec_run_repl_rl(&vm);
+            #else
+            ec_run_repl(&vm);
+            #endif
+        }
+    }
+    ec_compile_join();
+
     if (n_progs == 0) {
         // no programs/tasks passed, so do an interactive mode
         #ifdef EZC_HAVE_READLINE
@@ -289,17 +640,29 @@ int main(int argc, char** argv) {
 
     }
 
+    // print where the samples were taken (to stderr, so it doesn't mix with output)
+    if (fP) {
+        ezc_prof_stop(&vm);
+        ezc_prof_annotate(&vm, stderr);
+    }
+
+    if (fS) {
+        ezc_perf_report(&perf, stderr);
+    }
+
     // print the entire stack
     if (fA) {
         ezcp printall_p = EZCP_EMPTY;
         ezcp_init(&printall_p, EZC_STR_CONST("__printall"), EZC_STR_CONST("dump!"));
         ezc_vm_exec(&vm, printall_p);
+        ezcp_free(&printall_p);
     } else {
         // just print top
         if (vm.stk.n > 0) {
             ezcp print_p = EZCP_EMPTY;
             ezcp_init(&print_p, EZC_STR_CONST("__print"), EZC_STR_CONST("print!"));
             ezc_vm_exec(&vm, print_p);
+            ezcp_free(&print_p);
         } else {
             // print nothing
         }
@@ -307,9 +670,10 @@ int main(int argc, char** argv) {
 
     // free and finalize the library
     ezc_vm_free(&vm);
+    if (fS) ezc_perf_close(&perf);
     ezc_finalize();
 
-    return 0;
+    return ret;
 }
 
 
@@ -9,49 +9,36 @@
 
 #include "ezc-impl.h"
 
-// executes on a VM
-int ezc_vm_exec(ezc_vm* vm, ezcp prog) {
-    ezc_trace("ezc_vm_exec(%p, {...})", vm);
+// returns the C function a builtin instruction runs (i.e. `add` for `+`), or
+//   NULL if there isn't one
+static ezc_cfunc exec_builtin(ezc_vm* vm, const char* name) {
+    int idx = ezc_vm_getfunci(vm, EZC_STR_CONST(name));
+    if (idx < 0 || vm->funcs.vals[idx].type != EZC_FUNC_TYPE_C) {
+        ezc_error("Couldn't find builtin function '%s'", name);
+        return NULL;
+    }
+    return vm->funcs.vals[idx]._c;
+}
+
+// executes the instructions of `body` (a block) on a VM
+static int exec_body(ezc_vm* vm, const ezci* body) {
 
-    // macros to declare required 'builtins'
-    #define EZC_BUILTIN(name) int bidx_##name = -1; ezc_func bi_##name;
-    #define RUN_BUILTIN(name) if (bidx_##name < 0) { \
-        bidx_##name = ezc_vm_getfunci(vm, EZC_STR_CONST(#name)); \
-        if (bidx_##name < 0) { \
-            ezc_error("Couldn't find builtin function '%s'", #name); \
+    // runs the function for a builtin instruction, which is looked up the first
+    //   time it's used on this VM (functions are only ever added, and lookups
+    //   find the first one by a name, so it never changes)
+    #define CASE_BUILTIN(code, name) else if (cur.type == code) { \
+        if (vm->builtins[code] == NULL && (vm->builtins[code] = exec_builtin(vm, #name)) == NULL) { \
             ezc_printmeta(cur); \
             return 1; \
-        } else { \
-            bi_##name = vm->funcs.vals[bidx_##name]; \
         } \
-    } \
-    if ((status = bi_##name._c(vm)) != 0) { return status; } \
-
-    // macro to simplify the `else if`s
-    #define CASE_BUILTIN(code, name) else if (cur.type == code) { RUN_BUILTIN(name) }
-
-    // list of builtins callable
-    EZC_BUILTIN(exec)
-    EZC_BUILTIN(copy)
-    EZC_BUILTIN(del)
-    EZC_BUILTIN(dump)
-    EZC_BUILTIN(swap)
-    EZC_BUILTIN(add)
-    EZC_BUILTIN(sub)
-    EZC_BUILTIN(mul)
-    EZC_BUILTIN(div)
-    EZC_BUILTIN(mod)
-    EZC_BUILTIN(pow)
-    EZC_BUILTIN(under)
-    EZC_BUILTIN(get)
-    EZC_BUILTIN(wall)
-    EZC_BUILTIN(eq)
+        if ((status = vm->builtins[code](vm)) != 0) { return status; } \
+    }
 
     int status = 0;
     int i;
-    for (i = 0; i < prog.body._block.n; ++i) {
+    for (i = 0; i < body->_block.n; ++i) {
         // get current instruction
-        ezci cur = prog.body._block.children[i];
+        ezci cur = body->_block.children[i];
         if (cur.type == EZCI_INT) {
             ezc_obj new_int = (ezc_obj){ .type = EZC_TYPE_INT, ._int = cur._int };
             ezc_stk_push(&vm->stk, new_int);
@@ -64,7 +51,9 @@ int ezc_vm_exec(ezc_vm* vm, ezcp prog) {
             ezc_stk_push(&vm->stk, new_str);
         } else if (cur.type == EZCI_BLOCK) {
             ezc_obj new_block = (ezc_obj){ .type = EZC_TYPE_BLOCK };
-            new_block._block = prog.body._block.children[i];
+            new_block._block = cur;
+            // the block keeps its program alive while it's on the stack
+            ezcp_incref(new_block._block.m_prog);
             ezc_stk_push(&vm->stk, new_block);
         }
         // all the builtins
@@ -87,11 +76,139 @@ int ezc_vm_exec(ezc_vm* vm, ezcp prog) {
         } else {
             ezc_warn("Unhandled instruction type!");
         }
+
+        // attribute samples to the instruction that just ran
+        if (vm->prof.mode != EZC_PROF_OFF) {
+            ezc_prof_tick(vm, &cur);
+        }
     }
 
+    #undef CASE_BUILTIN
+
     // return 0 (success)
     return 0;
 }
 
+// executes on a VM
+int ezc_vm_exec(ezc_vm* vm, ezcp prog) {
+    ezc_trace("ezc_vm_exec(%p, {...})", vm);
+    return exec_body(vm, &prog.body);
+}
+
+int ezc_vm_exec_func(ezc_vm* vm, ezc_func func, ezc_str name) {
+    if (func.type == EZC_FUNC_TYPE_C) {
+        // this is a function implemented in C, so just call it on our VM
+        return func._c(vm);
+    }
+
+    // otherwise, run its body directly (there's no need for a program)
+    if (vm->hooks.n > 0) ezc_vm_hook_enter(vm, name);
+    int status = exec_body(vm, &func._ezc);
+    if (vm->hooks.n > 0) ezc_vm_hook_leave(vm, name);
+    return status;
+}
+
+/* calling functions directly */
+
+int ezc_vm_getfunc(ezc_vm* vm, ezc_str name, ezc_funcref* ref) {
+    int idx = ezc_vm_getfunci(vm, name);
+    if (idx < 0) return -1;
+
+    ref->name = EZC_STR_NULL;
+    ezc_str_copy(&ref->name, name);
+    ref->func = vm->funcs.vals[idx];
+    // keep the body of an EZC function alive, even if its program is released
+    if (ref->func.type == EZC_FUNC_TYPE_EZC) ezcp_incref(ref->func._ezc.m_prog);
+    return 0;
+}
+
+void ezc_funcref_free(ezc_funcref* ref) {
+    if (ref->func.type == EZC_FUNC_TYPE_EZC) ezcp_decref(ref->func._ezc.m_prog);
+    ezc_str_free(&ref->name);
+    ref->func = EZC_FUNC_C(NULL);
+}
+
+int ezc_vm_call(ezc_vm* vm, ezc_funcref* ref, int n_args, ezc_obj* args) {
+    int i;
+    for (i = 0; i < n_args; ++i) {
+        ezc_stk_push(&vm->stk, args[i]);
+    }
+    return ezc_vm_exec_func(vm, ref->func, ref->name);
+}
+
+int ezc_vm_call_batch(ezc_vm* vm, ezc_funcref* ref, int n_calls, int n_args, ezc_obj* args, ezc_obj* res) {
+    int status = 0;
+    int i, j;
+    for (i = 0; i < n_calls; ++i) {
+        ezc_obj* cargs = args + (size_t)i * n_args;
+        if (status != 0) {
+            // a call failed, so the rest are just freed
+            for (j = 0; j < n_args; ++j) ezc_obj_free(vm, &cargs[j]);
+            res[i] = EZC_OBJ_EMPTY;
+            continue;
+        }
+
+        int base = vm->stk.n;
+        status = ezc_vm_call(vm, ref, n_args, cargs);
+        if (status == 0 && vm->stk.n != base + 1) {
+            ezc_error("%.*s: each call must leave exactly 1 value, but left %d", ref->name.len, ref->name._, vm->stk.n - base);
+            status = 1;
+        }
+
+        if (status == 0) {
+            res[i] = ezc_stk_pop(&vm->stk);
+        } else {
+            // drop whatever the failed call left behind
+            while (vm->stk.n > base) {
+                ezc_obj left = ezc_stk_pop(&vm->stk);
+                ezc_obj_free(vm, &left);
+            }
+            res[i] = EZC_OBJ_EMPTY;
+        }
+    }
+    return status;
+}
 
+int ezc_vm_exec_stream(ezc_vm* vm, ezcp_stream* st) {
+    int n = ezcp_stream_ready(st);
+    if (n <= 0) return 0;
+
+    // a view of just the finished instructions
+    ezcp part = *st->prog;
+    part.body._block.n = n;
+    int status = ezc_vm_exec(vm, part);
+
+    ezcp_stream_drop(st, n);
+    return status;
+}
+
+// size of the chunks read by `ezc_vm_exec_file`
+#define EXEC_FILE_CHUNK (64 * 1024)
+
+int ezc_vm_exec_file(ezc_vm* vm, ezcp* prog, ezc_str src_name, FILE* fp) {
+    ezcp_stream st;
+    ezcp_stream_init(&st, prog, src_name);
+
+    char* buf = ezc_malloc(EXEC_FILE_CHUNK);
+    int status = 0;
+    size_t len;
+    while (status == 0 && (len = fread(buf, 1, EXEC_FILE_CHUNK, fp)) > 0) {
+        if (ezcp_stream_feed(&st, buf, (int)len) != 0) status = 1;
+        else if (ezc_vm_exec_stream(vm, &st) != 0) status = 2;
+    }
+    ezc_free(buf);
+
+    if (status == 0 && ferror(fp)) {
+        ezc_error("Failed reading '%.*s'", src_name.len, src_name._);
+        status = 1;
+    }
+
+    // compile whatever was left at the end, and run it
+    if (ezcp_stream_finish(&st) != 0) {
+        if (status == 0) status = 1;
+    } else if (status == 0 && ezc_vm_exec_stream(vm, &st) != 0) {
+        status = 2;
+    }
+    return status;
+}
 
@@ -31,6 +31,18 @@ void* ezc_realloc(void* ptr, size_t new_sz);
 void  ezc_free(void* ptr);
 // copies `sz` bytes from `src` to `dst`
 void  ezc_memcpy(void* dst, void* src, size_t sz);
+// starts counting the bytes allocated through `ezc_malloc` and `ezc_realloc`
+//   (for `ezc_mem_live`). Calls nest, and allocations are only counted
+//   between the first start and the last stop, so they stay cheap otherwise
+//   (a tracer counts from `ezc_tracer_init` until `ezc_tracer_free`)
+void ezc_mem_count_start();
+// stops counting allocations (see `ezc_mem_count_start`)
+void ezc_mem_count_stop();
+// returns the net number of bytes allocated through `ezc_malloc` and
+//   `ezc_realloc` since counting started (or 0, if the C library can't report
+//   allocation sizes). Memory allocated before that and freed while counting
+//   is subtracted, so this is the growth since then, and may be negative
+int64_t ezc_mem_live();
 
 /* logging/IO */
 
@@ -98,6 +110,9 @@ void ezc_str_concat(ezc_str* str, ezc_str A, ezc_str B);
 void ezc_str_append(ezc_str* str, ezc_str A);
 // appends a character to the string
 void ezc_str_append_c(ezc_str* str, char c);
+// makes sure `str` has memory of its own (copying it, if it was borrowed, see
+//   EZC_STR_BORROW), so it is NUL terminated, and can be changed
+void ezc_str_own(ezc_str* str);
 // frees a string and its resources
 void ezc_str_free(ezc_str* str);
 // compares two strings, should return strcmp(A._, B._)
@@ -131,13 +146,50 @@ void ezc_stk_swap(ezc_stk* stk, int idx, int jdx);
 
 
 /* ezcp functions */
-// initializes a program from a source string
-void ezcp_init(ezcp* prog, ezc_str src_name, ezc_str src);
+// initializes a program from a source string. Returns nonzero if there was an
+//   error compiling it (which is printed), in which case the program is
+//   incomplete, and shouldn't be executed (but must still be freed)
+int ezcp_init(ezcp* prog, ezc_str src_name, ezc_str src);
+// initializes a program from a source string owned by the caller, without
+//   copying it (i.e. a memory mapped file). `src` must stay valid and
+//   unchanged for as long as the program is used, and needn't be NUL
+//   terminated. Returns nonzero if there was an error, like `ezcp_init`
+int ezcp_init_borrow(ezcp* prog, ezc_str src_name, ezc_str src);
 // frees a program and all its resources
 void ezcp_free(ezcp* prog);
+// allocates a reference counted program, with a single reference (held by
+//   the caller). Initialize it with `ezcp_init`, then call `ezcp_decref` when
+//   done with it. It stays alive for as long as blocks from it are on a stack,
+//   or functions defined from it are in a VM
+ezcp* ezcp_new();
+// adds a reference to `prog`, if it is reference counted (see `ezcp_new`)
+void ezcp_incref(ezcp* prog);
+// removes a reference from `prog` (if it is reference counted), freeing it
+//   when the last reference is gone
+void ezcp_decref(ezcp* prog);
+
+// begins compiling `prog` incrementally, as chunks of source are fed in
+void ezcp_stream_init(ezcp_stream* st, ezcp* prog, ezc_str src_name);
+// compiles the next chunk of source. Tokens may be split between chunks.
+//   Returns nonzero if there was an error
+int ezcp_stream_feed(ezcp_stream* st, const char* data, int len);
+// returns the number of top level instructions which are finished, and can
+//   be executed (everything but a block which is still open)
+int ezcp_stream_ready(ezcp_stream* st);
+// drops the first `n` top level instructions (after they have been executed),
+//   so memory doesn't grow with the length of the source
+void ezcp_stream_drop(ezcp_stream* st, int n);
+// compiles anything left over, and frees the compile state (but not the
+//   program). Returns nonzero if there was an error
+int ezcp_stream_finish(ezcp_stream* st);
 
 /* ezc_vm functions */
 
+// initializes `vm` with the types and functions of `from`, sharing the
+//   compiled bodies of EZC functions instead of copying them. `from` must not
+//   be changed (or freed, along with the programs it was built from) while
+//   `vm` is being used, but each VM may then be used on its own thread
+void ezc_vm_init_shared(ezc_vm* vm, ezc_vm* from);
 // frees a vm and its resources
 void ezc_vm_free(ezc_vm* vm);
 // adds a function define to the VM
@@ -151,8 +203,229 @@ int ezc_vm_getfunci(ezc_vm* vm, ezc_str name);
 // or, -1 if not found
 int ezc_vm_gettypei(ezc_vm* vm, ezc_str name);
 
+/* object functions */
+
+// copies `from` into `obj` (setting its type as well). For shared types (see
+//   `ezct.shared`), the two then share the same resources, and `from` is
+//   updated to count it, so it must be the object itself (i.e. on the stack),
+//   not a copy of it
+int ezc_obj_copy(ezc_vm* vm, ezc_obj* obj, ezc_obj* from);
+// frees an object, or, if it's shared, drops it from the count (the
+//   resources are freed along with the last one)
+int ezc_obj_free(ezc_vm* vm, ezc_obj* obj);
+// makes sure `obj` is the only object with its resources, copying them if
+//   they're shared, so they can be changed in place (or taken)
+int ezc_obj_unshare(ezc_vm* vm, ezc_obj* obj);
+
+// adds a hook, which is called around every user function call
+int ezc_vm_addhook(ezc_vm* vm, ezc_hook hook);
+// calls all the hooks' `f_enter`, for a call to the function `name`
+void ezc_vm_hook_enter(ezc_vm* vm, ezc_str name);
+// calls all the hooks' `f_leave` (in reverse order), for a call to `name`
+void ezc_vm_hook_leave(ezc_vm* vm, ezc_str name);
+
 // executes a program on a VM
 int ezc_vm_exec(ezc_vm* vm, ezcp prog);
+// executes a function on a VM (calling the hooks for EZC functions, which are
+//   ran directly, without a program), where `name` is what it was called by
+int ezc_vm_exec_func(ezc_vm* vm, ezc_func func, ezc_str name);
+
+// looks up the function `name` once, so it can be called any number of times
+//   with `ezc_vm_call`, on `vm` or any VM created from it (see
+//   `ezc_vm_init_shared`). It keeps the body of an EZC function alive until
+//   `ezc_funcref_free`. Returns -1 if there is no such function
+int ezc_vm_getfunc(ezc_vm* vm, ezc_str name, ezc_funcref* ref);
+// frees a function looked up with `ezc_vm_getfunc`
+void ezc_funcref_free(ezc_funcref* ref);
+// pushes `args` (which are then owned by the VM) and calls the function.
+//   Whatever it returns is left on the stack. Returns nonzero if it failed
+int ezc_vm_call(ezc_vm* vm, ezc_funcref* ref, int n_args, ezc_obj* args);
+// calls the function `n_calls` times, the `i`th time with the `n_args`
+//   arguments starting at `args[i * n_args]` (which are all owned by the VM),
+//   storing the value each call returns in `res[i]`. Each call must leave
+//   exactly 1 value. If one fails, the rest aren't called (and their `res` are
+//   none), and its status is returned
+int ezc_vm_call_batch(ezc_vm* vm, ezc_funcref* ref, int n_calls, int n_args, ezc_obj* args, ezc_obj* res);
+// executes the finished top level instructions of a stream on a VM, then
+//   drops them
+int ezc_vm_exec_stream(ezc_vm* vm, ezcp_stream* st);
+// compiles `fp` into `prog` incrementally, executing each top level
+//   instruction as soon as it has been read, so execution starts right away
+//   and memory stays bounded for long inputs. Returns 0 if it all ran, 1 if
+//   it couldn't be read or compiled, or 2 if executing it failed (either
+//   stops it, and the error is printed)
+int ezc_vm_exec_file(ezc_vm* vm, ezcp* prog, ezc_str src_name, FILE* fp);
+
+
+/* profiling */
+
+// starts sampling `vm`, attributing one sample every `period` instructions
+//   to the instruction currently executing
+void ezc_prof_start(ezc_vm* vm, int period);
+// starts sampling `vm` with a profiling timer (SIGPROF), every `usec`
+//   microseconds of CPU time. Only one VM per process can use the timer
+void ezc_prof_start_timer(ezc_vm* vm, int usec);
+// stops sampling `vm` (but keeps the samples taken so far)
+void ezc_prof_stop(ezc_vm* vm);
+// called by the VM after each instruction, while profiling is enabled
+void ezc_prof_tick(ezc_vm* vm, ezci* inst);
+// prints the source of every program that was sampled to `out`, annotated
+//   with per-line and per-token sample percentages
+void ezc_prof_annotate(ezc_vm* vm, FILE* out);
+// frees the samples held by the profiler
+void ezc_prof_free(ezc_vm* vm);
+
+
+/* hardware performance counters */
+
+// opens and starts the hardware counters, returning how many could be opened
+// (0 if they are unavailable, i.e. not Linux, or restricted by
+//   `perf_event_paranoid`, or inside a container)
+int ezc_perf_open(ezc_perf* perf);
+// reads the current value of all counters (unavailable ones read as 0)
+void ezc_perf_read(ezc_perf* perf, ezc_perf_vals* vals);
+// attaches the counters to a VM, so each user function call is counted
+void ezc_perf_attach(ezc_perf* perf, ezc_vm* vm);
+// prints the counts since `ezc_perf_open`, and per function if attached
+void ezc_perf_report(ezc_perf* perf, FILE* out);
+// closes the counters, and frees their resources
+void ezc_perf_close(ezc_perf* perf);
+// returns a human-readable name of the counter `idx` (one of EZC_PERF_*)
+const char* ezc_perf_name(int idx);
+
+
+/* event tracing */
+
+// initializes a tracer, with no events
+void ezc_tracer_init(ezc_tracer* tr);
+// records the beginning of a span named `name`. If `vm` is not NULL, also
+//   records counters for its stack depth & live memory
+void ezc_tracer_begin(ezc_tracer* tr, ezc_vm* vm, ezc_str name);
+// records the end of a span named `name` (see ezc_tracer_begin)
+void ezc_tracer_end(ezc_tracer* tr, ezc_vm* vm, ezc_str name);
+// records the value of the counter `name`
+void ezc_tracer_counter(ezc_tracer* tr, ezc_str name, int64_t val);
+// attaches a tracer to a VM, so each user function call is recorded as a span
+void ezc_tracer_attach(ezc_tracer* tr, ezc_vm* vm);
+// writes all the recorded events to `fname` as Chrome trace event JSON,
+//   returning 0 on success
+int ezc_tracer_write(ezc_tracer* tr, const char* fname);
+// frees a tracer and its resources
+void ezc_tracer_free(ezc_tracer* tr);
+
+/* vectorized kernels */
+
+// computes `r[i] = a[i] op b[i]` for each `i` in `[0, n)`, where `op` is one
+//   of the EZC_VEC_* enums. If `sa` (or `sb`) is true, then `a` (or `b`) is a
+//   single value, used for every `i`. `r` may be the same as `a` or `b`
+void ezc_vec_real(int op, int n, ezc_real* r, const ezc_real* a, bool sa, const ezc_real* b, bool sb);
+// the same as `ezc_vec_real`, but for integers, which wrap around on
+//   overflow. For EZC_VEC_DIV, `b` must not contain 0
+void ezc_vec_int(int op, int n, ezc_int* r, const ezc_int* a, bool sa, const ezc_int* b, bool sb);
+// converts `n` integers to reals
+void ezc_vec_itor(int n, ezc_real* r, const ezc_int* a);
+// reduces `a[0:n]` with `op`, which is EZC_VEC_ADD (sum), EZC_VEC_MUL
+//   (product), EZC_VEC_MIN, or EZC_VEC_MAX. Sums are computed pairwise, so
+//   the rounding error grows with log(n) instead of n
+ezc_real ezc_vec_reduce_real(int op, int n, const ezc_real* a);
+// the same as `ezc_vec_reduce_real`, but for integers (sums and products
+//   wrap around on overflow)
+ezc_int ezc_vec_reduce_int(int op, int n, const ezc_int* a);
+
+/* number formatting */
+
+// the size of a buffer that can hold any formatted `ezc_int` (with the NUL)
+#define EZC_FMT_INT_MAX  24
+// the size of a buffer that can hold any formatted `ezc_real` (with the NUL)
+#define EZC_FMT_REAL_MAX 32
+
+// writes `x` in base 10 to `buf` (NUL terminated), and returns the length
+int ezc_fmt_int(char* buf, ezc_int x);
+// writes the shortest decimal form of `x` that reads back as exactly `x`
+//   (i.e. `0.1`, `2.5`, `3.0`, `1e+30`) to `buf` (NUL terminated), and
+//   returns the length
+int ezc_fmt_real(char* buf, ezc_real x);
+
+/* reading files */
+
+// opens `fname` for reading into `f`, memory mapping it if possible. Returns
+//   nonzero if it couldn't be opened
+int ezc_file_openr(ezc_file* f, const char* fname);
+// reads the next record of `f`, up to (but not including) `sep`, into `rec`,
+//   which is borrowed from the mapping if the file is mapped, or a new string
+//   otherwise. Returns 1 if there was a record, 0 at the end of the file, and
+//   -1 on an error
+int ezc_file_next(ezc_file* f, ezc_str sep, ezc_str* rec);
+// closes `f`, and frees its resources (its mapping is unmapped once the
+//   strings borrowed from it are freed too)
+void ezc_file_close(ezc_file* f);
+// takes another reference to the mapping with index `map` (see
+//   EZC_STR_MAPPED). References may be taken and dropped from any thread
+void ezc_file_map_incref(int map);
+// drops a reference to the mapping with index `map`, unmapping it if it was
+//   the last one
+void ezc_file_map_decref(int map);
+// writes `len` bytes from `data` to `f` (which is open for writing). Returns
+//   nonzero if they couldn't be written (or, for files written in the
+//   background, if an earlier write failed)
+int ezc_file_write(ezc_file* f, const void* data, size_t len);
+// writes all `n` pieces in `iov` to `f` (which is open for writing), after
+//   anything it has buffered already, in as few system calls as possible.
+//   Returns nonzero if they couldn't all be written
+int ezc_file_writev(ezc_file* f, ezc_iov* iov, int n);
+// flushes `f`, waiting for everything queued to be written, if it's written
+//   in the background. Returns nonzero if anything couldn't be written
+int ezc_file_flush(ezc_file* f);
+// starts writing `f` in the background, on a thread of its own, so writes
+//   just queue the data and return. Returns nonzero if it couldn't start
+int ezc_file_async(ezc_file* f);
+// waits for everything queued on every file written in the background to be
+//   written (this is done by the last `ezc_finalize`)
+void ezc_file_flush_all();
+// unmaps every file mapping still left (i.e. borrowed by strings which were
+//   never freed), which is done by the last `ezc_finalize`
+void ezc_file_unmap_all();
+
+/* buffered output */
+
+// returns room for `len` bytes at the end of the output of `vm`, which are
+//   added with `ezc_out_commit` once they're written
+char* ezc_out_reserve(ezc_vm* vm, int len);
+// adds `len` bytes (written to the result of `ezc_out_reserve`)
+void ezc_out_commit(ezc_vm* vm, int len);
+// adds `len` bytes from `data` to the output of `vm`
+void ezc_out_write(ezc_vm* vm, const char* data, int len);
+// adds formatted text to the output of `vm`
+void ezc_out_printf(ezc_vm* vm, const char* fmt, ...);
+// marks the end of a print, which is written out right away if `vm` isn't
+//   buffering (i.e. stdout is a terminal)
+void ezc_out_end(ezc_vm* vm);
+// writes out everything buffered by `vm`, and flushes stdout
+void ezc_out_flush(ezc_vm* vm);
+// writes out whatever the last VM to print on this thread has buffered, so
+//   anything printed directly to stdout (i.e. logs) comes after it
+void ezc_out_sync();
+// sets how `vm` writes its output (one of the EZC_OUT_* enums)
+void ezc_out_set_mode(ezc_vm* vm, int mode);
+// flushes, and frees, the output buffer of `vm`
+void ezc_out_free(ezc_vm* vm);
+
+/* thread pool */
+
+// initializes a pool with `n_workers` workers (counting the calling thread,
+//   so 1 starts no threads)
+void ezc_pool_init(ezc_pool* pool, int n_workers);
+// runs `fn(data, worker, task)` for each `task` in `[0, n_tasks)`, and
+//   returns once they're all done. Tasks run in any order, on any worker
+void ezc_pool_run(ezc_pool* pool, int n_tasks, ezc_pool_fn fn, void* data);
+// stops the workers, and frees the pool
+void ezc_pool_free(ezc_pool* pool);
+// sets the number of workers for the shared pool (see ezc_pool_shared). This
+//   only has an effect before the shared pool is first used
+void ezc_pool_set_workers(int n_workers);
+// returns the pool shared by the whole process (i.e. for `pforeach!`), which
+//   is started the first time it's needed, with one worker per CPU by default
+ezc_pool* ezc_pool_shared();
 
 
 /* random utility functions */
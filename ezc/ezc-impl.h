@@ -24,4 +24,30 @@
 // printf, output in general
 #include <stdio.h>
 
+/* text formatting macros */
+
+// Resets all formatting
+#define EC_RST   "\033[0m"
+// Sets text to be bold
+#define EC_BLD   "\033[1m"
+// Sets text to be underline
+#define EC_ULN   "\033[4m"
+// Sets text to be italicized
+#define EC_ITA   "\033[3m"
+
+// Sets text to be white (default)
+#define EC_WHT   "\033[37m"
+// Sets text to be red
+#define EC_RED   "\033[31m"
+// Sets text to be green
+#define EC_GRN   "\033[32m"
+// Sets text to be yellow
+#define EC_YLW   "\033[33m"
+// Sets text to be blue
+#define EC_BLU   "\033[34m"
+// Sets text to be magenta
+#define EC_MAG   "\033[35m"
+// Sets text to be cyan
+#define EC_CYN   "\033[36m"
+
 #endif /* EZC_IMPL_H_ */
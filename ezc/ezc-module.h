@@ -51,6 +51,14 @@
     T##EZC_MIFX##_type##_copy  \
 ));
 
+// register a type whose copies share their resources (see `ezct.shared`)
+#define EZC_REGISTER_TYPE_SHARED(_type) ezc_vm_addtype(vm, EZC_STR_CONST(#_type), EZCT_SHARED( \
+    T##EZC_MIFX##_type##_init, \
+    T##EZC_MIFX##_type##_free, \
+    T##EZC_MIFX##_type##_repr, \
+    T##EZC_MIFX##_type##_copy  \
+));
+
 // register a function by name (assumes you've defined it like: EZC_FUNC(name) { ... })
 #define EZC_REGISTER_FUNC(_name) ezc_vm_addfunc(vm, EZC_STR_CONST(#_name), EZC_FUNC_C(EZC_FUNC_NAME(_name)));
 
@@ -20,13 +20,15 @@
 #include "ezc-module.h"
 
 // uses a few functions from the standard library, like:
-//   * sprintf (for integer/real formatting)
+//   * sprintf (for formatting pointers, etc)
 #include <stdio.h>
 // uses a few functions from the math library, like:
 //   * fmod (for the `%` operator)
 //   * pow (for the `^` operator)
 //   * sqrt,sin,cos,... (for math library)
 #include <math.h>
+// for LONG_MAX (to check whether GMP's `long` functions can hold an `ezc_int`)
+#include <limits.h>
 
 /* utility macros */
 
@@ -38,10 +40,16 @@
 #define OBJ_T(_obj) (vm->types.vals[_obj.type])
 // Initializes an object (assumes .type is valid & correct)
 #define OBJ_INIT(_obj) (OBJ_T(_obj).f_init(&_obj))
-// Frees an object (assumes .type is valid & correct)
-#define OBJ_FREE(_obj) (OBJ_T(_obj).f_free(&_obj))
-// Copies `_from` to `_obj`, setting its type as well
-#define OBJ_COPY(_obj, _from) { _obj.type = _from.type; OBJ_T(_obj).f_copy(&_obj, &_from); }
+// Frees an object (assumes .type is valid & correct), or drops it from the
+//   count of a shared one (see `ezc_obj_free`)
+#define OBJ_FREE(_obj) (ezc_obj_free(vm, &(_obj)))
+// Copies `_from` to `_obj`, setting its type as well. `_from` must be the
+//   object itself (i.e. on the stack), since it may be changed to count the
+//   copy (see `ezc_obj_copy`)
+#define OBJ_COPY(_obj, _from) { ezc_obj_copy(vm, &(_obj), &(_from)); }
+// Makes sure an object doesn't share its resources with any others, so it can
+//   be changed in place (see `ezc_obj_unshare`)
+#define OBJ_UNSHARE(_obj) (ezc_obj_unshare(vm, &(_obj)))
 // Gets the string representation of an object (assumes .type is valid & correct)
 #define OBJ_REPR(_obj, _str) (OBJ_T(_obj).f_repr(&_obj, &_str))
 
@@ -54,11 +62,6 @@
 // pops and frees from the stack
 #define POP_FREE() { ezc_obj _popped = ezc_stk_pop(&vm->stk); OBJ_FREE(_popped); }
 
-/* static constants */
-
-// the characters representings digits in different bases
-static const char digitstr[] = EZC_DIGIT_STR;
-
 /* TYPE DEFINITIONS */
 
 /* none */
@@ -127,48 +130,9 @@ EZC_TF_FREE(int) {
 
 // returns the string representation (in base 10)
 EZC_TF_REPR(int) {
-    // using builtin functions
-    /*
-    char strs[10];
-
-    sprintf(strs, "%ld", obj->_int);
-    int len = strlen(strs);
-
-    ezc_str_copy_cp(str, strs, len);
-    */
-
-    // custom version built for EZC
-
-    ezc_int val = obj->_int;
-    int base = 10;
-
-    // output here
-    char strs[64];
-
-    int i = 0;
-    bool is_neg = false;
-
-    if (val < 0) {
-        val = -val;
-        strs[i++] = '-';
-        is_neg = true;
-    }
-
-    do {
-        strs[i++] = digitstr[val % base];
-        val /= base;
-    } while (val > 0);
-
-    // now, reverse it
-    int len = i;
-    for (i = is_neg ? 1 : 0; 2 * i < len; ++i) {
-        char tmp = strs[i];
-        strs[i] = strs[len-i-1];
-        strs[len-i-1] = tmp;
-    }
-
+    char strs[EZC_FMT_INT_MAX];
+    int len = ezc_fmt_int(strs, obj->_int);
     ezc_str_copy_cp(str, strs, len);
-
     return 0;
 }
 
@@ -223,65 +187,12 @@ EZC_TF_FREE(real) {
     return 0;
 }
 
-// returns the string representation of a real. Currently uses sprintf
-// TODO: Width, accuracy, etc maybe should change. I'm considering 
-// using environemnt variables, or like the global dictionary in the VM
-// In any case, this should be more changeable
+// returns the shortest string that reads back as the same real (see
+//   ezc/fmt.c), which always has a `.` or an exponent, i.e. `2.5`, `3.0`
 EZC_TF_REPR(real) {
-    char strs[100];
-
-    // using standard C functions:
-    sprintf(strs, "%lf", obj->_real);
-    ezc_str_copy_cp(str, strs, strlen(strs));
-
-    // custom impl, which has some nasty rounding issues
-    /*
-    // what base to use
-    int base = 10;
-
-    // integer (whole number part) of the number
-    ezc_int ival = (ezc_int)obj->_real;
-
-    // fractional value of the number
-    ezc_real fval = obj->_real;
-    fval -= ival;
-
-    int i = 0;
-    bool is_neg = false;
-
-    if (ival < 0) {
-        ival = -ival;
-        strs[i++] = '-';
-        is_neg = true;
-    }
-
-    do {
-        strs[i++] = digitstr[ival % base];
-        ival /= base;
-    } while (ival > 0);
-
-    // now, reverse it
-    int len = i;
-    for (i = is_neg ? 1 : 0; 2 * i < len; ++i) {
-        char tmp = strs[i];
-        strs[i] = strs[len-i-1];
-        strs[len-i-1] = tmp;
-    }
-    i = len;
-    strs[i++] = '.';
-
-    fval *= base;
-
-    do {
-        int cdig = (ezc_int)fval;
-        strs[i++] = digitstr[cdig];
-        fval -= cdig;
-        fval *= base;
-        len++;
-    } while (fval > 0.0 && i < 40);
-
-    ezc_str_copy_cp(str, strs, i);
-    */
+    char strs[EZC_FMT_REAL_MAX];
+    int len = ezc_fmt_real(strs, obj->_real);
+    ezc_str_copy_cp(str, strs, len);
     return 0;
 }
 
@@ -313,8 +224,15 @@ EZC_TF_REPR(str) {
     return 0;
 }
 
-// copy the entire string using the ezc_str method
+// copy the entire string using the ezc_str method, for a string that is about
+//   to be changed (borrowed strings, which are never changed in place, just
+//   share what they borrow)
 EZC_TF_COPY(str) {
+    if (from->_str.max_len < 0) {
+        obj->_str = from->_str;
+        if (EZC_STR_MAP(from->_str) >= 0) ezc_file_map_incref(EZC_STR_MAP(from->_str));
+        return 0;
+    }
     obj->_str = EZC_STR_NULL;
     ezc_str_copy(&obj->_str, from->_str);
     return 0;
@@ -328,13 +246,12 @@ EZC_TF_INIT(block) {
     return 0;
 }
 
-// don't actually free the instruction, because its just a reference to the
-//   compiler's data, which we shouldn't free. If people (or just me) start
-//   writing meta-compilers and things that are reaching up against memory walls,
-//   or, they are constructing their own blocks somehow, I may want to look at copying
-//   and freeing blocks. But for now, this is fine
+// the instruction itself is just a reference to the compiler's data, which
+//   isn't freed here, but the block holds a reference to its program (see
+//   `ezcp_new`), which may be freed once nothing else uses it
 EZC_TF_FREE(block) {
-    // do nothing
+    ezcp_decref(obj->_block.m_prog);
+    obj->_block = EZCI_EMPTY;
     return 0;
 }
 
@@ -348,25 +265,28 @@ EZC_TF_REPR(block) {
     return 0;
 }
 
-// just copylicate the data; nothing is freed so this is fine
+// just copylicate the data, with another reference to its program
 EZC_TF_COPY(block) {
     obj->_block = from->_block;
+    ezcp_incref(obj->_block.m_prog);
     return 0;
 }
 
 /* file type */
 
+// files are allocated, so copies (which are shared) see the same state
 EZC_TF_INIT(file) {
-    obj->_file = EZC_FILE_EMPTY;
+    obj->_file = ezc_malloc(sizeof(ezc_file));
+    *obj->_file = EZC_FILE_EMPTY;
     return 0;
 }
 
 EZC_TF_FREE(file) {
-    if (obj->_file.fp != NULL) {
-        fclose(obj->_file.fp);
-        obj->_file.fp = NULL;
+    if (obj->_file != NULL) {
+        ezc_file_close(obj->_file);
+        ezc_free(obj->_file);
+        obj->_file = NULL;
     }
-    ezc_str_free(&obj->_file.src_name);
     return 0;
 }
 
@@ -375,17 +295,217 @@ EZC_TF_FREE(file) {
 //   actual string of the instructions, pretty printed if possible
 EZC_TF_REPR(file) {
     char strs[100];
-    sprintf(strs, "FILE: %p [%s]", obj->_file.fp, obj->_file.src_name._);
+    sprintf(strs, "FILE: %p [%s]", obj->_file->fp, obj->_file->src_name._);
     ezc_str_copy_cp(str, strs, strlen(strs));
     return 0;
 }
 
-// just copylicate the data; nothing is freed so this is fine
+// copies of a file share it (see `ezct.shared`), and an open file can't be
+//   duplicated, so this is only ever a closed file with the same name
 EZC_TF_COPY(file) {
-    obj->_block = from->_block;
+    obj->_file = ezc_malloc(sizeof(ezc_file));
+    *obj->_file = EZC_FILE_EMPTY;
+    ezc_str_copy(&obj->_file->src_name, from->_file->src_name);
+    return 0;
+}
+
+/* array type */
+
+// the size of each element of an array
+#define ARRAY_ELEM_SIZE(_arr) ((_arr).elem == EZC_TYPE_REAL ? sizeof(ezc_real) : sizeof(ezc_int))
+
+// an empty array of integers
+EZC_TF_INIT(array) {
+    obj->_array.elem = EZC_TYPE_INT;
+    obj->_array.n = 0;
+    obj->_array._ptr = NULL;
+    return 0;
+}
+
+// the elements are the only thing allocated
+EZC_TF_FREE(array) {
+    ezc_free(obj->_array._ptr);
+    obj->_array._ptr = NULL;
+    obj->_array.n = 0;
+    return 0;
+}
+
+// the elements, separated by spaces, in brackets, i.e. `[1 2 3]`
+EZC_TF_REPR(array) {
+    ezc_str_copy_cp(str, "[", 1);
+    char strs[EZC_FMT_REAL_MAX + 1];
+    int i;
+    for (i = 0; i < obj->_array.n; ++i) {
+        int len = 0;
+        if (i > 0) strs[len++] = ' ';
+        if (obj->_array.elem == EZC_TYPE_REAL) {
+            len += ezc_fmt_real(strs + len, obj->_array._real[i]);
+        } else {
+            len += ezc_fmt_int(strs + len, obj->_array._int[i]);
+        }
+        ezc_str_append(str, EZC_STR_VIEW(strs, len));
+    }
+    ezc_str_append(str, EZC_STR_CONST("]"));
+    return 0;
+}
+
+// copies the elements
+EZC_TF_COPY(array) {
+    obj->_array = from->_array;
+    if (from->_array.n > 0) {
+        size_t sz = ARRAY_ELEM_SIZE(from->_array) * from->_array.n;
+        obj->_array._ptr = ezc_malloc(sz);
+        memcpy(obj->_array._ptr, from->_array._ptr, sz);
+    } else {
+        obj->_array._ptr = NULL;
+    }
+    return 0;
+}
+
+/* range type */
+
+// the empty range
+EZC_TF_INIT(range) {
+    obj->_range.lo = obj->_range.hi = 0;
+    return 0;
+}
+
+// nothing is allocated
+EZC_TF_FREE(range) {
+    return 0;
+}
+
+// the bounds, like `0..10` (which doesn't include 10)
+EZC_TF_REPR(range) {
+    char strs[2 * EZC_FMT_INT_MAX + 2];
+    int len = ezc_fmt_int(strs, obj->_range.lo);
+    strs[len++] = '.';
+    strs[len++] = '.';
+    len += ezc_fmt_int(strs + len, obj->_range.hi);
+    ezc_str_copy_cp(str, strs, len);
+    return 0;
+}
+
+// just copy the bounds
+EZC_TF_COPY(range) {
+    obj->_range = from->_range;
+    return 0;
+}
+
+/* zint type */
+
+#ifdef EZC_HAVE_GMP
+
+// zero
+EZC_TF_INIT(zint) {
+    mpz_init(obj->_zint);
+    return 0;
+}
+
+// the limbs are allocated by GMP
+EZC_TF_FREE(zint) {
+    mpz_clear(obj->_zint);
+    return 0;
+}
+
+// all of the digits, in base 10
+EZC_TF_REPR(zint) {
+    // room for the digits, a sign, and the NUL
+    char* strs = ezc_malloc(mpz_sizeinbase(obj->_zint, 10) + 2);
+    mpz_get_str(strs, 10, obj->_zint);
+    ezc_str_copy_cp(str, strs, strlen(strs));
+    ezc_free(strs);
+    return 0;
+}
+
+// copies the limbs
+EZC_TF_COPY(zint) {
+    mpz_init_set(obj->_zint, from->_zint);
+    return 0;
+}
+
+#else
+
+// without GMP, a `zint` is never created, so these just keep the slot
+
+EZC_TF_INIT(zint) {
+    return 0;
+}
+
+EZC_TF_FREE(zint) {
+    return 0;
+}
+
+EZC_TF_REPR(zint) {
+    ezc_str_copy_cp(str, "zint", 4);
+    return 0;
+}
+
+EZC_TF_COPY(zint) {
+    return 0;
+}
+
+#endif
+
+/* zreal type */
+
+#ifdef EZC_HAVE_MPFR
+
+// zero, with the default precision (`zreal!` uses the VM's precision)
+EZC_TF_INIT(zreal) {
+    mpfr_init2(obj->_zreal, EZC_ZREAL_PREC);
+    mpfr_set_si(obj->_zreal, 0, MPFR_RNDN);
+    return 0;
+}
+
+// the limbs are allocated by MPFR
+EZC_TF_FREE(zreal) {
+    mpfr_clear(obj->_zreal);
+    return 0;
+}
+
+// as many digits as the precision holds (log10(2) digits per bit)
+EZC_TF_REPR(zreal) {
+    int digits = (int)(mpfr_get_prec(obj->_zreal) * 0.30103);
+    if (digits < 1) digits = 1;
+    int len = mpfr_snprintf(NULL, 0, "%.*Rg", digits, obj->_zreal);
+    char* strs = ezc_malloc(len + 1);
+    mpfr_snprintf(strs, len + 1, "%.*Rg", digits, obj->_zreal);
+    ezc_str_copy_cp(str, strs, len);
+    ezc_free(strs);
+    return 0;
+}
+
+// copies the value, keeping its precision
+EZC_TF_COPY(zreal) {
+    mpfr_init2(obj->_zreal, mpfr_get_prec(from->_zreal));
+    mpfr_set(obj->_zreal, from->_zreal, MPFR_RNDN);
+    return 0;
+}
+
+#else
+
+// without MPFR, a `zreal` is never created, so these just keep the slot
+
+EZC_TF_INIT(zreal) {
+    return 0;
+}
+
+EZC_TF_FREE(zreal) {
+    return 0;
+}
+
+EZC_TF_REPR(zreal) {
+    ezc_str_copy_cp(str, "zreal", 5);
+    return 0;
+}
+
+EZC_TF_COPY(zreal) {
     return 0;
 }
 
+#endif
+
 /* functions in this module */
 
 /* basic functions */
@@ -416,17 +536,17 @@ EZC_FUNC(del) {
 }
 
 // | A copy!
-// copies the top of the stack, also copying its resources (i.e. it is a 
-//   deep-copy, and the two objects are now independent of each other)
+// copies the top of the stack. The two objects are independent of each other,
+//   but (for strings, arrays, files, ...) share their resources until one of
+//   them is changed, so this doesn't copy any data (see `ezc_obj_copy`)
 // this is equivalent to the builtin command: :
 // NOTE: Requires the stack to have >= 1 item
 EZC_FUNC(copy) {
     REQ_N(copy, 1);
-    ezc_obj top = ezc_stk_peek(&vm->stk);
 
-    // copy using the type's `copy` func
-    ezc_obj new_obj = (ezc_obj){ .type = top.type };
-    OBJ_COPY(new_obj, top);
+    // copy using the type's `copy` func (or share it)
+    ezc_obj new_obj = EZC_OBJ_EMPTY;
+    OBJ_COPY(new_obj, vm->stk.base[vm->stk.n - 1]);
 
     // push on the copy
     ezc_stk_push(&vm->stk, new_obj);
@@ -434,18 +554,16 @@ EZC_FUNC(copy) {
 }
 
 // | A B under!
-// copies the object under the top of the stack (B), also copying its resources
-//    (i.e. it is a deep copy), and the two objects are now independent of each
-//    other
+// copies the object under the top of the stack (A), just like `copy!`, and the
+//    two objects are now independent of each other
 // this is equivalent to the builtin command: _
 // NOTE: Requires the stack to have >= 2 items
 EZC_FUNC(under) {
     REQ_N(under, 2);
-    ezc_obj under = ezc_stk_peekn(&vm->stk, 1);
 
-    // copy using the type's `copy` func
+    // copy using the type's `copy` func (or share it)
     ezc_obj new_obj = EZC_OBJ_EMPTY;
-    OBJ_COPY(new_obj, under);
+    OBJ_COPY(new_obj, vm->stk.base[vm->stk.n - 2]);
 
     // push on the copy
     ezc_stk_push(&vm->stk, new_obj);
@@ -489,50 +607,41 @@ EZC_FUNC(funcdef) {
             return 0;
         } else {
             ezc_error("`body` is not type `block` in:\n[body] [name] funcdef!");
-            return -1;
         }
     } else {
         ezc_error("`name` is not type `str` in:\n[body] [name] funcdef!");
-        return -1;
     }
+    OBJ_FREE(f_name);
+    OBJ_FREE(f_body);
+    return -1;
 }
 
 // | idx get!
-// basically dereferences an index, and gets that item on the stack
+// basically dereferences an index, and pushes a copy of that item (see
+//   `copy!`) in place of the index
 // if idx is negative, get relative to the top (-1 -> top of stack), 
 //   (-2 -> under top), etc...
 // NOTE: Requires 1 item, but can throw an error if the index is out of range
 // TODO: Add strings as lookups to the global dictionary
-// TODO: Add range checks for valid values
 EZC_FUNC(get) {
     REQ_N(get, 1);
     ezc_obj idx = ezc_stk_pop(&vm->stk);
 
-    if (idx.type == EZC_TYPE_INT) {
-        if (idx._int >= 0) {
-            REQ_N(get, idx._int+1);
-            ezc_obj peeked = ezc_stk_get(&vm->stk, idx._int);
-            ezc_obj new_obj = EZC_OBJ_EMPTY;
-            OBJ_COPY(new_obj, peeked);
-            // replace top of stack
-            vm->stk.base[vm->stk.n - 1] = new_obj;
-        } else if (idx._int < 0) {
-            REQ_N(get, -idx._int);
-
-            ezc_obj peeked = ezc_stk_get(&vm->stk, vm->stk.n + idx._int);
-            ezc_obj new_obj = EZC_OBJ_EMPTY;
-            OBJ_COPY(new_obj, peeked);
-            // replace top of stack
-            vm->stk.base[vm->stk.n - 1] = new_obj;
-        } else {
-            ezc_error("`idx` must be >=0 in:\n[idx] get! (or $)");
-            return -1;
-        }
-    } else {
+    if (idx.type != EZC_TYPE_INT) {
         ezc_error("`idx` is not type `int` in:\n[idx] get! (or $)");
+        OBJ_FREE(idx);
+        return -1;
+    }
+
+    ezc_int i = idx._int >= 0 ? idx._int : vm->stk.n + idx._int;
+    if (i < 0 || i >= vm->stk.n) {
+        ezc_error("`idx` (%lld) is out of range for a stack of %d items in:\n[idx] get! (or $)", (long long)idx._int, vm->stk.n);
         return -1;
     }
 
+    ezc_obj new_obj = EZC_OBJ_EMPTY;
+    OBJ_COPY(new_obj, vm->stk.base[i]);
+    ezc_stk_push(&vm->stk, new_obj);
     return 0;
 }
 
@@ -553,28 +662,15 @@ EZC_FUNC(exec) {
         int idx = ezc_vm_getfunci(vm, code._str);
 
         if (idx < 0) { 
-            ezc_error("Unknown function: '%s'", code._str._);
+            ezc_error("Unknown function: '%.*s'", code._str.len, code._str._);
+            OBJ_FREE(code);
             return -1;
         } else {
-            // we have a valid function in the VM
-            ezc_func to_exec = vm->funcs.vals[idx];
-
-            if (to_exec.type == EZC_FUNC_TYPE_C) {
-                // this is a function implemented in C, so just call it on our VM
-                OBJ_FREE(code);
-                return to_exec._c(vm);
-            } else if (to_exec.type == EZC_FUNC_TYPE_EZC) {
-                // else, construct a phony program
-                ezcp _prog = EZCP_EMPTY;
-                _prog.body = to_exec._ezc;
-                _prog.src = to_exec._ezc.m_prog->src;
-                _prog.src_name = to_exec._ezc.m_prog->src_name;
-
-                // evaluate it using the EZC library
-                int status = ezc_vm_exec(vm, _prog);
-                OBJ_FREE(code);
-                return status;
-            }
+            // we have a valid function in the VM, which is ran directly (C
+            //   functions are just called, and EZC functions run their body)
+            int status = ezc_vm_exec_func(vm, vm->funcs.vals[idx], code._str);
+            OBJ_FREE(code);
+            return status;
         }
     } else if (code.type == EZC_TYPE_BLOCK) {
         // construct a phony program to execute
@@ -597,6 +693,9 @@ EZC_FUNC(exec) {
 // just exits, with an optional return code
 EZC_FUNC(exit) {
 
+    // nothing is written out after this
+    ezc_out_flush(vm);
+
     if (vm->stk.n == 0) {
         exit(0);
     }
@@ -638,10 +737,32 @@ EZC_FUNC(repr) {
     vm->stk.base[vm->stk.n - 1] = new_str;
 
     // free the object
-    TA.f_free(&A);
+    OBJ_FREE(A);
     return 0;
 }
 
+// adds the repr of `obj` to the output of `vm`, followed by `end`. Ints and
+//   reals are formatted straight into the output buffer, and everything else
+//   uses `tmp` for its repr, so printing in a loop doesn't allocate
+static void print_obj(ezc_vm* vm, ezc_obj obj, ezc_str* tmp, char end) {
+    char* strs;
+    int len;
+    if (obj.type == EZC_TYPE_INT) {
+        strs = ezc_out_reserve(vm, EZC_FMT_INT_MAX + 1);
+        len = ezc_fmt_int(strs, obj._int);
+    } else if (obj.type == EZC_TYPE_REAL) {
+        strs = ezc_out_reserve(vm, EZC_FMT_REAL_MAX + 1);
+        len = ezc_fmt_real(strs, obj._real);
+    } else {
+        OBJ_REPR(obj, *tmp);
+        ezc_out_write(vm, tmp->_, tmp->len);
+        ezc_out_write(vm, &end, 1);
+        return;
+    }
+    strs[len++] = end;
+    ezc_out_commit(vm, len);
+}
+
 // | A print!
 // pops off `A`, then prints it to console (i.e. its `repr` is printed)
 // To print without destroying it, run `:print!` instead, which makes a copy
@@ -653,18 +774,14 @@ EZC_FUNC(print) {
     // pop off from the stack
     ezc_obj A = ezc_stk_pop(&vm->stk);
 
-    // get the type
-    ezct TA = OBJ_T(A);
-
-    // get the repr
-    ezc_str reprA = EZC_STR_EMPTY;
-    TA.f_repr(&A, &reprA);
-
     // print it to stdout
-    fprintf(stdout, "%s\n", reprA._);
+    ezc_str tmp = EZC_STR_NULL;
+    print_obj(vm, A, &tmp, '\n');
+    ezc_out_end(vm);
+    ezc_str_free(&tmp);
 
     // free the original object
-    TA.f_free(&A);
+    OBJ_FREE(A);
     return 0;
 }
 
@@ -676,10 +793,10 @@ EZC_FUNC(printall) {
     ezc_str repr_str = EZC_STR_NULL;
     int i;
     for (i = 0; i < vm->stk.n; ++i) {
-        OBJ_REPR(vm->stk.base[i], repr_str);
-        printf("%s ", repr_str._);
+        print_obj(vm, vm->stk.base[i], &repr_str, ' ');
     }
-    printf("\n");
+    ezc_out_write(vm, "\n", 1);
+    ezc_out_end(vm);
 
     ezc_str_free(&repr_str);
     return 0;
@@ -696,14 +813,30 @@ EZC_FUNC(dump) {
     // loop through, printing everything each loop
     for (i = vm->stk.n - 1; i >= 0; --i) {
         ezc_obj cur = ezc_stk_get(&vm->stk, i);
-        OBJ_REPR(cur, str);
-        printf("%*d<%s>: %s\n", 2, i, TYPE_NAME(cur)._, str._);
+        ezc_out_printf(vm, "%*d<%s>: ", 2, i, TYPE_NAME(cur)._);
+        print_obj(vm, cur, &str, '\n');
     }
 
     // the only thing allocated is this string
     ezc_str_free(&str);
 
-    printf("-----\nstack[%d]\n", vm->stk.n);
+    ezc_out_printf(vm, "-----\nstack[%d]\n", vm->stk.n);
+    ezc_out_end(vm);
+    return 0;
+}
+
+// flush!
+// writes out everything printed so far (which is otherwise buffered, unless
+//   stdout is a terminal). If a FILE is on top (see `open!`), it's flushed
+//   instead (and kept on the stack), which, for files written in the
+//   background (see `async!`), waits for everything queued to be written
+EZC_FUNC(flush) {
+    if (vm->stk.n > 0 && ezc_stk_peek(&vm->stk).type == EZC_TYPE_FILE) {
+        ezc_obj fp = ezc_stk_peek(&vm->stk);
+        if (fp._file->fp == NULL || fp._file->reading) return 0;
+        return ezc_file_flush(fp._file) != 0 ? 1 : 0;
+    }
+    ezc_out_flush(vm);
     return 0;
 }
 
@@ -715,8 +848,382 @@ EZC_FUNC(dump) {
 #define TT_FREE() { OBJ_FREE(A); OBJ_FREE(B); }
 #define TT_TYPE_ER(_fname) { ezc_error("Invalid type combo for func `" #_fname "`: %s, %s", TYPE_NAME(A)._, TYPE_NAME(B)._); }
 
+// converts an int array to a real array, in place
+static void array_to_real(ezc_array* arr) {
+    if (arr->elem == EZC_TYPE_REAL) return;
+    ezc_real* reals = arr->n > 0 ? ezc_malloc(sizeof(ezc_real) * arr->n) : NULL;
+    ezc_vec_itor(arr->n, reals, arr->_int);
+    ezc_free(arr->_int);
+    arr->_real = reals;
+    arr->elem = EZC_TYPE_REAL;
+}
+
+// computes `A op B` (op is one of EZC_VEC_*) elementwise, where at least one
+//   of A and B is an array, and the other is an array of the same length, or
+//   an int or real (which is used for every element). The result is an int
+//   array if both sides are ints, and a real array otherwise
+static int array_op(ezc_vm* vm, int op, const char* fname) {
+    ezc_obj B = ezc_stk_pop(&vm->stk);
+    ezc_obj A = ezc_stk_pop(&vm->stk);
+
+    // which sides are scalars, and the type of their elements
+    bool sa = A.type != EZC_TYPE_ARRAY, sb = B.type != EZC_TYPE_ARRAY;
+    int ea = sa ? A.type : A._array.elem, eb = sb ? B.type : B._array.elem;
+
+    if ((ea != EZC_TYPE_INT && ea != EZC_TYPE_REAL) || (eb != EZC_TYPE_INT && eb != EZC_TYPE_REAL)) {
+        ezc_error("Invalid type combo for func `%s`: %s, %s", fname, TYPE_NAME(A)._, TYPE_NAME(B)._);
+        TT_FREE();
+        return 1;
+    }
+    if (!sa && !sb && A._array.n != B._array.n) {
+        ezc_error("Arrays must be the same length for func `%s`, but were %d and %d", fname, A._array.n, B._array.n);
+        TT_FREE();
+        return 1;
+    }
+
+    int n = sa ? B._array.n : A._array.n;
+
+    // the result is stored in place of the array on the left (or right), and
+    //   either may be converted to reals in place
+    if (!sa) OBJ_UNSHARE(A);
+    if (!sb) OBJ_UNSHARE(B);
+    ezc_obj R = sa ? B : A;
+
+    if (ea == EZC_TYPE_INT && eb == EZC_TYPE_INT) {
+        const ezc_int* pa = sa ? &A._int : A._array._int;
+        const ezc_int* pb = sb ? &B._int : B._array._int;
+        if (op == EZC_VEC_DIV) {
+            int i;
+            for (i = 0; i < (sb ? 1 : n); ++i) {
+                if (pb[i] == 0) {
+                    ezc_error("Division by zero in func `%s`", fname);
+                    TT_FREE();
+                    return 1;
+                }
+            }
+        }
+        ezc_vec_int(op, n, R._array._int, pa, sa, pb, sb);
+    } else {
+        // promote everything to reals
+        ezc_real xa = 0, xb = 0;
+        if (sa) xa = ea == EZC_TYPE_INT ? (ezc_real)A._int : A._real;
+        else array_to_real(&A._array);
+        if (sb) xb = eb == EZC_TYPE_INT ? (ezc_real)B._int : B._real;
+        else array_to_real(&B._array);
+
+        R = sa ? B : A;
+        ezc_vec_real(op, n, R._array._real, sa ? &xa : A._array._real, sa, sb ? &xb : B._array._real, sb);
+    }
+
+    // free the other array, if there were two
+    if (!sa && !sb) OBJ_FREE(B);
+    ezc_stk_push(&vm->stk, R);
+    return 0;
+}
+
+#ifdef EZC_HAVE_GMP
+
+// sets `z` to an int
+static void zint_set_int(mpz_t z, ezc_int x) {
+#if LONG_MAX >= INT64_MAX
+    mpz_set_si(z, (long)x);
+#else
+    uint64_t u = x < 0 ? -(uint64_t)x : (uint64_t)x;
+    mpz_import(z, 1, 1, sizeof(u), 0, 0, &u);
+    if (x < 0) mpz_neg(z, z);
+#endif
+}
+
+// converts an `int` or `zint` object to a `real`
+static ezc_real zint_to_real(ezc_obj obj) {
+    return obj.type == EZC_TYPE_ZINT ? mpz_get_d(obj._zint) : (ezc_real)obj._int;
+}
+
+// turns a `zint` back into an `int`, if it fits in one, so only the results
+//   that need it pay for big integers
+static void zint_norm(ezc_obj* obj) {
+#if LONG_MAX >= INT64_MAX
+    if (!mpz_fits_slong_p(obj->_zint) || mpz_cmp_si(obj->_zint, (long)EZC_INT_MIN) < 0 || mpz_cmp_si(obj->_zint, (long)EZC_INT_MAX) > 0) return;
+    ezc_int x = (ezc_int)mpz_get_si(obj->_zint);
+#else
+    if (mpz_sizeinbase(obj->_zint, 2) > EZC_INT_BITS - 1) return;
+    uint64_t u = 0;
+    mpz_export(&u, NULL, 1, sizeof(u), 0, 0, obj->_zint);
+    ezc_int x = mpz_sgn(obj->_zint) < 0 ? -(ezc_int)u : (ezc_int)u;
+#endif
+    mpz_clear(obj->_zint);
+    *obj = (ezc_obj){ .type = EZC_TYPE_INT, ._int = x };
+}
+
+// computes `A op B` (where `op` is EZCI_ADD, EZCI_SUB, ...) when either is a
+//   `zint`, or when the `int` fast path overflowed. Ints are promoted to
+//   `zint`s, and reals make the result a real
+static int zint_op(ezc_vm* vm, int op, const char* fname) {
+    ezc_obj B = ezc_stk_pop(&vm->stk);
+    ezc_obj A = ezc_stk_pop(&vm->stk);
+
+    bool ia = A.type == EZC_TYPE_INT || A.type == EZC_TYPE_ZINT, ib = B.type == EZC_TYPE_INT || B.type == EZC_TYPE_ZINT;
+
+    if ((ia && B.type == EZC_TYPE_REAL) || (A.type == EZC_TYPE_REAL && ib)) {
+        // no precision to keep, so just use reals
+        ezc_real x = A.type == EZC_TYPE_REAL ? A._real : zint_to_real(A);
+        ezc_real y = B.type == EZC_TYPE_REAL ? B._real : zint_to_real(B);
+        ezc_real r = 0.0;
+        switch (op) {
+            case EZCI_ADD: r = x + y; break;
+            case EZCI_SUB: r = x - y; break;
+            case EZCI_MUL: r = x * y; break;
+            case EZCI_DIV: r = x / y; break;
+            case EZCI_MOD: r = fmod(x, y); break;
+            case EZCI_POW: r = pow(x, y); break;
+        }
+        TT_FREE();
+        ezc_stk_push(&vm->stk, (ezc_obj){ .type = EZC_TYPE_REAL, ._real = r });
+        return 0;
+    } else if (!ia || !ib) {
+        ezc_error("Invalid type combo for func `%s`: %s, %s", fname, TYPE_NAME(A)._, TYPE_NAME(B)._);
+        TT_FREE();
+        return 1;
+    }
+
+    // promote any ints
+    if (A.type == EZC_TYPE_INT) {
+        ezc_int x = A._int;
+        A.type = EZC_TYPE_ZINT;
+        mpz_init(A._zint);
+        zint_set_int(A._zint, x);
+    }
+    if (B.type == EZC_TYPE_INT) {
+        ezc_int x = B._int;
+        B.type = EZC_TYPE_ZINT;
+        mpz_init(B._zint);
+        zint_set_int(B._zint, x);
+    }
+
+    if ((op == EZCI_DIV || op == EZCI_MOD) && mpz_sgn(B._zint) == 0) {
+        ezc_error("Division by zero in func `%s`", fname);
+        TT_FREE();
+        return 1;
+    }
+
+    ezc_obj R = (ezc_obj){ .type = EZC_TYPE_ZINT };
+    mpz_init(R._zint);
+    switch (op) {
+        case EZCI_ADD: mpz_add(R._zint, A._zint, B._zint); break;
+        case EZCI_SUB: mpz_sub(R._zint, A._zint, B._zint); break;
+        case EZCI_MUL: mpz_mul(R._zint, A._zint, B._zint); break;
+        // rounded toward zero, like `int`s
+        case EZCI_DIV: mpz_tdiv_q(R._zint, A._zint, B._zint); break;
+        case EZCI_MOD: mpz_tdiv_r(R._zint, A._zint, B._zint); break;
+        case EZCI_POW:
+            if (mpz_sgn(B._zint) < 0) {
+                // negative powers are 0, like `int`s
+                mpz_set_ui(R._zint, 0);
+            } else if (mpz_fits_ulong_p(B._zint)) {
+                mpz_pow_ui(R._zint, A._zint, mpz_get_ui(B._zint));
+            } else {
+                ezc_error("Exponent is too large for func `%s`", fname);
+                mpz_clear(R._zint);
+                TT_FREE();
+                return 1;
+            }
+            break;
+    }
+
+    TT_FREE();
+    zint_norm(&R);
+    ezc_stk_push(&vm->stk, R);
+    return 0;
+}
+
+// if either of the top two objects is a `zint`, computes the operation with
+//   `zint_op` instead
+#define ZINT_OP(_fname, _op) if (ezc_stk_peekn(&vm->stk, 0).type == EZC_TYPE_ZINT || ezc_stk_peekn(&vm->stk, 1).type == EZC_TYPE_ZINT) { return zint_op(vm, _op, #_fname); }
+
+// what to do when `int` arithmetic overflows (A and B must still be on the
+//   stack): redo it with `zint`s
+#define INT_OVERFLOW(_fname, _op) { return zint_op(vm, _op, #_fname); }
+
+#else
+
+#define ZINT_OP(_fname, _op)
+
+// without GMP, `int`s just wrap around
+#define INT_OVERFLOW(_fname, _op) { }
+
+#endif
+
+#ifdef EZC_HAVE_MPFR
+
+// the precision of new `zreal`s on a VM
+#define ZREAL_PREC(_vm) ((_vm)->zreal_prec > 0 ? (mpfr_prec_t)(_vm)->zreal_prec : (mpfr_prec_t)EZC_ZREAL_PREC)
+
+// whether an object can be converted to a `zreal`
+static bool zreal_can_set(ezc_obj obj) {
+    return obj.type == EZC_TYPE_INT || obj.type == EZC_TYPE_REAL || obj.type == EZC_TYPE_ZREAL
+#ifdef EZC_HAVE_GMP
+        || obj.type == EZC_TYPE_ZINT
+#endif
+    ;
+}
+
+// sets `r` to a number (which must pass `zreal_can_set`), rounding it to the
+//   precision of `r`
+static void zreal_set(mpfr_t r, ezc_obj obj) {
+    if (obj.type == EZC_TYPE_ZREAL) {
+        mpfr_set(r, obj._zreal, MPFR_RNDN);
+    } else if (obj.type == EZC_TYPE_REAL) {
+        mpfr_set_d(r, obj._real, MPFR_RNDN);
+#ifdef EZC_HAVE_GMP
+    } else if (obj.type == EZC_TYPE_ZINT) {
+        mpfr_set_z(r, obj._zint, MPFR_RNDN);
+#endif
+    } else {
+#if LONG_MAX >= INT64_MAX
+        mpfr_set_si(r, (long)obj._int, MPFR_RNDN);
+#else
+        // (a double can't hold every int, so go through an exact string)
+        char strs[32];
+        sprintf(strs, "%lld", (long long)obj._int);
+        mpfr_set_str(r, strs, 10, MPFR_RNDN);
+#endif
+    }
+}
+
+// whether the `zreal` `z` is exactly equal to `x` (which must pass
+//   `zreal_can_set`)
+static bool zreal_eq(ezc_obj z, ezc_obj x) {
+    // (the comparison functions treat NaN as equal to everything)
+    if (mpfr_nan_p(z._zreal)) return false;
+    if (x.type == EZC_TYPE_ZREAL) return mpfr_equal_p(z._zreal, x._zreal) != 0;
+    if (x.type == EZC_TYPE_REAL) return !isnan(x._real) && mpfr_cmp_d(z._zreal, x._real) == 0;
+#ifdef EZC_HAVE_GMP
+    if (x.type == EZC_TYPE_ZINT) return mpfr_cmp_z(z._zreal, x._zint) == 0;
+#endif
+#if LONG_MAX >= INT64_MAX
+    return mpfr_cmp_si(z._zreal, (long)x._int) == 0;
+#else
+    // an int needs at most 64 bits, so it is held exactly
+    mpfr_t tmp;
+    mpfr_init2(tmp, 64);
+    zreal_set(tmp, x);
+    bool res = mpfr_equal_p(z._zreal, tmp) != 0;
+    mpfr_clear(tmp);
+    return res;
+#endif
+}
+
+// `r = a op b`, where `r` may be the same as `a` or `b`
+static void zreal_apply(int op, mpfr_t r, mpfr_t a, mpfr_t b) {
+    switch (op) {
+        case EZCI_ADD: mpfr_add(r, a, b, MPFR_RNDN); break;
+        case EZCI_SUB: mpfr_sub(r, a, b, MPFR_RNDN); break;
+        case EZCI_MUL: mpfr_mul(r, a, b, MPFR_RNDN); break;
+        case EZCI_DIV: mpfr_div(r, a, b, MPFR_RNDN); break;
+        case EZCI_MOD: mpfr_fmod(r, a, b, MPFR_RNDN); break;
+        case EZCI_POW: mpfr_pow(r, a, b, MPFR_RNDN); break;
+    }
+}
+
+// computes `z op x` (or `x op z` if `!z_first`) into `z`, for the common
+//   cases MPFR has functions for, so no temporary is needed. Returns whether
+//   it was computed
+static bool zreal_apply_scalar(int op, mpfr_t z, ezc_obj x, bool z_first) {
+#if LONG_MAX >= INT64_MAX
+    if (x.type == EZC_TYPE_INT) {
+        long y = (long)x._int;
+        switch (op) {
+            case EZCI_ADD: mpfr_add_si(z, z, y, MPFR_RNDN); return true;
+            case EZCI_MUL: mpfr_mul_si(z, z, y, MPFR_RNDN); return true;
+            case EZCI_SUB:
+                if (z_first) mpfr_sub_si(z, z, y, MPFR_RNDN);
+                else mpfr_si_sub(z, y, z, MPFR_RNDN);
+                return true;
+            case EZCI_DIV:
+                if (z_first) mpfr_div_si(z, z, y, MPFR_RNDN);
+                else mpfr_si_div(z, y, z, MPFR_RNDN);
+                return true;
+            case EZCI_POW:
+                if (!z_first) return false;
+                mpfr_pow_si(z, z, y, MPFR_RNDN);
+                return true;
+        }
+        return false;
+    }
+#endif
+    if (x.type == EZC_TYPE_REAL) {
+        double y = x._real;
+        switch (op) {
+            case EZCI_ADD: mpfr_add_d(z, z, y, MPFR_RNDN); return true;
+            case EZCI_MUL: mpfr_mul_d(z, z, y, MPFR_RNDN); return true;
+            case EZCI_SUB:
+                if (z_first) mpfr_sub_d(z, z, y, MPFR_RNDN);
+                else mpfr_d_sub(z, y, z, MPFR_RNDN);
+                return true;
+            case EZCI_DIV:
+                if (z_first) mpfr_div_d(z, z, y, MPFR_RNDN);
+                else mpfr_d_div(z, y, z, MPFR_RNDN);
+                return true;
+        }
+    }
+    return false;
+}
+
+// computes `A op B` (where `op` is EZCI_ADD, EZCI_SUB, ...) when either is a
+//   `zreal`. The result is computed in place, in one of the `zreal`s, so
+//   chains of operations don't allocate a new one for every intermediate
+//   result. It keeps the precision of that `zreal`
+static int zreal_op(ezc_vm* vm, int op, const char* fname) {
+    ezc_obj B = ezc_stk_pop(&vm->stk);
+    ezc_obj A = ezc_stk_pop(&vm->stk);
+
+    if (!zreal_can_set(A) || !zreal_can_set(B)) {
+        ezc_error("Invalid type combo for func `%s`: %s, %s", fname, TYPE_NAME(A)._, TYPE_NAME(B)._);
+        TT_FREE();
+        return 1;
+    }
+
+    // `R` holds the result, and `X` is the other operand
+    bool r_first = A.type == EZC_TYPE_ZREAL;
+    if (r_first) OBJ_UNSHARE(A);
+    else OBJ_UNSHARE(B);
+    ezc_obj R = r_first ? A : B, X = r_first ? B : A;
+
+    if (X.type == EZC_TYPE_ZREAL) {
+        zreal_apply(op, R._zreal, A._zreal, B._zreal);
+    } else if (!zreal_apply_scalar(op, R._zreal, X, r_first)) {
+        mpfr_t tmp;
+        mpfr_init2(tmp, mpfr_get_prec(R._zreal));
+        zreal_set(tmp, X);
+        if (r_first) zreal_apply(op, R._zreal, R._zreal, tmp);
+        else zreal_apply(op, R._zreal, tmp, R._zreal);
+        mpfr_clear(tmp);
+    }
+
+    OBJ_FREE(X);
+    ezc_stk_push(&vm->stk, R);
+    return 0;
+}
+
+// if either of the top two objects is a `zreal`, computes the operation with
+//   `zreal_op` instead
+#define ZREAL_OP(_fname, _op) if (ezc_stk_peekn(&vm->stk, 0).type == EZC_TYPE_ZREAL || ezc_stk_peekn(&vm->stk, 1).type == EZC_TYPE_ZREAL) { return zreal_op(vm, _op, #_fname); }
+
+#else
+
+#define ZREAL_OP(_fname, _op)
+
+#endif
+
+// if either of the top two objects is an array, computes the operation with
+//   `array_op` instead of on scalars
+#define ARRAY_OP(_fname, _op) if (ezc_stk_peekn(&vm->stk, 0).type == EZC_TYPE_ARRAY || ezc_stk_peekn(&vm->stk, 1).type == EZC_TYPE_ARRAY) { return array_op(vm, _op, #_fname); }
+
 EZC_FUNC(add) {
     REQ_N(add, 2);
+    ARRAY_OP(add, EZC_VEC_ADD);
+    ZREAL_OP(add, EZCI_ADD);
+    ZINT_OP(add, EZCI_ADD);
     // compute A+B
     ezc_obj B = ezc_stk_peekn(&vm->stk, 0);
     ezc_obj A = ezc_stk_peekn(&vm->stk, 1);
@@ -725,12 +1232,14 @@ EZC_FUNC(add) {
         // these should only really pop off one, and free the other one.
         // Most primitive types shouldn't even need to be freed
         if (TT_CASES(EZC_TYPE_STR)) {
+            // `A` is appended to in place, so it can't be shared
+            OBJ_UNSHARE(A);
             ezc_str_append(&A._str, B._str);
             vm->stk.base[--vm->stk.n - 1] = A;
             OBJ_FREE(B);
             return 0;
         } else if (TT_CASES(EZC_TYPE_INT)) {
-            A._int += B._int;
+            if (__builtin_add_overflow(A._int, B._int, &A._int)) INT_OVERFLOW(add, EZCI_ADD);
             vm->stk.base[--vm->stk.n - 1] = A;
             return 0;
         } else if (TT_CASES(EZC_TYPE_REAL)) {
@@ -764,6 +1273,9 @@ EZC_FUNC(add) {
 
 EZC_FUNC(sub) {
     REQ_N(sub, 2);
+    ARRAY_OP(sub, EZC_VEC_SUB);
+    ZREAL_OP(sub, EZCI_SUB);
+    ZINT_OP(sub, EZCI_SUB);
     // compute A-B
     ezc_obj B = ezc_stk_peekn(&vm->stk, 0);
     ezc_obj A = ezc_stk_peekn(&vm->stk, 1);
@@ -772,7 +1284,7 @@ EZC_FUNC(sub) {
         // these should only really pop off one, and free the other one.
         // Most primitive types shouldn't even need to be freed
         if (TT_CASES(EZC_TYPE_INT)) {
-            A._int -= B._int;
+            if (__builtin_sub_overflow(A._int, B._int, &A._int)) INT_OVERFLOW(sub, EZCI_SUB);
             vm->stk.base[--vm->stk.n - 1] = A;
             return 0;
         } else if (TT_CASES(EZC_TYPE_REAL)) {
@@ -806,6 +1318,9 @@ EZC_FUNC(sub) {
 
 EZC_FUNC(mul) {
     REQ_N(mul, 2);
+    ARRAY_OP(mul, EZC_VEC_MUL);
+    ZREAL_OP(mul, EZCI_MUL);
+    ZINT_OP(mul, EZCI_MUL);
     // compute A*B
     ezc_obj B = ezc_stk_peekn(&vm->stk, 0);
     ezc_obj A = ezc_stk_peekn(&vm->stk, 1);
@@ -814,7 +1329,7 @@ EZC_FUNC(mul) {
         // these should only really pop off one, and free the other one.
         // Most primitive types shouldn't even need to be freed
         if (TT_CASES(EZC_TYPE_INT)) {
-            A._int *= B._int;
+            if (__builtin_mul_overflow(A._int, B._int, &A._int)) INT_OVERFLOW(mul, EZCI_MUL);
             vm->stk.base[--vm->stk.n - 1] = A;
             return 0;
         } else if (TT_CASES(EZC_TYPE_REAL)) {
@@ -848,6 +1363,9 @@ EZC_FUNC(mul) {
 
 EZC_FUNC(div) {
     REQ_N(div, 2);
+    ARRAY_OP(div, EZC_VEC_DIV);
+    ZREAL_OP(div, EZCI_DIV);
+    ZINT_OP(div, EZCI_DIV);
     // compute A/B
     ezc_obj B = ezc_stk_peekn(&vm->stk, 0);
     ezc_obj A = ezc_stk_peekn(&vm->stk, 1);
@@ -856,7 +1374,18 @@ EZC_FUNC(div) {
         // these should only really pop off one, and free the other one.
         // Most primitive types shouldn't even need to be freed
         if (TT_CASES(EZC_TYPE_INT)) {
-            A._int /= B._int;
+            if (B._int == 0) {
+                ezc_error("Division by zero in func `div`");
+                vm->stk.n -= 2;
+                return 1;
+            }
+            // the only quotient that overflows
+            if (A._int == EZC_INT_MIN && B._int == -1) {
+                INT_OVERFLOW(div, EZCI_DIV);
+                A._int = EZC_INT_MIN;
+            } else {
+                A._int /= B._int;
+            }
             vm->stk.base[--vm->stk.n - 1] = A;
             return 0;
         } else if (TT_CASES(EZC_TYPE_REAL)) {
@@ -890,6 +1419,8 @@ EZC_FUNC(div) {
 
 EZC_FUNC(mod) {
     REQ_N(mod, 2);
+    ZREAL_OP(mod, EZCI_MOD);
+    ZINT_OP(mod, EZCI_MOD);
     // compute A%B
     ezc_obj B = ezc_stk_peekn(&vm->stk, 0);
     ezc_obj A = ezc_stk_peekn(&vm->stk, 1);
@@ -898,7 +1429,13 @@ EZC_FUNC(mod) {
         // these should only really pop off one, and free the other one.
         // Most primitive types shouldn't even need to be freed
         if (TT_CASES(EZC_TYPE_INT)) {
-            A._int %= B._int;
+            if (B._int == 0) {
+                ezc_error("Division by zero in func `mod`");
+                vm->stk.n -= 2;
+                return 1;
+            }
+            // (MIN % -1 is 0, but traps on some CPUs)
+            A._int = B._int == -1 ? 0 : A._int % B._int;
             vm->stk.base[--vm->stk.n - 1] = A;
             return 0;
         } else if (TT_CASES(EZC_TYPE_REAL)) {
@@ -932,6 +1469,9 @@ EZC_FUNC(mod) {
 
 EZC_FUNC(pow) {
     REQ_N(pow, 2);
+    ARRAY_OP(pow, EZC_VEC_POW);
+    ZREAL_OP(pow, EZCI_POW);
+    ZINT_OP(pow, EZCI_POW);
     // compute A^B
     ezc_obj B = ezc_stk_pop(&vm->stk);
     ezc_obj A = ezc_stk_pop(&vm->stk);
@@ -942,6 +1482,7 @@ EZC_FUNC(pow) {
             ezc_int a = A._int;
             ezc_int b = B._int;
             ezc_int r = 1;
+            bool ovf = false;
 
             if (b < 0) r = 0;
             else if (b == 1) r = a;
@@ -949,11 +1490,22 @@ EZC_FUNC(pow) {
                 // a^2^iter
                 ezc_int a2iter = a;
                 do {
-                    if (b & 1) r *= a2iter;
-                    a2iter *= a2iter;
+                    if (b & 1) ovf |= __builtin_mul_overflow(r, a2iter, &r);
                     b >>= 1;
+                    // (the last square isn't used, so it may overflow)
+                    if (b > 0) ovf |= __builtin_mul_overflow(a2iter, a2iter, &a2iter);
                 } while (b > 0);
             }
+#ifdef EZC_HAVE_GMP
+            if (ovf) {
+                // put them back, and redo it with `zint`s
+                ezc_stk_push(&vm->stk, A);
+                ezc_stk_push(&vm->stk, B);
+                return zint_op(vm, EZCI_POW, "pow");
+            }
+#else
+            (void)ovf;
+#endif
             ezc_stk_push(&vm->stk, (ezc_obj){ .type = EZC_TYPE_INT, ._int = r });
         } else if (A.type == EZC_TYPE_REAL) {
             ezc_stk_push(&vm->stk, (ezc_obj){ .type = EZC_TYPE_REAL, ._real = pow(A._real, B._real) });
@@ -1004,11 +1556,24 @@ EZC_FUNC(eq) {
     ezc_obj B = ezc_stk_pop(&vm->stk);
     ezc_obj A = ezc_stk_pop(&vm->stk);
 
+#ifdef EZC_HAVE_MPFR
+    if ((A.type == EZC_TYPE_ZREAL || B.type == EZC_TYPE_ZREAL) && zreal_can_set(A) && zreal_can_set(B)) {
+        bool res = zreal_eq(A.type == EZC_TYPE_ZREAL ? A : B, A.type == EZC_TYPE_ZREAL ? B : A);
+        OBJ_FREE(A); OBJ_FREE(B);
+        ezc_stk_push(&vm->stk, (ezc_obj){ .type = EZC_TYPE_BOOL, ._bool = res });
+        return 0;
+    }
+#endif
+
     if (A.type == B.type) {
         if (A.type == EZC_TYPE_INT) {
             ezc_stk_push(&vm->stk, (ezc_obj){ .type = EZC_TYPE_BOOL, ._bool = A._int == B._int });
         } else if (A.type == EZC_TYPE_REAL) {
             ezc_stk_push(&vm->stk, (ezc_obj){ .type = EZC_TYPE_BOOL, ._real = A._real == B._real });
+#ifdef EZC_HAVE_GMP
+        } else if (A.type == EZC_TYPE_ZINT) {
+            ezc_stk_push(&vm->stk, (ezc_obj){ .type = EZC_TYPE_BOOL, ._bool = mpz_cmp(A._zint, B._zint) == 0 });
+#endif
         } else {
             ezc_error("Invalid type for func `eq`: %s", TYPE_NAME(A)._);
             OBJ_FREE(A); OBJ_FREE(B);
@@ -1016,6 +1581,13 @@ EZC_FUNC(eq) {
         }
         OBJ_FREE(A); OBJ_FREE(B);
         return 0;
+#ifdef EZC_HAVE_GMP
+    } else if (TT_CASE(EZC_TYPE_INT, EZC_TYPE_ZINT) || TT_CASE(EZC_TYPE_ZINT, EZC_TYPE_INT)) {
+        // a `zint` is only kept when it doesn't fit in an `int`
+        OBJ_FREE(A); OBJ_FREE(B);
+        ezc_stk_push(&vm->stk, (ezc_obj){ .type = EZC_TYPE_BOOL, ._bool = false });
+        return 0;
+#endif
     } else {
         ezc_error("Invalid type combo for func `eq`: %s, %s", TYPE_NAME(A)._, TYPE_NAME(B)._);
         OBJ_FREE(A); OBJ_FREE(B);
@@ -1042,74 +1614,112 @@ EZC_FUNC(ifel) {
     bool cond_val = false;
     OBJ_TRUTHY(cond, cond_val);
 
+    // `exec!` consumes the branch it runs, so only the other is freed here
     if (cond_val) {
+        OBJ_FREE(b_else);
         ezc_stk_push(&vm->stk, b_if);
         EZC_FUNC_NAME(exec)(vm);
     } else {
+        OBJ_FREE(b_if);
         ezc_stk_push(&vm->stk, b_else);
         EZC_FUNC_NAME(exec)(vm);
     }
 
-    OBJ_FREE(b_else);
-    OBJ_FREE(b_if);
     OBJ_FREE(cond);
     return 0;
 }
 
-// | A... {code-to-run} foreach!
-// pops off a block of instructions, and then takes however many arguments are on 
-//   the stack, or until a wall (|) is encountered. If the wall is encountered, it
-//   is popped too. Then, each object that was popped off is popped back on, and the
-//   code-to-run block is ran.
-// Example: | A B C {print!} foreach! prints A, then B, then C
-// NOTE: Requires at least 1 argument
-EZC_FUNC(foreach) {
-    REQ_N(foreach, 1);
-    // first pop off the body
-    ezc_obj body = ezc_stk_pop(&vm->stk);
+// returns the number of objects on top of the stack, above the nearest wall
+//   (|), or the whole stack if there is no wall
+static int wall_depth(ezc_vm* vm) {
+    int n = 0;
 
-    // TODO: Also allow other things to be executed
-    if (body.type != EZC_TYPE_BLOCK) {
-        ezc_stk_push(&vm->stk, body);
-        ezc_error("Expected the block for `foreach` to be of type `block` (like {...}), but got `%s`", TYPE_NAME(body)._);
-        return 1;
+    // now, keep going until stack hits wall or is empty
+    while (n < vm->stk.n && ezc_stk_peekn(&vm->stk, n).type != EZC_TYPE_WALL) {
+        n++;
     }
+    return n;
+}
 
-    // how many objects to iterate?
-    int num_to_iter = 0;
+// returns the number of integers in a range (unsigned, since it may not fit in
+//   an `ezc_int`)
+#define RANGE_LEN(_range) ((uint64_t)(_range).hi - (uint64_t)(_range).lo)
 
-    // now, keep going until stack hits wall or is empty
-    while (num_to_iter < vm->stk.n && ezc_stk_peekn(&vm->stk, num_to_iter).type != EZC_TYPE_WALL) {
-        num_to_iter++;
+// returns whether `n` more objects fit on the stack of `vm` (see
+//   `EZC_STK_MAX`), otherwise prints an error for `func` and returns false
+static bool stk_fits(ezc_vm* vm, const char* func, uint64_t n) {
+    if (n > (uint64_t)(EZC_STK_MAX - vm->stk.n)) {
+        ezc_error("%s!: %llu items won't fit on the stack (which holds at most %d)", func, (unsigned long long)n, EZC_STK_MAX);
+        return false;
     }
+    return true;
+}
+
+// pops the objects from the top of the stack down to the nearest wall (|),
+//   or the whole stack if there is no wall, into `args` (in the order they
+//   were pushed), and consumes the wall. Returns the number of objects
+static int pop_to_wall(ezc_vm* vm, ezc_stk* args) {
+    // how many objects to iterate?
+    int num_to_iter = wall_depth(vm);
 
     // quit out early
     if (num_to_iter < 1) {
-        OBJ_FREE(body);
         return 0;
     }
 
     // offset of the start of objects to be popped off
     int stk_offset = vm->stk.n - num_to_iter;
 
-    // start another temporary stack, storing everything popped off
-    ezc_stk argstack = EZC_STK_EMPTY;
-    ezc_stk_resize(&argstack, num_to_iter);
+    ezc_stk_resize(args, num_to_iter);
 
     // now, basically pop off all the objects onto the temporary stack
     int i;
     for (i = 0; i < num_to_iter; ++i) {
-        argstack.base[i] = vm->stk.base[i + stk_offset];
+        args->base[i] = vm->stk.base[i + stk_offset];
     }
 
     // reset the main stack back
     vm->stk.n -= num_to_iter;
 
     // consume the wall if used
-    if (ezc_stk_peek(&vm->stk).type == EZC_TYPE_WALL) {
+    if (vm->stk.n > 0 && ezc_stk_peek(&vm->stk).type == EZC_TYPE_WALL) {
         ezc_stk_pop(&vm->stk);
     }
 
+    return num_to_iter;
+}
+
+// | A... {code-to-run} foreach!
+// pops off a block of instructions, and then takes however many arguments are on 
+//   the stack, or until a wall (|) is encountered. If the wall is encountered, it
+//   is popped too. Then, each object that was popped off is popped back on, and the
+//   code-to-run block is ran.
+// Ranges (see `range!`) are ran on each of their integers, without creating them
+//   all at once
+// Example: | A B C {print!} foreach! prints A, then B, then C
+// NOTE: Requires at least 1 argument
+EZC_FUNC(foreach) {
+    REQ_N(foreach, 1);
+    // first pop off the body
+    ezc_obj body = ezc_stk_pop(&vm->stk);
+
+    // TODO: Also allow other things to be executed
+    if (body.type != EZC_TYPE_BLOCK) {
+        ezc_stk_push(&vm->stk, body);
+        ezc_error("Expected the block for `foreach` to be of type `block` (like {...}), but got `%s`", TYPE_NAME(body)._);
+        return 1;
+    }
+
+    // start another temporary stack, storing everything popped off
+    ezc_stk argstack = EZC_STK_EMPTY;
+    int num_to_iter = pop_to_wall(vm, &argstack);
+
+    // quit out early
+    if (num_to_iter < 1) {
+        OBJ_FREE(body);
+        return 0;
+    }
+
     // create the program to run on each iteration
     ezcp _prog = EZCP_EMPTY;
     _prog.body = body._block;
@@ -1120,47 +1730,248 @@ EZC_FUNC(foreach) {
     int status = 0;
 
     // just run through, popping the arguments on the stack
-    for (i = 0; i < num_to_iter; ++i) {
+    int i;
+    for (i = 0; i < num_to_iter && status == 0; ++i) {
+        if (argstack.base[i].type == EZC_TYPE_RANGE) {
+            // ranges are iterated one integer at a time, instead of all at once
+            ezc_int j;
+            for (j = argstack.base[i]._range.lo; j < argstack.base[i]._range.hi && status == 0; ++j) {
+                ezc_stk_push(&vm->stk, (ezc_obj){ .type = EZC_TYPE_INT, ._int = j });
+                status = ezc_vm_exec(vm, _prog);
+            }
+            continue;
+        }
         ezc_stk_push(&vm->stk, argstack.base[i]);
         status = ezc_vm_exec(vm, _prog);
-        if (status != 0) return status;
     }
 
-    // free the temporary stack
+    // free the items that weren't reached (after an error), and the temporary
+    //   stack
+    for (; i < num_to_iter; ++i) {
+        OBJ_FREE(argstack.base[i]);
+    }
     ezc_stk_free(&argstack);
+    OBJ_FREE(body);
 
+    return status;
+}
+
+/* parallel helpers */
+
+// VMs for the workers of a pool, each created from `vm` the first time that
+//   worker runs a task. `vm` must not be touched until they're freed
+typedef struct {
+    ezc_vm* vm;
+    int n;
+    ezc_vm* vals;
+    bool* started;
+} worker_vms;
+
+static void worker_vms_init(worker_vms* wv, ezc_vm* vm, ezc_pool* pool) {
+    // what was printed before should come before what the workers print
+    ezc_out_flush(vm);
+    wv->vm = vm;
+    wv->n = pool->n_workers;
+    wv->vals = ezc_malloc(sizeof(ezc_vm) * wv->n);
+    wv->started = ezc_malloc(sizeof(bool) * wv->n);
+    int i;
+    for (i = 0; i < wv->n; ++i) {
+        wv->started[i] = false;
+    }
+}
+
+// returns the VM for `worker` (which is only ever used by that worker)
+static ezc_vm* worker_vms_get(worker_vms* wv, int worker) {
+    if (!wv->started[worker]) {
+        ezc_vm_init_shared(&wv->vals[worker], wv->vm);
+        wv->started[worker] = true;
+    }
+    return &wv->vals[worker];
+}
+
+static void worker_vms_free(worker_vms* wv) {
+    int i;
+    for (i = 0; i < wv->n; ++i) {
+        if (wv->started[i]) ezc_vm_free(&wv->vals[i]);
+    }
+    ezc_free(wv->vals);
+    ezc_free(wv->started);
+}
+
+// replaces each range in `args` with all of its integers, or returns nonzero
+//   (leaving `args` as it was) if there would be too many for a stack
+static int expand_ranges(ezc_vm* vm, const char* func, ezc_stk* args) {
+    uint64_t n = 0;
+    bool any = false;
+    int i;
+    for (i = 0; i < args->n; ++i) {
+        bool is_range = args->base[i].type == EZC_TYPE_RANGE;
+        uint64_t len = is_range ? RANGE_LEN(args->base[i]._range) : 1;
+        // (checked as it goes, so the sum can't wrap around)
+        if (len > EZC_STK_MAX - n) {
+            ezc_error("%s!: too many items for a stack (which holds at most %d)", func, EZC_STK_MAX);
+            return 1;
+        }
+        n += len;
+        any = any || is_range;
+    }
+    if (!any) return 0;
+
+    ezc_stk res = EZC_STK_EMPTY;
+    for (i = 0; i < args->n; ++i) {
+        if (args->base[i].type == EZC_TYPE_RANGE) {
+            ezc_int j;
+            for (j = args->base[i]._range.lo; j < args->base[i]._range.hi; ++j) {
+                ezc_stk_push(&res, (ezc_obj){ .type = EZC_TYPE_INT, ._int = j });
+            }
+        } else {
+            ezc_stk_push(&res, args->base[i]);
+        }
+    }
+    ezc_stk_free(args);
+    *args = res;
     return 0;
 }
 
+// the state shared by the tasks of a `pforeach!`
+typedef struct {
+    // the body to run on each item
+    ezcp prog;
+    // the items
+    ezc_obj* items;
+    // what each item's run left on its stack, and the status it returned
+    ezc_stk* results;
+    int* status;
+    // the VMs the items run on
+    worker_vms wv;
+} pforeach_t;
+
+// runs the body of a `pforeach!` on a single item
+static void pforeach_task(void* data, int worker, int task) {
+    pforeach_t* pf = (pforeach_t*)data;
+    ezc_vm* wvm = worker_vms_get(&pf->wv, worker);
+
+    // each item starts on an empty stack, and its results are taken afterwards
+    ezc_stk_push(&wvm->stk, pf->items[task]);
+    pf->status[task] = ezc_vm_exec(wvm, pf->prog);
+    pf->results[task] = wvm->stk;
+    wvm->stk = EZC_STK_EMPTY;
+
+    // the worker VM may be freed on another thread, so write its output now
+    ezc_out_sync();
+}
+
+// | A... {code-to-run} pforeach!
+// just like `foreach!`, but runs the code for each item in parallel, on the
+//   shared thread pool. Each item is pushed onto its own empty stack (so the
+//   code can't see the rest of the caller's stack), and afterwards, whatever
+//   was left on each item's stack is pushed back, in the original order
+// Functions defined with `funcdef!` inside the code are only visible to that
+//   worker, and are discarded afterwards
+// Example: | 1 2 3 {:*} pforeach! results in 1 4 9
+EZC_FUNC(pforeach) {
+    REQ_N(pforeach, 1);
+    ezc_obj body = ezc_stk_pop(&vm->stk);
+
+    if (body.type != EZC_TYPE_BLOCK) {
+        ezc_stk_push(&vm->stk, body);
+        ezc_error("Expected the block for `pforeach` to be of type `block` (like {...}), but got `%s`", TYPE_NAME(body)._);
+        return 1;
+    }
+
+    ezc_stk argstack = EZC_STK_EMPTY;
+    pop_to_wall(vm, &argstack);
+    // each item is a task, so ranges are expanded
+    if (expand_ranges(vm, "pforeach", &argstack) != 0) {
+        int i;
+        for (i = 0; i < argstack.n; ++i) OBJ_FREE(argstack.base[i]);
+        ezc_stk_free(&argstack);
+        OBJ_FREE(body);
+        return 1;
+    }
+    int num_to_iter = argstack.n;
+    if (num_to_iter < 1) {
+        ezc_stk_free(&argstack);
+        OBJ_FREE(body);
+        return 0;
+    }
+
+    ezc_pool* pool = ezc_pool_shared();
+
+    pforeach_t pf;
+    pf.prog = EZCP_EMPTY;
+    pf.prog.body = body._block;
+    pf.prog.src = body._block.m_prog->src;
+    pf.prog.src_name = body._block.m_prog->src_name;
+    pf.items = argstack.base;
+    pf.results = ezc_malloc(sizeof(ezc_stk) * num_to_iter);
+    pf.status = ezc_malloc(sizeof(int) * num_to_iter);
+    worker_vms_init(&pf.wv, vm, pool);
+
+    ezc_pool_run(pool, num_to_iter, pforeach_task, &pf);
+
+    // concatenate the results in order, and report the first error
+    int status = 0;
+    int i, j;
+    for (i = 0; i < num_to_iter; ++i) {
+        for (j = 0; j < pf.results[i].n; ++j) {
+            ezc_stk_push(&vm->stk, pf.results[i].base[j]);
+        }
+        ezc_stk_free(&pf.results[i]);
+        if (status == 0) status = pf.status[i];
+    }
+
+    worker_vms_free(&pf.wv);
+    ezc_free(pf.results);
+    ezc_free(pf.status);
+    ezc_stk_free(&argstack);
+    OBJ_FREE(body);
+
+    return status;
+}
+
 // | A B {code} forrange!
 // pops off code to run, a maximum, and a minimum
-// NOTE: Requires 3 arguments
+// A range (see `range!`) can be given instead of A and B: | R {code} forrange!
+// NOTE: Requires 3 arguments (or 2, with a range)
 EZC_FUNC(forrange) {
-    REQ_N(forrange, 3);
+    bool by_range = vm->stk.n >= 2 && ezc_stk_peekn(&vm->stk, 1).type == EZC_TYPE_RANGE;
+    int req_n = by_range ? 2 : 3;
+    REQ_N(forrange, req_n);
 
     // first pop off the body
     ezc_obj body = ezc_stk_pop(&vm->stk);
-    ezc_obj omax = ezc_stk_pop(&vm->stk);
-    ezc_obj omin = ezc_stk_pop(&vm->stk);
+    ezc_obj omax, omin;
+    if (by_range) {
+        ezc_obj orange = ezc_stk_pop(&vm->stk);
+        omin = (ezc_obj){ .type = EZC_TYPE_INT, ._int = orange._range.lo };
+        omax = (ezc_obj){ .type = EZC_TYPE_INT, ._int = orange._range.hi };
+    } else {
+        omax = ezc_stk_pop(&vm->stk);
+        omin = ezc_stk_pop(&vm->stk);
+    }
 
     // TODO: Also allow other things to be executed
+    int status = 0;
     if (body.type != EZC_TYPE_BLOCK) {
         ezc_error("forrange!: body was not type `block` (got `%s`)", TYPE_NAME(body)._);
-        return 1;
-    }
-
-    if (omax.type != EZC_TYPE_INT) {
+        status = 1;
+    } else if (omax.type != EZC_TYPE_INT) {
         ezc_error("forrange!: upper bound was not type `int` (got `%s`)", TYPE_NAME(omax)._);
-        return 1;
-    }
-
-    if (omin.type != EZC_TYPE_INT) {
+        status = 1;
+    } else if (omin.type != EZC_TYPE_INT) {
         ezc_error("forrange!: lower bound was not type `int` (got `%s`)", TYPE_NAME(omin)._);
-        return 1;
+        status = 1;
+    }
+    if (status != 0) {
+        OBJ_FREE(body);
+        OBJ_FREE(omin);
+        OBJ_FREE(omax);
+        return status;
     }
 
-    int imax = omax._int;
-    int imin = omin._int;
+    ezc_int imax = omax._int;
+    ezc_int imin = omin._int;
 
     // current index
     ezc_obj oi = (ezc_obj){ .type = EZC_TYPE_INT };
@@ -1171,10 +1982,7 @@ EZC_FUNC(forrange) {
     _prog.src = body._block.m_prog->src;
     _prog.src_name = body._block.m_prog->src_name;
 
-    // find the status of the evaluation
-    int status = 0;
-
-    int i;
+    ezc_int i;
     for (i = imin; i < imax; ++i) {
         oi._int = i;
         ezc_stk_push(&vm->stk, oi);
@@ -1195,6 +2003,545 @@ EZC_FUNC(forrange) {
 }
 
 
+// the maximum number of chunks `preduce!` splits a range into. This doesn't
+//   depend on the number of threads, so results are the same on any machine
+#define PREDUCE_CHUNKS 256
+
+// the state shared by the tasks of a `preduce!`
+typedef struct {
+    // the body, ran on each index, and the block combining two results
+    ezcp body, combine;
+    // the range, and the number of indices in each chunk
+    ezc_int lo, hi;
+    uint64_t chunk;
+    // the result of each chunk, and the status it returned
+    ezc_obj* partials;
+    int* status;
+    // the VMs the chunks run on
+    worker_vms wv;
+} preduce_t;
+
+// runs `prog` on `vm` (whose stack should have just its arguments), and pops
+//   the single value it leaves into `res`. If it fails, or doesn't leave
+//   exactly one value, the stack is cleared, and nonzero is returned
+static int preduce_run(ezc_vm* vm, ezcp prog, ezc_obj* res) {
+    int status = ezc_vm_exec(vm, prog);
+    if (status == 0 && vm->stk.n != 1) {
+        ezc_error("preduce!: blocks must leave exactly 1 value, but left %d", vm->stk.n);
+        status = 1;
+    }
+    if (status != 0) {
+        while (vm->stk.n > 0) POP_FREE();
+        return status;
+    }
+    *res = ezc_stk_pop(&vm->stk);
+    return 0;
+}
+
+// combines `A` and `B` with the combine block, into `res`
+static int preduce_combine(ezc_vm* vm, preduce_t* pr, ezc_obj A, ezc_obj B, ezc_obj* res) {
+    ezc_stk_push(&vm->stk, A);
+    ezc_stk_push(&vm->stk, B);
+    return preduce_run(vm, pr->combine, res);
+}
+
+// reduces a single chunk, from left to right
+static void preduce_task(void* data, int worker, int task) {
+    preduce_t* pr = (preduce_t*)data;
+    ezc_vm* vm = worker_vms_get(&pr->wv, worker);
+
+    // (unsigned, since the range may be wider than the largest `ezc_int`)
+    ezc_int lo = (ezc_int)((uint64_t)pr->lo + (uint64_t)task * pr->chunk);
+    ezc_int hi = (uint64_t)pr->hi - (uint64_t)lo <= pr->chunk ? pr->hi : (ezc_int)((uint64_t)lo + pr->chunk);
+
+    ezc_obj acc, cur;
+    ezc_int i;
+    int status;
+    ezc_stk_push(&vm->stk, (ezc_obj){ .type = EZC_TYPE_INT, ._int = lo });
+    status = preduce_run(vm, pr->body, &acc);
+    for (i = lo + 1; status == 0 && i < hi; ++i) {
+        ezc_stk_push(&vm->stk, (ezc_obj){ .type = EZC_TYPE_INT, ._int = i });
+        status = preduce_run(vm, pr->body, &cur);
+        if (status != 0) {
+            OBJ_FREE(acc);
+            break;
+        }
+        status = preduce_combine(vm, pr, acc, cur, &acc);
+    }
+
+    pr->status[task] = status;
+    pr->partials[task] = status == 0 ? acc : EZC_OBJ_EMPTY;
+
+    // the worker VM may be freed on another thread, so write its output now
+    ezc_out_sync();
+}
+
+// | A B {body} {combine} preduce!
+// runs `body` on each index `i` in the range [A, B) in parallel, each time on
+//   a stack with only `i`, and reduces the values it leaves with `combine`,
+//   which takes two values and leaves one (and should be associative). The
+//   final value is pushed, or nothing, if the range is empty
+// The range is split into (at most 256) chunks, each reduced left to right,
+//   and then the chunks are combined pairwise, in a fixed tree order, so the
+//   result doesn't depend on how many threads there are (even for reals)
+// The partial results are only ever combined by `combine`, so they overflow
+//   just like it does (i.e. `+` wraps around on ints without GMP)
+// A range (see `range!`) can be given instead of A and B
+// Example: 1 101 {} {+} preduce! results in 5050
+EZC_FUNC(preduce) {
+    bool by_range = vm->stk.n >= 3 && ezc_stk_peekn(&vm->stk, 2).type == EZC_TYPE_RANGE;
+    int req_n = by_range ? 3 : 4;
+    REQ_N(preduce, req_n);
+
+    ezc_obj combine = ezc_stk_pop(&vm->stk);
+    ezc_obj body = ezc_stk_pop(&vm->stk);
+    ezc_obj omax, omin;
+    if (by_range) {
+        ezc_obj orange = ezc_stk_pop(&vm->stk);
+        omin = (ezc_obj){ .type = EZC_TYPE_INT, ._int = orange._range.lo };
+        omax = (ezc_obj){ .type = EZC_TYPE_INT, ._int = orange._range.hi };
+    } else {
+        omax = ezc_stk_pop(&vm->stk);
+        omin = ezc_stk_pop(&vm->stk);
+    }
+
+    int status = 0;
+    if (body.type != EZC_TYPE_BLOCK || combine.type != EZC_TYPE_BLOCK) {
+        ezc_error("preduce!: body and combine must be type `block` (got `%s` and `%s`)", TYPE_NAME(body)._, TYPE_NAME(combine)._);
+        status = 1;
+    } else if (omin.type != EZC_TYPE_INT || omax.type != EZC_TYPE_INT) {
+        ezc_error("preduce!: bounds must be type `int` (got `%s` and `%s`)", TYPE_NAME(omin)._, TYPE_NAME(omax)._);
+        status = 1;
+    }
+    if (status != 0 || omin._int >= omax._int) {
+        OBJ_FREE(combine);
+        OBJ_FREE(body);
+        OBJ_FREE(omax);
+        OBJ_FREE(omin);
+        return status;
+    }
+
+    ezc_pool* pool = ezc_pool_shared();
+
+    preduce_t pr;
+    pr.body = EZCP_EMPTY;
+    pr.body.body = body._block;
+    pr.body.src = body._block.m_prog->src;
+    pr.body.src_name = body._block.m_prog->src_name;
+    pr.combine = EZCP_EMPTY;
+    pr.combine.body = combine._block;
+    pr.combine.src = combine._block.m_prog->src;
+    pr.combine.src_name = combine._block.m_prog->src_name;
+    pr.lo = omin._int;
+    pr.hi = omax._int;
+
+    uint64_t n = (uint64_t)pr.hi - (uint64_t)pr.lo;
+    pr.chunk = n / PREDUCE_CHUNKS + (n % PREDUCE_CHUNKS != 0);
+    int n_chunks = (int)(n / pr.chunk + (n % pr.chunk != 0));
+
+    pr.partials = ezc_malloc(sizeof(ezc_obj) * n_chunks);
+    pr.status = ezc_malloc(sizeof(int) * n_chunks);
+    worker_vms_init(&pr.wv, vm, pool);
+
+    ezc_pool_run(pool, n_chunks, preduce_task, &pr);
+
+    int i, width;
+    for (i = 0; i < n_chunks && status == 0; ++i) {
+        status = pr.status[i];
+    }
+
+    // combine the chunks pairwise: (0 1) (2 3) ..., then ((0 1) (2 3)) ..., on
+    //   a worker VM, so `combine` only sees the two values
+    ezc_vm* cvm = worker_vms_get(&pr.wv, 0);
+    for (width = 1; width < n_chunks && status == 0; width *= 2) {
+        for (i = 0; i + width < n_chunks && status == 0; i += 2 * width) {
+            status = preduce_combine(cvm, &pr, pr.partials[i], pr.partials[i + width], &pr.partials[i]);
+            // both were consumed, even if it failed
+            if (status != 0) pr.partials[i] = EZC_OBJ_EMPTY;
+            pr.partials[i + width] = EZC_OBJ_EMPTY;
+        }
+    }
+
+    if (status == 0) {
+        ezc_stk_push(&vm->stk, pr.partials[0]);
+    } else {
+        for (i = 0; i < n_chunks; ++i) {
+            OBJ_FREE(pr.partials[i]);
+        }
+    }
+
+    worker_vms_free(&pr.wv);
+    ezc_free(pr.partials);
+    ezc_free(pr.status);
+    OBJ_FREE(combine);
+    OBJ_FREE(body);
+    OBJ_FREE(omax);
+    OBJ_FREE(omin);
+
+    return status;
+}
+
+
+/* arrays */
+
+// | A... pack!
+// pops the objects down to the nearest wall (like `foreach!`), which must all
+//   be ints, reals, or ranges, and pushes them as a single packed array (of
+//   reals, if any of them were reals), which `+`, `-`, `*`, `/` and `^` work on
+//   elementwise
+// An array of ints can't hold `zint`s, so arithmetic on it wraps around on
+//   overflow (even with GMP)
+// Example: | 1 2 3 pack! 2* results in [2 4 6]
+EZC_FUNC(pack) {
+    ezc_stk args = EZC_STK_EMPTY;
+    int n = pop_to_wall(vm, &args);
+
+    ezc_obj arr = (ezc_obj){ .type = EZC_TYPE_ARRAY };
+    OBJ_INIT(arr);
+
+    // the number of elements (ranges add each of their integers), which is
+    //   kept from wrapping around, so it can be checked against the most an
+    //   array can hold
+    int i;
+    uint64_t n_elems = 0;
+    for (i = 0; i < n; ++i) {
+        if (args.base[i].type == EZC_TYPE_RANGE) {
+            uint64_t len = RANGE_LEN(args.base[i]._range);
+            n_elems = len > INT_MAX ? (uint64_t)INT_MAX + 1 : n_elems + len;
+        } else if (args.base[i].type == EZC_TYPE_REAL) {
+            arr._array.elem = EZC_TYPE_REAL;
+            n_elems++;
+        } else if (args.base[i].type == EZC_TYPE_INT) {
+            n_elems++;
+        } else {
+            ezc_error("pack!: can only pack `int` and `real`, but got `%s`", TYPE_NAME(args.base[i])._);
+            for (i = 0; i < n; ++i) {
+                OBJ_FREE(args.base[i]);
+            }
+            ezc_stk_free(&args);
+            return 1;
+        }
+        if (n_elems > INT_MAX) {
+            ezc_error("pack!: too many elements for an array (which holds at most %d)", INT_MAX);
+            for (i = 0; i < n; ++i) {
+                OBJ_FREE(args.base[i]);
+            }
+            ezc_stk_free(&args);
+            return 1;
+        }
+    }
+
+    if (n_elems > 0) {
+        arr._array.n = (int)n_elems;
+        arr._array._ptr = ezc_malloc(ARRAY_ELEM_SIZE(arr._array) * n_elems);
+        bool is_real = arr._array.elem == EZC_TYPE_REAL;
+        int k = 0;
+        for (i = 0; i < n; ++i) {
+            ezc_obj cur = args.base[i];
+            if (cur.type == EZC_TYPE_RANGE) {
+                ezc_int j;
+                for (j = cur._range.lo; j < cur._range.hi; ++j, ++k) {
+                    if (is_real) arr._array._real[k] = (ezc_real)j;
+                    else arr._array._int[k] = j;
+                }
+            } else if (is_real) {
+                arr._array._real[k++] = cur.type == EZC_TYPE_INT ? (ezc_real)cur._int : cur._real;
+            } else {
+                arr._array._int[k++] = cur._int;
+            }
+        }
+    }
+
+    ezc_stk_free(&args);
+    ezc_stk_push(&vm->stk, arr);
+    return 0;
+}
+
+// | arr unpack!
+// pops an array, and pushes a wall followed by each of its elements, so that
+//   `unpack! pack!` gives back the same array
+// Example: | 1 2 3 pack! unpack! results in | 1 2 3
+EZC_FUNC(unpack) {
+    REQ_N(unpack, 1);
+    ezc_obj arr = ezc_stk_pop(&vm->stk);
+
+    if (arr.type != EZC_TYPE_ARRAY) {
+        ezc_error("unpack!: expected an `array`, but got `%s`", TYPE_NAME(arr)._);
+        OBJ_FREE(arr);
+        return 1;
+    }
+
+    ezc_stk_push(&vm->stk, (ezc_obj){ .type = EZC_TYPE_WALL });
+    int i;
+    for (i = 0; i < arr._array.n; ++i) {
+        if (arr._array.elem == EZC_TYPE_REAL) {
+            ezc_stk_push(&vm->stk, (ezc_obj){ .type = EZC_TYPE_REAL, ._real = arr._array._real[i] });
+        } else {
+            ezc_stk_push(&vm->stk, (ezc_obj){ .type = EZC_TYPE_INT, ._int = arr._array._int[i] });
+        }
+    }
+
+    OBJ_FREE(arr);
+    return 0;
+}
+
+
+/* reductions */
+
+// the partial results of a segment, collected by `reduce_segment`
+typedef struct {
+    // partials of `int`s and `real`s, kept apart so each can be reduced in one
+    //   vectorized pass
+    int n_int, n_real;
+    ezc_int* ints;
+    ezc_real* reals;
+
+    // the total number of elements (ranges and arrays count each element)
+    int64_t n_elems;
+} reduce_t;
+
+// reduces the integers in `[lo, hi)` without creating them
+static ezc_int reduce_range(int op, ezc_int lo, ezc_int hi) {
+    // unsigned, so overflow wraps instead of being undefined
+    uint64_t n = (uint64_t)hi - (uint64_t)lo, r;
+    if (op == EZC_VEC_ADD) {
+        // n * (lo + hi - 1) / 2, dividing whichever factor is even first
+        uint64_t s = (uint64_t)lo + (uint64_t)hi - 1;
+        if (n % 2 == 0) return (ezc_int)((n / 2) * s);
+        else return (ezc_int)(n * (s / 2));
+    } else if (op == EZC_VEC_MUL) {
+        ezc_int i;
+        r = 1;
+        for (i = lo; i < hi && r != 0; ++i) r *= (uint64_t)i;
+        return (ezc_int)r;
+    } else if (op == EZC_VEC_MIN) {
+        return lo;
+    } else {
+        return hi - 1;
+    }
+}
+
+// pops the segment down to the nearest wall (like `foreach!`), and reduces
+//   each object in it to at most one partial result in `red`. Returns nonzero
+//   (and leaves the stack alone) if anything in it isn't a number
+static int reduce_segment(ezc_vm* vm, int op, const char* fname, reduce_t* red) {
+    // the segment is read in place, instead of being copied off of the stack
+    int n = wall_depth(vm);
+    ezc_obj* args = vm->stk.base + vm->stk.n - n;
+
+    int i;
+    for (i = 0; i < n; ++i) {
+        uint16_t t = args[i].type;
+        if (t != EZC_TYPE_INT && t != EZC_TYPE_REAL && t != EZC_TYPE_RANGE && t != EZC_TYPE_ARRAY) {
+            ezc_error("%s!: expected numbers, but got `%s`", fname, TYPE_NAME(args[i])._);
+            return 1;
+        }
+    }
+
+    *red = (reduce_t){ .n_int = 0, .n_real = 0, .n_elems = 0 };
+    red->ints = ezc_malloc(sizeof(ezc_int) * (n + 1));
+    red->reals = ezc_malloc(sizeof(ezc_real) * (n + 1));
+
+    for (i = 0; i < n; ++i) {
+        ezc_obj cur = args[i];
+        if (cur.type == EZC_TYPE_INT) {
+            red->ints[red->n_int++] = cur._int;
+            red->n_elems++;
+        } else if (cur.type == EZC_TYPE_REAL) {
+            red->reals[red->n_real++] = cur._real;
+            red->n_elems++;
+        } else if (cur.type == EZC_TYPE_RANGE) {
+            if (cur._range.hi > cur._range.lo) {
+                red->ints[red->n_int++] = reduce_range(op, cur._range.lo, cur._range.hi);
+                red->n_elems += cur._range.hi - cur._range.lo;
+            }
+        } else {
+            if (cur._array.n > 0) {
+                if (cur._array.elem == EZC_TYPE_REAL) {
+                    red->reals[red->n_real++] = ezc_vec_reduce_real(op, cur._array.n, cur._array._real);
+                } else {
+                    red->ints[red->n_int++] = ezc_vec_reduce_int(op, cur._array.n, cur._array._int);
+                }
+                red->n_elems += cur._array.n;
+            }
+            // only arrays own memory
+            OBJ_FREE(cur);
+        }
+    }
+
+    // pop the segment, and its wall
+    vm->stk.n -= n;
+    if (vm->stk.n > 0 && ezc_stk_peek(&vm->stk).type == EZC_TYPE_WALL) {
+        ezc_stk_pop(&vm->stk);
+    }
+    return 0;
+}
+
+// reduces the segment with `op`, and pushes the result, which is an `int` if
+//   there were no `real`s in it, or a `real` otherwise. `empty` is pushed for
+//   an empty segment, or it is an error if `empty` is NULL
+static int reduce_op(ezc_vm* vm, int op, const char* fname, const ezc_int* empty) {
+    reduce_t red;
+    if (reduce_segment(vm, op, fname, &red) != 0) return 1;
+
+    ezc_obj res;
+    if (red.n_elems == 0) {
+        ezc_free(red.ints);
+        ezc_free(red.reals);
+        if (empty == NULL) {
+            ezc_error("%s!: there are no values to reduce", fname);
+            return 1;
+        }
+        ezc_stk_push(&vm->stk, (ezc_obj){ .type = EZC_TYPE_INT, ._int = *empty });
+        return 0;
+    }
+
+    ezc_int ri = red.n_int > 0 ? ezc_vec_reduce_int(op, red.n_int, red.ints) : 0;
+    if (red.n_real == 0) {
+        res = (ezc_obj){ .type = EZC_TYPE_INT, ._int = ri };
+    } else {
+        ezc_real rr = ezc_vec_reduce_real(op, red.n_real, red.reals);
+        if (red.n_int > 0) {
+            ezc_real both[2] = { (ezc_real)ri, rr };
+            rr = ezc_vec_reduce_real(op, 2, both);
+        }
+        res = (ezc_obj){ .type = EZC_TYPE_REAL, ._real = rr };
+    }
+
+    ezc_free(red.ints);
+    ezc_free(red.reals);
+    ezc_stk_push(&vm->stk, res);
+    return 0;
+}
+
+// | A... sum!
+// pops the objects down to the nearest wall (like `foreach!`), which must be
+//   ints, reals, arrays, or ranges, and pushes their sum (0 if there are none).
+//   Reals are summed pairwise, so the rounding error grows very slowly
+// The sum of ints wraps around on overflow, like `+` does without GMP (it
+//   isn't promoted to a `zint`, even with GMP, so it stays vectorized)
+// Example: | 1 2 3 sum! results in 6
+EZC_FUNC(sum) {
+    ezc_int empty = 0;
+    return reduce_op(vm, EZC_VEC_ADD, "sum", &empty);
+}
+
+// | A... prod!
+// like `sum!`, but pushes the product (1 if there are none)
+// Example: | 1 2 3 4 prod! results in 24
+EZC_FUNC(prod) {
+    ezc_int empty = 1;
+    return reduce_op(vm, EZC_VEC_MUL, "prod", &empty);
+}
+
+// | A... min!
+// like `sum!`, but pushes the smallest value (there must be at least 1)
+// Example: | 3 1 2 min! results in 1
+EZC_FUNC(min) {
+    return reduce_op(vm, EZC_VEC_MIN, "min", NULL);
+}
+
+// | A... max!
+// like `sum!`, but pushes the largest value (there must be at least 1)
+// Example: | 3 1 2 max! results in 3
+EZC_FUNC(max) {
+    return reduce_op(vm, EZC_VEC_MAX, "max", NULL);
+}
+
+// | A... mean!
+// like `sum!`, but pushes the average, as a real (there must be at least 1)
+// Example: | 1 2 3 4 mean! results in 2.5
+EZC_FUNC(mean) {
+    reduce_t red;
+    if (reduce_segment(vm, EZC_VEC_ADD, "mean", &red) != 0) return 1;
+
+    if (red.n_elems == 0) {
+        ezc_free(red.ints);
+        ezc_free(red.reals);
+        ezc_error("mean!: there are no values to average");
+        return 1;
+    }
+
+    // the partial sums of ints are added as reals, so they can't overflow
+    ezc_real s = 0.0;
+    if (red.n_int > 0) {
+        ezc_real* ir = ezc_malloc(sizeof(ezc_real) * red.n_int);
+        ezc_vec_itor(red.n_int, ir, red.ints);
+        s += ezc_vec_reduce_real(EZC_VEC_ADD, red.n_int, ir);
+        ezc_free(ir);
+    }
+    if (red.n_real > 0) {
+        s += ezc_vec_reduce_real(EZC_VEC_ADD, red.n_real, red.reals);
+    }
+
+    ezc_free(red.ints);
+    ezc_free(red.reals);
+    ezc_stk_push(&vm->stk, (ezc_obj){ .type = EZC_TYPE_REAL, ._real = s / (ezc_real)red.n_elems });
+    return 0;
+}
+
+
+/* arbitrary precision reals */
+
+#ifdef EZC_HAVE_MPFR
+
+// | X zreal!
+// pops a number (or a string of digits), and pushes it as a `zreal`, with the
+//   VM's precision (see `prec!`). Arithmetic with a `zreal` gives a `zreal`,
+//   so only one operand has to be converted
+// Example: 2 zreal! 3/ results in 0.6666...6667 (to 77 digits, by default)
+EZC_FUNC(zreal) {
+    REQ_N(zreal, 1);
+    ezc_obj X = ezc_stk_pop(&vm->stk);
+
+    ezc_obj R = (ezc_obj){ .type = EZC_TYPE_ZREAL };
+    mpfr_init2(R._zreal, ZREAL_PREC(vm));
+
+    if (X.type == EZC_TYPE_STR) {
+        // (the digits are parsed directly, so they aren't rounded to a double)
+        OBJ_UNSHARE(X);
+        ezc_str_own(&X._str);
+        if (X._str._ == NULL || mpfr_set_str(R._zreal, X._str._, 10, MPFR_RNDN) != 0) {
+            ezc_error("zreal!: '%s' is not a number", X._str._ == NULL ? "" : X._str._);
+            mpfr_clear(R._zreal);
+            OBJ_FREE(X);
+            return 1;
+        }
+    } else if (zreal_can_set(X)) {
+        zreal_set(R._zreal, X);
+    } else {
+        ezc_error("zreal!: expected a number or a `str`, but got `%s`", TYPE_NAME(X)._);
+        mpfr_clear(R._zreal);
+        OBJ_FREE(X);
+        return 1;
+    }
+
+    OBJ_FREE(X);
+    ezc_stk_push(&vm->stk, R);
+    return 0;
+}
+
+// | bits prec!
+// sets the precision (in bits) of the `zreal`s created after this on this VM.
+//   The default is 256 bits, about 77 decimal digits
+// Example: 1000 prec! 2 zreal! 0.5 ^ print! prints sqrt(2) to ~300 digits
+EZC_FUNC(prec) {
+    REQ_N(prec, 1);
+    ezc_obj X = ezc_stk_pop(&vm->stk);
+
+    if (X.type != EZC_TYPE_INT || X._int < MPFR_PREC_MIN || X._int > INT_MAX) {
+        ezc_error("prec!: expected an `int` number of bits, at least %d", (int)MPFR_PREC_MIN);
+        OBJ_FREE(X);
+        return 1;
+    }
+
+    vm->zreal_prec = (int)X._int;
+    return 0;
+}
+
+#endif
+
+
 /* FILE IO FUNCTIONS */
 
 // opens a file by name
@@ -1206,7 +2553,9 @@ EZC_FUNC(open) {
 
     if (arg.type == EZC_TYPE_STR) {
 
-        ezc_obj new_fp = (ezc_obj){ .type = EZC_TYPE_FILE };
+        // the name is kept by the file, so it must be our own
+        OBJ_UNSHARE(arg);
+        ezc_str_own(&arg._str);
         char* fname = arg._str._;
         FILE* fp = fopen(fname, "w");
         if (fp == NULL) {
@@ -1214,9 +2563,13 @@ EZC_FUNC(open) {
             OBJ_FREE(arg);
             return -1;
         }
-        new_fp._file.fp = fp;
+        // writes are collected into large blocks, just like `print!`
+        setvbuf(fp, NULL, _IOFBF, EZC_OUT_BUFSIZE);
+        ezc_obj new_fp = (ezc_obj){ .type = EZC_TYPE_FILE };
+        OBJ_INIT(new_fp);
+        new_fp._file->fp = fp;
         // don't free arg, since we use the string as the metadata for the FP
-        new_fp._file.src_name = arg._str;
+        new_fp._file->src_name = arg._str;
         ezc_stk_push(&vm->stk, new_fp);
         return 0;
     } else {
@@ -1242,21 +2595,30 @@ EZC_FUNC(write) {
         return 1;
     }
 
-    if (fp._file.fp == NULL) {
-        ezc_error("FILE for write! is NULL");
+    if (fp._file->fp == NULL || fp._file->reading) {
+        ezc_error("FILE for write! isn't open for writing");
         OBJ_FREE(arg);
         return 1;
     }
 
 
     if (arg.type == EZC_TYPE_STR) {
-        int nbytes = fwrite(arg._str._, 1, arg._str.len, fp._file.fp);
-        fprintf(fp._file.fp, "\n");
-        if (nbytes != arg._str.len) {
-            ezc_warn("Writing %d bytes to '%s' failed, wrote %d", arg._str.len, fp._file.src_name._, nbytes);
+        // the string is freed afterwards, so the newline can go where its NUL
+        //   was, and it's all written at once (once it's our own)
+        OBJ_UNSHARE(arg);
+        ezc_str_own(&arg._str);
+        int status = 0;
+        if (arg._str._ == NULL) {
+            status = ezc_file_write(fp._file, "\n", 1);
+        } else {
+            arg._str._[arg._str.len] = '\n';
+            status = ezc_file_write(fp._file, arg._str._, arg._str.len + 1);
+        }
+        if (status != 0) {
+            ezc_warn("Writing %d bytes to '%s' failed", arg._str.len + 1, fp._file->src_name._);
         }
         OBJ_FREE(arg);
-        return 0;
+        return status != 0 ? 1 : 0;
     } else {
         OBJ_FREE(arg);
         ezc_error("Unsupported type for `open!`: %s", TYPE_NAME(arg)._);
@@ -1264,20 +2626,391 @@ EZC_FUNC(write) {
     }
 }
 
+// strings at least this long are written from where they are, instead of
+//   being copied next to the other pieces (see `writev!`)
+#define WRITEV_COPY_MAX 256
+
+// the pieces for `writev!`, where small ones are copied, one after another,
+//   into `buf` (which are marked by a NULL `data` until they're all added,
+//   since `buf` may move)
+typedef struct {
+    int n, max_n;
+    ezc_iov* iov;
+    char* buf;
+    size_t len, max_len;
+} writev_t;
+
+// returns room for `len` bytes at the end of `buf`
+static char* writev_reserve(writev_t* wv, size_t len) {
+    if (wv->len + len > wv->max_len) {
+        wv->max_len = 2 * wv->max_len + len + 4096;
+        wv->buf = ezc_realloc(wv->buf, wv->max_len);
+    }
+    return wv->buf + wv->len;
+}
+
+// adds a piece, which is either `len` bytes from `data`, or (if `data` is
+//   NULL) the next `len` bytes written to `buf`
+static void writev_add(writev_t* wv, const char* data, size_t len) {
+    if (data == NULL) {
+        wv->len += len;
+        // bytes from `buf` are contiguous, so they stay one piece
+        if (wv->n > 0 && wv->iov[wv->n - 1].data == NULL) {
+            wv->iov[wv->n - 1].len += len;
+            return;
+        }
+    }
+    if (wv->n == wv->max_n) {
+        wv->max_n = 2 * wv->max_n + 16;
+        wv->iov = ezc_realloc(wv->iov, sizeof(ezc_iov) * wv->max_n);
+    }
+    wv->iov[wv->n++] = (ezc_iov){ .data = data, .len = len };
+}
+
+// | fp | A B C... writev!
+// writes the repr of each object down to the last wall (which is consumed)
+//   to fp, each followed by a newline (just like calling `write!` on each),
+//   in as few system calls as possible. Numbers are formatted directly, and
+//   long strings are written from where they are, without copying. fp is
+//   kept on the stack
+// Example: "out.txt" open! | 1 2 3 writev! writes 3 lines
+EZC_FUNC(writev) {
+    // the file is under the wall (so nothing is popped if it isn't there)
+    int at = vm->stk.n - wall_depth(vm) - 2;
+    if (at < 0 || vm->stk.base[at].type != EZC_TYPE_FILE) {
+        ezc_error("Object under the wall is not a FILE type (in writev!)");
+        return 1;
+    }
+    ezc_obj fp = vm->stk.base[at];
+    if (fp._file->fp == NULL || fp._file->reading) {
+        ezc_error("FILE for writev! isn't open for writing");
+        return 1;
+    }
+
+    ezc_stk args = EZC_STK_EMPTY;
+    pop_to_wall(vm, &args);
+
+    writev_t wv = { .n = 0, .max_n = 0, .iov = NULL, .buf = NULL, .len = 0, .max_len = 0 };
+    ezc_str tmp = EZC_STR_NULL;
+    int i, len;
+    for (i = 0; i < args.n; ++i) {
+        ezc_obj A = args.base[i];
+        if (A.type == EZC_TYPE_INT) {
+            len = ezc_fmt_int(writev_reserve(&wv, EZC_FMT_INT_MAX), A._int);
+        } else if (A.type == EZC_TYPE_REAL) {
+            len = ezc_fmt_real(writev_reserve(&wv, EZC_FMT_REAL_MAX), A._real);
+        } else if (A.type == EZC_TYPE_STR && A._str.len >= WRITEV_COPY_MAX) {
+            writev_add(&wv, A._str._, A._str.len);
+            len = 0;
+        } else {
+            ezc_str S = A._str;
+            if (A.type != EZC_TYPE_STR) {
+                OBJ_REPR(A, tmp);
+                S = tmp;
+            }
+            ezc_memcpy(writev_reserve(&wv, S.len), S._, S.len);
+            len = S.len;
+        }
+        // (the piece may have ended right at the end of `buf`)
+        writev_reserve(&wv, len + 1)[len] = '\n';
+        writev_add(&wv, NULL, len + 1);
+    }
+
+    // now that `buf` won't move, point the pieces into it
+    size_t off = 0;
+    for (i = 0; i < wv.n; ++i) {
+        if (wv.iov[i].data == NULL) {
+            wv.iov[i].data = wv.buf + off;
+            off += wv.iov[i].len;
+        }
+    }
+
+    int status = 0;
+    if (ezc_file_writev(fp._file, wv.iov, wv.n) != 0) {
+        ezc_warn("Writing %d objects to '%s' failed", args.n, fp._file->src_name._);
+        status = 1;
+    }
+
+    for (i = 0; i < args.n; ++i) {
+        OBJ_FREE(args.base[i]);
+    }
+    ezc_stk_free(&args);
+    ezc_str_free(&tmp);
+    ezc_free(wv.iov);
+    ezc_free(wv.buf);
+    return status;
+}
+
+// the number of words `writeb!` converts at once, when they need swapping
+#define WRITEB_CHUNK 1024
+
+// writes `n` 8 byte words (ints or reals) from `data`, reversing the bytes of
+//   each if `swap`. Returns whether they were all written
+static bool writeb_words(ezc_file* fp, const void* data, size_t n, bool swap) {
+    if (!swap) return ezc_file_write(fp, data, 8 * n) == 0;
+
+    uint64_t chunk[WRITEB_CHUNK];
+    const char* src = data;
+    while (n > 0) {
+        size_t i, k = n < WRITEB_CHUNK ? n : WRITEB_CHUNK;
+        memcpy(chunk, src, 8 * k);
+        for (i = 0; i < k; ++i) chunk[i] = __builtin_bswap64(chunk[i]);
+        if (ezc_file_write(fp, chunk, 8 * k) != 0) return false;
+        src += 8 * k;
+        n -= k;
+    }
+    return true;
+}
+
+// | fp X writeb!, or fp X "le" writeb!
+// writes `X` (an int, real, packed array, or range) to fp in binary, as 8
+//   byte integers (two's complement) or doubles, in the CPU's byte order, or
+//   in little endian ("le") or big endian ("be") order. Arrays in the right
+//   order are written as they are, in one call, so writing a million numbers
+//   costs about the same as copying them. fp is kept on the stack
+// Example: "out.bin" open! | 1 1000001 range! pack! "le" writeb!
+EZC_FUNC(writeb) {
+    bool swap = false;
+    ezc_obj order = EZC_OBJ_EMPTY;
+    if (vm->stk.n >= 3 && ezc_stk_peek(&vm->stk).type == EZC_TYPE_STR) {
+        order = ezc_stk_pop(&vm->stk);
+        bool little = __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+        if (ezc_str_eq(order._str, EZC_STR_CONST("le"))) {
+            swap = !little;
+        } else if (ezc_str_eq(order._str, EZC_STR_CONST("be"))) {
+            swap = little;
+        } else if (!ezc_str_eq(order._str, EZC_STR_CONST("native"))) {
+            ezc_error("writeb!: byte order must be \"le\", \"be\", or \"native\", but got '%.*s'", order._str.len, order._str._);
+            OBJ_FREE(order);
+            return 1;
+        }
+        OBJ_FREE(order);
+    }
+    REQ_N(writeb, 2);
+
+    ezc_obj X = ezc_stk_pop(&vm->stk);
+    ezc_obj fp = ezc_stk_peek(&vm->stk);
+    if (fp.type != EZC_TYPE_FILE || fp._file->fp == NULL || fp._file->reading) {
+        ezc_error("writeb!: expected a FILE open for writing under the value, but got `%s`", TYPE_NAME(fp)._);
+        OBJ_FREE(X);
+        return 1;
+    }
+
+    bool ok;
+    if (X.type == EZC_TYPE_INT) {
+        ok = writeb_words(fp._file, &X._int, 1, swap);
+    } else if (X.type == EZC_TYPE_REAL) {
+        ok = writeb_words(fp._file, &X._real, 1, swap);
+    } else if (X.type == EZC_TYPE_ARRAY) {
+        ok = writeb_words(fp._file, X._array._ptr, X._array.n, swap);
+    } else if (X.type == EZC_TYPE_RANGE) {
+        // generated a chunk at a time
+        ezc_int chunk[WRITEB_CHUNK];
+        ezc_int i = X._range.lo;
+        ok = true;
+        while (ok && i < X._range.hi) {
+            size_t k = 0;
+            while (k < WRITEB_CHUNK && i < X._range.hi) chunk[k++] = i++;
+            ok = writeb_words(fp._file, chunk, k, swap);
+        }
+    } else {
+        ezc_error("writeb!: can't write `%s` in binary (expected int, real, array, or range)", TYPE_NAME(X)._);
+        OBJ_FREE(X);
+        return 1;
+    }
+
+    if (!ok) {
+        ezc_warn("Writing to '%s' failed", fp._file->src_name._);
+    }
+    OBJ_FREE(X);
+    return ok ? 0 : 1;
+}
+
+// | fp async!
+// makes writes to fp (see `open!`) happen in the background, on a thread of
+//   its own, so `write!`, `writev!` and `writeb!` only queue the data, and
+//   never wait for the disk. `flush!` waits for everything queued so far to
+//   be written, and so does closing the file. If a write fails, the error is
+//   reported by the next write or flush. fp is kept on the stack
+// Example: "log.txt" open! async! "started" write!
+EZC_FUNC(async) {
+    REQ_N(async, 1);
+    ezc_obj fp = ezc_stk_peek(&vm->stk);
+    if (fp.type != EZC_TYPE_FILE || fp._file->fp == NULL || fp._file->reading) {
+        ezc_error("async!: expected a FILE open for writing, but got `%s`", TYPE_NAME(fp)._);
+        return 1;
+    }
+    if (ezc_file_async(fp._file) != 0) {
+        ezc_error("async!: couldn't start writing '%s' in the background", fp._file->src_name._);
+        return 1;
+    }
+    return 0;
+}
+
+// | fname openr!
+// opens a file for reading (see `lines!` and `records!`). Regular files are
+//   memory mapped, so the strings read from them are borrowed from the
+//   mapping instead of copied, and anything else (i.e. a pipe) is read as it
+//   goes
+EZC_FUNC(openr) {
+    REQ_N(openr, 1);
+
+    ezc_obj arg = ezc_stk_pop(&vm->stk);
+
+    if (arg.type != EZC_TYPE_STR) {
+        ezc_error("Unsupported type for `openr!`: %s", TYPE_NAME(arg)._);
+        OBJ_FREE(arg);
+        return 2;
+    }
+
+    ezc_obj new_fp = (ezc_obj){ .type = EZC_TYPE_FILE };
+    OBJ_INIT(new_fp);
+    // the name is kept by the file, so it must be our own
+    OBJ_UNSHARE(arg);
+    ezc_str_own(&arg._str);
+    if (ezc_file_openr(new_fp._file, arg._str._) != 0) {
+        ezc_error("Couldn't open file '%s'", arg._str._);
+        OBJ_FREE(new_fp);
+        OBJ_FREE(arg);
+        return -1;
+    }
+    // the name is kept as the metadata for the file
+    new_fp._file->src_name = arg._str;
+    ezc_stk_push(&vm->stk, new_fp);
+    return 0;
+}
+
+// runs `body` on each record of `fp` (which is consumed), split by `sep`,
+//   optionally removing a `\r` at the end of each (for lines)
+static int run_records(ezc_vm* vm, ezc_obj fp, ezc_str sep, bool strip_cr, ezc_obj body, const char* fname) {
+    int status = 0;
+    if (fp.type != EZC_TYPE_FILE || !fp._file->reading) {
+        ezc_error("%s: expected a FILE opened with `openr!`, but got `%s`", fname, TYPE_NAME(fp)._);
+        status = 1;
+    } else if (body.type != EZC_TYPE_BLOCK) {
+        ezc_error("%s: expected a block (like {...}), but got `%s`", fname, TYPE_NAME(body)._);
+        status = 1;
+    } else if (sep.len < 1) {
+        ezc_error("%s: the separator can't be empty", fname);
+        status = 1;
+    }
+
+    if (status == 0) {
+        ezcp _prog = EZCP_EMPTY;
+        _prog.body = body._block;
+        _prog.src = body._block.m_prog->src;
+        _prog.src_name = body._block.m_prog->src_name;
+
+        // each record is pushed on, and the code is ran, just like `foreach!`
+        ezc_obj rec = (ezc_obj){ .type = EZC_TYPE_STR };
+        while (status == 0 && (status = ezc_file_next(fp._file, sep, &rec._str)) > 0) {
+            if (strip_cr && rec._str.len > 0 && rec._str._[rec._str.len - 1] == '\r') {
+                if (rec._str.max_len >= 0) rec._str._[rec._str.len - 1] = '\0';
+                rec._str.len--;
+            }
+            ezc_stk_push(&vm->stk, rec);
+            status = ezc_vm_exec(vm, _prog);
+        }
+        if (status < 0) status = 1;
+    }
+
+    OBJ_FREE(fp);
+    OBJ_FREE(body);
+    return status;
+}
+
+// | fp {code-to-run} lines!
+// runs the code on each line of `fp` (without its newline), which is pushed
+//   on, just like `foreach!`. The file is read as it goes, so it never needs
+//   to fit on the stack, and it's closed at the end
+// Example: "data.txt" openr! {print!} lines! prints every line of data.txt
+EZC_FUNC(lines) {
+    REQ_N(lines, 2);
+    ezc_obj body = ezc_stk_pop(&vm->stk);
+    ezc_obj fp = ezc_stk_pop(&vm->stk);
+    return run_records(vm, fp, EZC_STR_CONST("\n"), true, body, "lines!");
+}
+
+// | fp sep {code-to-run} records!
+// just like `lines!`, but the records are split by the string `sep` instead
+// Example: "data.csv" openr! "," {print!} records! prints every field
+EZC_FUNC(records) {
+    REQ_N(records, 3);
+    ezc_obj body = ezc_stk_pop(&vm->stk);
+    ezc_obj sep = ezc_stk_pop(&vm->stk);
+    ezc_obj fp = ezc_stk_pop(&vm->stk);
+    if (sep.type != EZC_TYPE_STR) {
+        ezc_error("records!: expected the separator to be a `str`, but got `%s`", TYPE_NAME(sep)._);
+        OBJ_FREE(sep);
+        OBJ_FREE(fp);
+        OBJ_FREE(body);
+        return 1;
+    }
+    int status = run_records(vm, fp, sep._str, false, body, "records!");
+    OBJ_FREE(sep);
+    return status;
+}
+
 
 // generators
 
+// | A B range!
+// pops two integers, and pushes the range of integers in [A, B), without
+//   creating each integer. Loops (`foreach!`, `forrange!`, `preduce!`) and
+//   `pack!` go through it one integer at a time, and `X!` expands it onto the
+//   stack
+// Example: 0 1000000000 range! {...} foreach! runs in constant memory
+EZC_FUNC(range) {
+    REQ_N(range, 2);
+    ezc_obj B = ezc_stk_pop(&vm->stk);
+    ezc_obj A = ezc_stk_pop(&vm->stk);
+
+    if (A.type != EZC_TYPE_INT || B.type != EZC_TYPE_INT) {
+        ezc_error("range!: bounds must be type `int` (got `%s` and `%s`)", TYPE_NAME(A)._, TYPE_NAME(B)._);
+        OBJ_FREE(A); OBJ_FREE(B);
+        return 1;
+    }
+
+    ezc_obj res = (ezc_obj){ .type = EZC_TYPE_RANGE };
+    res._range.lo = A._int;
+    res._range.hi = B._int < A._int ? A._int : B._int;
+    ezc_stk_push(&vm->stk, res);
+    return 0;
+}
+
 // X == 'expand'
+// | N X! pushes 0, 1, ..., N-1, and | R X! pushes every integer in the range R
 EZC_FUNC(X) {
     REQ_N(X, 1);
     ezc_obj arg = ezc_stk_pop(&vm->stk);
 
-    if (arg.type == EZC_TYPE_INT) {
-        // do 0...arg-1
+    if (arg.type == EZC_TYPE_RANGE) {
+        // do lo...hi-1
+        if (!stk_fits(vm, "X", RANGE_LEN(arg._range))) {
+            ezc_stk_push(&vm->stk, arg);
+            return 1;
+        }
+        int start_idx = vm->stk.n;
+        ezc_stk_resize(&vm->stk, vm->stk.n + (int)RANGE_LEN(arg._range));
+
+        ezc_obj new_int = EZC_OBJ_EMPTY;
+        new_int.type = EZC_TYPE_INT;
+        int i;
+        for (i = start_idx; i < vm->stk.n; ++i) {
+            new_int._int = arg._range.lo + (i - start_idx);
+            vm->stk.base[i] = new_int;
+        }
+        return 0;
+    } else if (arg.type == EZC_TYPE_INT) {
+        // do 0...arg-1 (nothing, if it's negative)
+        if (!stk_fits(vm, "X", arg._int < 0 ? 0 : (uint64_t)arg._int)) {
+            ezc_stk_push(&vm->stk, arg);
+            return 1;
+        }
         ezc_int i;
         int start_idx = vm->stk.n;
         //printf("%lu\n", arg._int);
-        ezc_stk_resize(&vm->stk, vm->stk.n + arg._int);
+        ezc_stk_resize(&vm->stk, vm->stk.n + (arg._int < 0 ? 0 : (int)arg._int));
 
         ezc_obj new_int = EZC_OBJ_EMPTY;
         new_int.type = EZC_TYPE_INT;
@@ -1308,9 +3041,13 @@ int EZC_FUNC_NAME(register_module)(ezc_vm* vm) {
     EZC_REGISTER_TYPE(int)
     EZC_REGISTER_TYPE(bool)
     EZC_REGISTER_TYPE(real)
-    EZC_REGISTER_TYPE(str)
+    EZC_REGISTER_TYPE_SHARED(str)
     EZC_REGISTER_TYPE(block)
-    EZC_REGISTER_TYPE(file)
+    EZC_REGISTER_TYPE_SHARED(file)
+    EZC_REGISTER_TYPE_SHARED(array)
+    EZC_REGISTER_TYPE(range)
+    EZC_REGISTER_TYPE_SHARED(zint)
+    EZC_REGISTER_TYPE_SHARED(zreal)
 
     // functions that just pop on a value
     EZC_REGISTER_FUNC(none)
@@ -1333,6 +3070,7 @@ int EZC_FUNC_NAME(register_module)(ezc_vm* vm) {
     EZC_REGISTER_FUNC(dump)
 
     EZC_REGISTER_FUNC(printall)
+    EZC_REGISTER_FUNC(flush)
 
     // registration functions
     EZC_REGISTER_FUNC(funcdef)
@@ -1351,14 +3089,40 @@ int EZC_FUNC_NAME(register_module)(ezc_vm* vm) {
     // control functions
     EZC_REGISTER_FUNC(ifel)
     EZC_REGISTER_FUNC(foreach)
+    EZC_REGISTER_FUNC(pforeach)
     EZC_REGISTER_FUNC(forrange)
+    EZC_REGISTER_FUNC(preduce)
+
+
+    // arrays
+    EZC_REGISTER_FUNC(pack)
+    EZC_REGISTER_FUNC(unpack)
+
+    // reductions
+    EZC_REGISTER_FUNC(sum)
+    EZC_REGISTER_FUNC(prod)
+    EZC_REGISTER_FUNC(min)
+    EZC_REGISTER_FUNC(max)
+    EZC_REGISTER_FUNC(mean)
 
+    // arbitrary precision
+#ifdef EZC_HAVE_MPFR
+    EZC_REGISTER_FUNC(zreal)
+    EZC_REGISTER_FUNC(prec)
+#endif
 
     // IO functions
     EZC_REGISTER_FUNC(open)
     EZC_REGISTER_FUNC(write)
+    EZC_REGISTER_FUNC(writev)
+    EZC_REGISTER_FUNC(writeb)
+    EZC_REGISTER_FUNC(async)
+    EZC_REGISTER_FUNC(openr)
+    EZC_REGISTER_FUNC(lines)
+    EZC_REGISTER_FUNC(records)
 
     // misc. utility functions
+    EZC_REGISTER_FUNC(range)
     EZC_REGISTER_FUNC(X)
 
 }
@@ -18,18 +18,27 @@
 #include <string.h>
 #include <stdio.h>
 #include <stddef.h>
+#include <limits.h>
 
+// for the tracer's lock, since one tracer may be shared by VMs on many threads
+#include <pthread.h>
 
 #ifdef EZC_HAVE_GMP
 #include <gmp.h>
 #endif
 
+#ifdef EZC_HAVE_MPFR
+#include <mpfr.h>
+#endif
+
 /* forward declarations */
 
 typedef struct ezci ezci;
 typedef struct ezcp ezcp;
 typedef struct ezc_obj ezc_obj;
 typedef struct ezc_vm ezc_vm;
+// the state of a file written in the background (see ezc/file.c)
+typedef struct ezc_aio ezc_aio;
 
 /* constants */
 
@@ -39,7 +48,7 @@ typedef struct ezc_vm ezc_vm;
 
 // The stadnard `ezc` integer. I prefer to have larger integers by default,
 // And having signed makes everything easier. For way larger values, use zint
-//   anyway. (TODO: Use GMP)
+//   (which arithmetic promotes to automatically when built with GMP)
 typedef int64_t ezc_int;
 // number of bits in an `ezc_int`
 #define EZC_INT_BITS   (sizeof(ezc_int) * 8)
@@ -51,8 +60,8 @@ typedef int64_t ezc_int;
 #define EZC_INT_MIN    ((ezc_int)INT64_MIN)
 
 // The standard `ezc` real number (i.e. floating point). I prefer to have 64bit
-//   by default, as this is just much easier. For large values, use the zreal
-// type, (TODO: Use MPFR for this)
+//   by default, as this is just much easier. For more precision, use the zreal
+// type (when built with MPFR)
 typedef double  ezc_real;
 // number of bits in an `ezc_real`
 #define EZC_REAL_BITS  (sizeof(ezc_real) * 8)
@@ -63,6 +72,10 @@ typedef double  ezc_real;
 // minimum value that can be stored in an `ezc_int`
 #define EZC_REAL_MIN   ((ezc_real)DBL_MIN)
 
+// the default precision (in bits) of a `zreal`, for VMs that haven't set one
+//   with `prec!`
+#define EZC_ZREAL_PREC 256
+
 // The standard `ezc` boolean, i.e. true or false
 typedef bool    ezc_bool;
 // the value `true` as an `ezc_bool`
@@ -93,6 +106,17 @@ typedef struct {
 #define EZC_STR_VIEW(_charp, _len) ((ezc_str){ ._ = (char*)(_charp), .len = (int)(_len), .max_len = (int)(_len) })
 // Returns a view for a constant string literal (this shouldn't be modified)
 #define EZC_STR_CONST(_charp) EZC_STR_VIEW(_charp, strlen(_charp))
+// constructs a string borrowed from memory which outlives it (i.e. a file
+//   mapped by `openr!`), which can be used like any other string on the
+//   stack. It is never freed, and isn't NUL terminated, so it's copied (see
+//   `ezc_str_own`) before being changed or passed to C functions
+#define EZC_STR_BORROW(_charp, _len) ((ezc_str){ ._ = (char*)(_charp), .len = (int)(_len), .max_len = -1 })
+// same, but borrowed from the file mapping with index `_map` (see
+//   `ezc_file_map_incref`), which the string holds a reference to, and lets go
+//   of when it's freed (the index is kept in `max_len`, as `-2 - _map`)
+#define EZC_STR_MAPPED(_charp, _len, _map) ((ezc_str){ ._ = (char*)(_charp), .len = (int)(_len), .max_len = -2 - (_map) })
+// returns the index of the file mapping a string is borrowed from, or -1
+#define EZC_STR_MAP(_str) ((_str).max_len < -1 ? -2 - (_str).max_len : -1)
 
 // an unsigned integer representing a hash of some object
 typedef uint32_t ezc_hash_t; 
@@ -105,13 +129,85 @@ typedef struct {
     // a human-readable source for the file
     ezc_str src_name;
 
-    // file pointer
+    // file pointer (NULL for files which are memory mapped)
     FILE* fp;
 
+    // whether the file was opened for reading (see `openr!`)
+    bool reading;
+
+    // whether `buf` is the whole file, memory mapped (so records are borrowed
+    //   from it), instead of what has been read so far
+    bool mapped;
+
+    // the index of the mapping, which the file holds a reference to (see
+    //   `ezc_file_map_incref`), or -1
+    int map;
+
+    // whether everything has been read into `buf`
+    bool eof;
+
+    // the data of a file opened for reading, with `len` bytes valid, and
+    //   the next record starting at `pos`
+    char* buf;
+    size_t len, pos, max_len;
+
+    // for files written in the background (see `async!`), the queue and the
+    //   thread writing to `fp`, or NULL
+    ezc_aio* aio;
 
 } ezc_file;
 
-#define EZC_FILE_EMPTY ((ezc_file){ .src_name = EZC_STR_NULL, .fp = NULL })
+// a piece of data to be written, along with others, in one call (see
+//   `ezc_file_writev`)
+typedef struct {
+
+    const char* data;
+    size_t len;
+
+} ezc_iov;
+
+#define EZC_FILE_EMPTY ((ezc_file){ .src_name = EZC_STR_NULL, .fp = NULL, .reading = false, .mapped = false, .map = -1, .eof = false, .buf = NULL, .len = 0, .pos = 0, .max_len = 0, .aio = NULL })
+
+// a packed array of numbers, which are either all integers or all reals, so
+//   arithmetic on them can use vectorized loops (see ezc/vec.c)
+typedef struct {
+
+    // the type of the elements, either EZC_TYPE_INT or EZC_TYPE_REAL
+    uint16_t elem;
+
+    // number of elements
+    int n;
+
+    // the elements (which one is valid depends on `elem`)
+    union {
+        ezc_int* _int;
+        ezc_real* _real;
+        void* _ptr;
+    };
+
+} ezc_array;
+
+// a lazy range of the integers in `[lo, hi)`, which loops can iterate over
+//   without pushing every integer onto the stack
+typedef struct {
+
+    // the first integer, and one past the last
+    ezc_int lo, hi;
+
+} ezc_range;
+
+// the operations supported by the vectorized kernels (see ezc/vec.c)
+enum {
+    EZC_VEC_ADD = 0,
+    EZC_VEC_SUB,
+    EZC_VEC_MUL,
+    EZC_VEC_DIV,
+    EZC_VEC_POW,
+    EZC_VEC_MIN,
+    EZC_VEC_MAX,
+
+    EZC_VEC_N
+};
 
 
 
@@ -124,9 +220,17 @@ typedef struct {
     int (*f_repr)(ezc_obj*, ezc_str*);
     int (*f_copy)(ezc_obj*, ezc_obj*);
 
+    // if true, copies of an object (i.e. `:`) share its resources, which are
+    //   counted (see `ezc_obj_copy`) and only freed along with the last one.
+    //   `f_copy` is then only called to give an object its own resources,
+    //   right before it is changed (see `ezc_obj_unshare`)
+    bool shared;
+
 } ezct;
 // construct a type from C functions
-#define EZCT(_init, _free, _repr, _copy) ((ezct){ .f_init = _init, .f_free = _free, .f_repr = _repr, .f_copy = _copy })
+#define EZCT(_init, _free, _repr, _copy) ((ezct){ .f_init = _init, .f_free = _free, .f_repr = _repr, .f_copy = _copy, .shared = false })
+// construct a type whose copies share their resources (see `ezct.shared`)
+#define EZCT_SHARED(_init, _free, _repr, _copy) ((ezct){ .f_init = _init, .f_free = _free, .f_repr = _repr, .f_copy = _copy, .shared = true })
 
 
 enum {
@@ -233,16 +337,64 @@ struct ezcp {
     ezc_str src_name;
 
     // string containing the entire source of the program, which is allocated
-    // specifically for `ezcp`
+    // specifically for `ezcp` (unless `src_borrowed`)
     ezc_str src;
+
+    // if true, `src` is owned by someone else (i.e. a memory mapped file), see
+    //   `ezcp_init_borrow`
+    bool src_borrowed;
     
     // the body instruction of the program. Normally, this is an instruction
     // of type `block`
     ezci body;
 
+    // the number of references to the program (blocks of it on a stack,
+    //   functions defined from it, ...), if it was created with `ezcp_new`.
+    //   It is freed once this reaches 0. For any other program, this is 0, and
+    //   nothing is counted (the owner frees it, see `ezcp_free`)
+    int refs;
+
 };
 // the empty program
-#define EZCP_EMPTY ((ezcp){ .src_name = EZC_STR_EMPTY, .src = EZC_STR_EMPTY, .body = EZCI_EMPTY })
+#define EZCP_EMPTY ((ezcp){ .src_name = EZC_STR_EMPTY, .src = EZC_STR_EMPTY, .src_borrowed = false, .body = EZCI_EMPTY, .refs = 0 })
+
+// the state of an incremental compile, for programs which are read in chunks
+//   (i.e. from a pipe, or a file too big to hold in memory). See the
+//   `ezcp_stream_*` functions
+typedef struct {
+
+    // the program being compiled. Its `src` is never filled in
+    ezcp* prog;
+
+    // the hierarchy of blocks currently open (see `ezcp_init`)
+    ezci** blocks;
+    int block_idx;
+
+    // current position in the source
+    int line, col;
+
+    // the end of the input that hasn't been compiled yet, since it is the
+    //   start of a token which may continue in the next chunk
+    ezc_str tail;
+
+    // how much of `tail` is known not to finish its token, so only what
+    //   comes after it is searched when more input is fed
+    int scanned;
+
+    // if true, the source outlives the program (i.e. it is the program's
+    //   `src`), so strings without escape codes can be views into it
+    bool views;
+
+    // if true, each top level block is compiled into a program of its own
+    //   (see `ezcp_new`), which the block holds a reference to, so once it's
+    //   dropped (see `ezcp_stream_drop`) it is freed as soon as nothing else
+    //   refers to it, instead of living as long as the whole stream
+    bool own_blocks;
+
+    // nonzero if there was an error compiling
+    int err;
+
+} ezcp_stream;
 
 
 /* generic types */
@@ -265,6 +417,18 @@ enum {
     EZC_TYPE_BLOCK,
     // a file pointer (i.e. FILE*) with some metadata
     EZC_TYPE_FILE,
+    // a packed array of ints or reals (see ezc_array for info)
+    EZC_TYPE_ARRAY,
+    // a lazy range of integers (see ezc_range for info)
+    EZC_TYPE_RANGE,
+    // an arbitrary precision integer, which `int` arithmetic is promoted to
+    //   when it would overflow. It is only ever created when built with GMP
+    //   (see EZC_HAVE_GMP), but always has its slot, so type indices don't
+    //   depend on the build
+    EZC_TYPE_ZINT,
+    // an arbitrary precision real, with a precision chosen per VM (only ever
+    //   created when built with MPFR, see EZC_HAVE_MPFR)
+    EZC_TYPE_ZREAL,
 
     // this is the first index of the non-primitive types, which 
     //   can be tested against to see if the object is builtin or 
@@ -288,7 +452,25 @@ struct ezc_obj {
         // the instruction value of the object (only valid if type==EZCI_TYPE_BLOCK)
         ezci _block;
 
-        ezc_file _file;
+        // the file of the object (only valid if type==EZC_TYPE_FILE), which is
+        //   allocated, so every copy of it sees the same state
+        ezc_file* _file;
+
+        // the array value of the object (only valid if type==EZC_TYPE_ARRAY)
+        ezc_array _array;
+
+        // the range value of the object (only valid if type==EZC_TYPE_RANGE)
+        ezc_range _range;
+
+#ifdef EZC_HAVE_GMP
+        // the big integer value of the object (only valid if type==EZC_TYPE_ZINT)
+        mpz_t _zint;
+#endif
+
+#ifdef EZC_HAVE_MPFR
+        // the big real value of the object (only valid if type==EZC_TYPE_ZREAL)
+        mpfr_t _zreal;
+#endif
 
         // generic pointer, used for custom types
         void* _ptr;
@@ -299,6 +481,11 @@ struct ezc_obj {
     // this is testable, by querying `obj.type >= EZC_TYPE_CUSTOM`
     uint16_t type;
 
+    // for types which are shared (see `ezct.shared`), the number of objects
+    //   sharing these resources, or NULL if this is the only one (it's only
+    //   allocated once the object is first copied)
+    int* _rc;
+
 };
 // the empty object
 #define EZC_OBJ_EMPTY ((ezc_obj){ .type = EZC_TYPE_NONE })
@@ -317,6 +504,9 @@ typedef struct {
     int max_n;
 
 } ezc_stk;
+// the most objects a stack can hold (so that `n`, and the room it grows into,
+//   still fit in an `int`)
+#define EZC_STK_MAX ((INT_MAX - 10) / 3 * 2)
 // the empty stack
 #define EZC_STK_EMPTY ((ezc_stk){ .base = NULL, .n = 0, .max_n = 0 })
 
@@ -351,6 +541,240 @@ typedef struct {
 // constructs an ezc_func from an EZC instruction to Returns
 #define EZC_FUNC_EZC(_ezcfunc) ((ezc_func){ .type = EZC_FUNC_TYPE_EZC, ._ezc = _ezcfunc })
 
+// a function which has been looked up by name once (see `ezc_vm_getfunc`),
+//   and can then be called directly, any number of times (see `ezc_vm_call`)
+typedef struct {
+
+    // the name it was looked up by (which hooks are called with)
+    ezc_str name;
+
+    // the function itself
+    ezc_func func;
+
+} ezc_funcref;
+
+
+// a single entry in the profiler's table, describing how many samples were
+//   attributed to a given instruction (keyed by program, line, and column)
+typedef struct {
+
+    // the program the instruction was compiled under (NULL means unused slot)
+    ezcp* prog;
+
+    // the position of the instruction in the source of `prog`
+    uint16_t line, col, len;
+
+    // number of samples attributed to the instruction
+    int count;
+
+} ezc_prof_ent;
+
+enum {
+    // the profiler is not running
+    EZC_PROF_OFF = 0,
+    // take a sample every `period` instructions executed
+    EZC_PROF_INSTS,
+    // take a sample every time the profiling timer (SIGPROF) fires
+    EZC_PROF_TIMER
+};
+
+// a set of callbacks invoked by the VM around calls to user (i.e. EZC defined)
+//   functions, which can be used by profilers, tracers, etc
+typedef struct {
+
+    // called right before the function `name` starts executing
+    void (*f_enter)(ezc_vm* vm, ezc_str name, void* data);
+    // called right after the function `name` has returned
+    void (*f_leave)(ezc_vm* vm, ezc_str name, void* data);
+
+    // user data, passed to the callbacks
+    void* data;
+
+} ezc_hook;
+// construct a hook from C functions and user data
+#define EZC_HOOK(_enter, _leave, _data) ((ezc_hook){ .f_enter = _enter, .f_leave = _leave, .data = _data })
+
+enum {
+    // CPU cycles
+    EZC_PERF_CYCLES = 0,
+    // instructions retired
+    EZC_PERF_INSTS,
+    // mispredicted branches
+    EZC_PERF_BRANCH_MISSES,
+    // L1 data cache read misses
+    EZC_PERF_L1D_MISSES,
+    // last level cache misses
+    EZC_PERF_LLC_MISSES,
+
+    // number of counters
+    EZC_PERF_N
+};
+
+// hardware performance counter values, indexed by EZC_PERF_*
+typedef struct {
+    uint64_t _[EZC_PERF_N];
+} ezc_perf_vals;
+
+// structure representing a set of hardware performance counters (via Linux's
+//   `perf_event_open`), which can be attached to a VM to count per function
+typedef struct {
+
+    // file descriptor of each counter, or -1 if it couldn't be opened
+    int fds[EZC_PERF_N];
+    // number of counters that could be opened
+    int n_open;
+
+    // values when `ezc_perf_open` was called
+    ezc_perf_vals start;
+
+    // per function counts (only used once attached to a VM)
+    struct {
+        // number of functions seen
+        int n;
+        // names of the functions
+        ezc_str* keys;
+        // number of calls to each function
+        int* calls;
+        // counts for each function, excluding the functions it called
+        ezc_perf_vals* self;
+    } funcs;
+
+    // the stack of active calls
+    struct {
+        // depth of the stack, and allocated size
+        int n, max_n;
+        // the values when the call started
+        ezc_perf_vals* start;
+        // the values accumulated by functions called from this one
+        ezc_perf_vals* child;
+    } frames;
+
+} ezc_perf;
+
+// a single buffered event of a tracer, which is written out in the Chrome
+//   trace event format (viewable in chrome://tracing or Perfetto)
+typedef struct {
+
+    // the phase of the event: 'B' (begin), 'E' (end), or 'C' (counter)
+    char ph;
+
+    // index into the tracer's table of names
+    int name;
+
+    // timestamp, in microseconds since the tracer was initialized
+    double ts;
+
+    // the value (only for counter events)
+    int64_t val;
+
+    // index of the thread which recorded the event (starting at 1)
+    int tid;
+
+} ezc_tracer_ev;
+
+// structure representing a tracer, which records events in memory, so that
+//   tracing doesn't distort timings, and then writes them all at once
+typedef struct {
+
+    // the recorded events
+    struct {
+        // number of events, and allocated size
+        int n, max_n;
+        // array of events
+        ezc_tracer_ev* vals;
+    } evs;
+
+    // the names of the events, which are interned, so each event is small
+    struct {
+        // number of names
+        int n;
+        // the names
+        ezc_str* keys;
+    } names;
+
+    // the threads which have recorded events, so each gets a small `tid`
+    struct {
+        // number of threads
+        int n;
+        // the thread handles, where `vals[i]` has tid `i+1`
+        pthread_t* vals;
+    } tids;
+
+    // the time when the tracer was initialized (in seconds, see ezc_time())
+    double t0;
+
+    // held while recording or writing events, so VMs on different threads
+    //   can share a tracer
+    pthread_mutex_t lock;
+
+} ezc_tracer;
+
+// a task ran by a pool, where `task` is the index of the task, and `worker`
+//   is the index of the worker running it (so per-worker state can be kept)
+typedef void (*ezc_pool_fn)(void* data, int worker, int task);
+
+// the tasks a worker of a pool has left to run, `[lo, hi)`. The worker takes
+//   tasks from the front, and idle workers steal half from the back
+typedef struct {
+
+    // held while taking or stealing tasks
+    pthread_mutex_t lock;
+
+    // the range of tasks left
+    int lo, hi;
+
+} ezc_pool_deque;
+
+// a pool of worker threads, which runs a batch of tasks at a time, stealing
+//   work between workers so uneven tasks stay balanced (see ezc/pool.c)
+typedef struct {
+
+    // number of workers, including the thread calling `ezc_pool_run` (which
+    //   is worker 0)
+    int n_workers;
+
+    // the threads for workers 1 through n_workers-1
+    pthread_t* threads;
+
+    // the tasks left for each worker
+    ezc_pool_deque* deques;
+
+    // the batch being ran
+    ezc_pool_fn fn;
+    void* data;
+
+    // incremented for every batch, so sleeping workers know to wake up
+    unsigned gen;
+
+    // number of worker threads still running the current batch
+    int n_running;
+
+    // whether the pool is running a batch (if so, a nested `ezc_pool_run`
+    //   just runs its tasks on the calling thread)
+    int busy;
+
+    // whether the workers should exit
+    bool quit;
+
+    // guards `gen`, `n_running` and `quit`
+    pthread_mutex_t lock;
+    // signalled when a batch starts, and when the last worker finishes one
+    pthread_cond_t start, done;
+
+} ezc_pool;
+
+// how the output of a VM (`print!` and friends) is written out
+enum {
+    // buffered, unless stdout is a terminal (decided on the first print)
+    EZC_OUT_AUTO = 0,
+    // always buffered, until the buffer fills up, or `flush!` is called
+    EZC_OUT_BUFFERED,
+    // written out after every print
+    EZC_OUT_UNBUFFERED
+};
+
+// the size the output buffer of a VM is flushed at
+#define EZC_OUT_BUFSIZE (64 * 1024)
 
 // structure representing the entire state of the VM at once
 struct ezc_vm {
@@ -378,6 +802,52 @@ struct ezc_vm {
         ezc_func* vals;
     } funcs; 
 
+    // the C functions ran for the builtin instructions (i.e. `add` for `+`),
+    //   indexed by the EZCI_* enum, which are looked up the first time each is
+    //   used, or NULL
+    ezc_cfunc builtins[EZCI_N];
+
+    // structure representing the state of the sampling profiler (see ezc/prof.c)
+    struct {
+        // one of the EZC_PROF_* enums
+        int mode;
+        // for EZC_PROF_INSTS, sample every `period` instructions
+        int period;
+        // instructions left until the next sample
+        int left;
+        // total number of samples taken
+        int n_samples;
+        // number of used entries, and capacity of the hash table `ents`
+        int n, max_n;
+        // open-addressed hash table of instruction samples
+        ezc_prof_ent* ents;
+    } prof;
+
+    // structure representing the hooks called around user functions
+    struct {
+        // number of hooks
+        int n;
+        // the hooks, in the order they were added
+        ezc_hook* vals;
+    } hooks;
+
+    // the precision (in bits) of new `zreal`s, or 0 for EZC_ZREAL_PREC (see
+    //   `prec!`)
+    int zreal_prec;
+
+    // structure representing the buffered output (see ezc/out.c)
+    struct {
+        // one of the EZC_OUT_* enums
+        int mode;
+        // whether `eager` has been decided yet (on the first print)
+        bool init;
+        // whether each print is written out right away
+        bool eager;
+        // length, and capacity, of the bytes waiting in `buf`
+        int len, max_len;
+        char* buf;
+    } out;
+
 };
 // the empty VM
 #define EZC_VM_EMPTY ((ezc_vm){ .stk = EZC_STK_EMPTY, .types = { .n = 0, .keys = NULL, .vals = NULL }, .funcs = { .n = 0, .keys = NULL, .vals = NULL } })
@@ -9,8 +9,10 @@
 #include <time.h>
 #include <sys/time.h>
 
-// counts ezc_init()'s - ezc_finalize()'s
+// counts ezc_init()'s - ezc_finalize()'s (updated atomically)
 static int g_init_ct = 0;
+// the time of the first ezc_init(), which is only written then, so it can be
+//   read from any thread afterwards
 static struct timeval g_stime = (struct timeval){ .tv_sec = 0, .tv_usec = 0 };
 
 // sizes of 1024 bytes
@@ -26,19 +28,29 @@ static const char* g_sizestr[] = {
 
 int ezc_init() {
     ezc_debug("ezc_init() called");
-    gettimeofday(&g_stime, NULL);
+    if (__atomic_fetch_add(&g_init_ct, 1, __ATOMIC_ACQ_REL) == 0) {
+        gettimeofday(&g_stime, NULL);
+    }
     atexit(ezc_finalize);
-    g_init_ct++;
     return EZC_SUCCESS;
 }
 
 void ezc_finalize() {
-    if (g_init_ct <= 0) {
-        //ezc_error("ezc_finalize() called before ezc_init()");
-        return;
-    }
+    int ct = __atomic_load_n(&g_init_ct, __ATOMIC_ACQUIRE);
+    do {
+        if (ct <= 0) {
+            //ezc_error("ezc_finalize() called before ezc_init()");
+            return;
+        }
+    } while (!__atomic_compare_exchange_n(&g_init_ct, &ct, ct - 1, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
     ezc_debug("ezc_finalize() called");
-    g_init_ct--;
+
+    // nothing can still be borrowing from mapped files, and files written in
+    //   the background should be finished
+    if (ct == 1) {
+        ezc_file_flush_all();
+        ezc_file_unmap_all();
+    }
 }
 
 double ezc_time() {
@@ -11,39 +11,104 @@
 
 #include "ezc-impl.h"
 
-// the characters representings digits in different bases
-static const char digitstr[] = EZC_DIGIT_STR;
-
-// returns the digit index from a given char
-// i.e. '1' returns 1, 'a' returns 10, etc
-static int dig_from_chr(char c) {
+// character classes, which decide how the lexer handles a token starting with
+//   a given character (anything not listed is invalid)
+enum {
+    CC_NONE = 0,
+    // ' ', '\t', '\n', which are skipped
+    CC_WHITE,
+    // a single character operator, looked up in `op_tbl`
+    CC_OP,
+    // a two character operator, looked up in `op2_tbl`
+    CC_OP2,
+    // a digit or '.', which starts a numeric constant
+    CC_NUM,
+    // a letter, which starts an identifier
+    CC_IDENT,
+    // '"', which starts a string literal
+    CC_STR,
+    // '{', '}'
+    CC_LBRACE,
+    CC_RBRACE,
+    // '#', which starts a comment until the end of the line
+    CC_COMMENT
+};
+
+// helpers for filling runs of a table with designated initializers
+#define R2(_c, _v) [(_c)] = (_v), [(_c)+1] = (_v)
+#define R4(_c, _v) R2(_c, _v), R2((_c)+2, _v)
+#define R8(_c, _v) R4(_c, _v), R4((_c)+4, _v)
+#define R16(_c, _v) R8(_c, _v), R8((_c)+8, _v)
+
+// the class of each character
+static const unsigned char cc_tbl[256] = {
+    [' '] = CC_WHITE, ['\t'] = CC_WHITE, ['\n'] = CC_WHITE,
+    ['!'] = CC_OP, ['`'] = CC_OP, [':'] = CC_OP, ['_'] = CC_OP, ['$'] = CC_OP,
+    ['+'] = CC_OP, ['-'] = CC_OP, ['*'] = CC_OP, ['/'] = CC_OP, ['%'] = CC_OP,
+    ['^'] = CC_OP, ['|'] = CC_OP,
+    ['='] = CC_OP2, ['<'] = CC_OP2,
+    R8('0', CC_NUM), R2('8', CC_NUM), ['.'] = CC_NUM,
+    R16('a', CC_IDENT), R8('q', CC_IDENT), R2('y', CC_IDENT),
+    R16('A', CC_IDENT), R8('Q', CC_IDENT), R2('Y', CC_IDENT),
+    ['"'] = CC_STR,
+    ['{'] = CC_LBRACE, ['}'] = CC_RBRACE,
+    ['#'] = CC_COMMENT,
+};
+
+// the instruction for each single character operator
+static const unsigned char op_tbl[256] = {
+    ['!'] = EZCI_EXEC, ['`'] = EZCI_DEL, [':'] = EZCI_COPY, ['_'] = EZCI_UNDER,
+    ['$'] = EZCI_GET, ['+'] = EZCI_ADD, ['-'] = EZCI_SUB, ['*'] = EZCI_MUL,
+    ['/'] = EZCI_DIV, ['%'] = EZCI_MOD, ['^'] = EZCI_POW, ['|'] = EZCI_WALL,
+};
+
+// the second character, and instruction, for each two character operator
+static const struct { char c2; unsigned char type; } op2_tbl[256] = {
+    ['='] = { '=', EZCI_EQ },
+    ['<'] = { '>', EZCI_SWAP },
+};
+
+// 1 + the digit value of each character, or 0 if it isn't a digit, built
+//   from `EZC_DIGIT_STR` (i.e. by default, '1' is 1, 'a' is 10, etc) the first
+//   time anything is compiled
+static unsigned char dig_tbl[256];
+static pthread_once_t dig_once = PTHREAD_ONCE_INIT;
+
+static void dig_tbl_init() {
+    static const char digits[] = EZC_DIGIT_STR;
     int i;
-    for (i = 0; i < sizeof(digitstr) - 1; ++i) {
-        if (digitstr[i] == c) return i;
+    for (i = 0; digits[i] != '\0'; ++i) {
+        dig_tbl[(unsigned char)digits[i]] = i + 1;
     }
-    return -1;
 }
 
+#undef R2
+#undef R4
+#undef R8
+#undef R16
+
+// returns the class of a character
+#define CC(_c) (cc_tbl[(unsigned char)(_c)])
 // macro to test if a character is a digit
-#define IS_DIGIT_BASE(_c, _base) (dig_from_chr(_c) >= 0 && dig_from_chr(_c) < (_base))
-// macro to test if a character is whitespace (and can be ignored)
-#define IS_WHITE(_c) ((_c) == ' ' || (_c) == '\t' || (_c) == '\n')
-// returns true if the character starts an identifier
-#define IS_IDENT_START(_c) (((_c) >= 'a' && (_c) <= 'z') || ((_c) >= 'A' && (_c) <= 'Z'))
+#define IS_DIGIT_BASE(_c, _base) ((unsigned)(dig_tbl[(unsigned char)(_c)] - 1) < (unsigned)(_base))
+// returns the digit index from a given char (which must be a digit)
+#define DIG_VAL(_c) (dig_tbl[(unsigned char)(_c)] - 1)
 // returns true if the character could come at some point in the middle of an identifier
-#define IS_IDENT_MIDDLE(_c) (IS_IDENT_START(_c) || (_c) == '_')
-
-// initializes a program from a source name and a source string
-void ezcp_init(ezcp* ret, ezc_str src_name, ezc_str src) {
-    // make copies of the strings
-    ezc_str_copy(&ret->src_name, src_name);
-    ezc_str_copy(&ret->src, src);
-
-    // start the program off with a blanked body
-    ret->body = EZCI_EMPTY;
-    ret->body.type = EZCI_BLOCK;
-    ret->body._block.children = NULL;
-    ret->body._block.n = 0;
+#define IS_IDENT_MIDDLE(_c) (CC(_c) == CC_IDENT || (_c) == '_')
+
+// returns true if the string instruction `_inst` has its own memory, rather
+//   than being a view into the source of `_prog`
+#define INST_OWNS_STR(_prog, _inst) (!((_inst)._str._ >= (_prog)->src._ && (_inst)._str._ <= (_prog)->src._ + (_prog)->src.len && (_prog)->src._ != NULL))
+
+// compiles `str[0:stop-str]` into the stream's program, continuing from where
+//   the last call left off. If `final` is false, more input may follow, so a
+//   token which runs into `stop` (and so might continue in the next chunk) is
+//   left uncompiled. Returns where compiling stopped (`stop`, or the start of
+//   such a token), or NULL if there was an error
+static char* ezcp_lex(ezcp_stream* st, char* str, char* stop, bool final) {
+    // the program instructions are compiled under, which is the open top level
+    //   block's own program, if it has one (see `own_blocks`)
+    ezcp* ret = st->own_blocks && st->block_idx > 0 ? st->blocks[1]->m_prog : st->prog;
 
     // list of pointers to the hierarchical block parsing structure.
     // This is for nested blocks, like in this example:
@@ -58,19 +123,15 @@ void ezcp_init(ezcp* ret, ezc_str src_name, ezc_str src) {
     // at the point of parsing `test4`, the blocks should have:
     // [ret->body {test2} {test3} {...}]
     // since it is 3 deep past the global block
-    ezci** blocks = ezc_malloc(sizeof(ezci*));
-    int block_idx = 0;
-    blocks[0] = &ret->body;
+    ezci** blocks = st->blocks;
+    int block_idx = st->block_idx;
 
     // current line/column
-    int line = 0, col = 0;
+    int line = st->line, col = st->col;
     // where the current token started
     int start_line, start_col;
     char* tokstart;
 
-    // current parse position, and where to stop parsing
-    char* str = ret->src._, *stop = ret->src._ + ret->src.len;
-
     // advances the scanner a single character ,updaing the line and
     //   column variables if newlines are encountered
     #define SCAN_ADVANCE() { if (*str == '\n') { col = 0; line++; } else { col++; } str++; }
@@ -84,14 +145,24 @@ void ezcp_init(ezcp* ret, ezc_str src_name, ezc_str src) {
     // This adds a given instruction to the current block, using the `blocks`
     //   variable, thus adding it to the inner-most scope, i.e. within
     //   all the {}'s correctly
+    // NOTE: children arrays grow geometrically; their capacity is implicitly
+    //   the next power of two (and at least 4) above `n`, so no extra field
+    //   is needed to track it
     #define ADD_INST(_inst) { \
-        blocks[block_idx]->_block.children = ezc_realloc(blocks[block_idx]->_block.children, sizeof(ezci) * (++(blocks[block_idx]->_block.n))); \
-        blocks[block_idx]->_block.children[blocks[block_idx]->_block.n-1] = _inst;  \
+        ezci* _blk = blocks[block_idx]; \
+        int _n = _blk->_block.n; \
+        if (_n == 0 || (_n >= 4 && (_n & (_n - 1)) == 0)) { \
+            _blk->_block.children = ezc_realloc(_blk->_block.children, sizeof(ezci) * (_n == 0 ? 4 : 2 * _n)); \
+        } \
+        _blk->_block.children[_blk->_block.n++] = _inst; \
     }
 
-    // an `else if` block describing a string literal mapping to a builtin VM
-    //   instruction
-    #define BUILTIN_CASE(_str, _type) else if (strncmp(_str, str, strlen(_str)) == 0) { int _i; for (_i = 0; _i < strlen(_str); ++_i) { SCAN_ADVANCE(); }; ADD_INST(GEN_INST(_type)); }
+    // saves the state back to the stream, and returns `_res`
+    #define LEX_RETURN(_res) { st->blocks = blocks; st->block_idx = block_idx; st->line = line; st->col = col; return (_res); }
+
+    // if more input may come, stops before the current token (since it's
+    //   not finished yet)
+    #define LEX_INCOMPLETE() if (!final) { line = start_line; col = start_col; LEX_RETURN(tokstart); }
 
     while (str < stop) {
         // set the variables describing the start of the current token
@@ -99,16 +170,64 @@ void ezcp_init(ezcp* ret, ezc_str src_name, ezc_str src) {
         start_line = line;
         start_col = col;
 
-        // get the character we're staring at
+        // get the character we're staring at, and dispatch on its class
         char c = *str;
-        if (IS_WHITE(c)) {
+        switch (CC(c)) {
+        case CC_WHITE:
+            // always skip whitespace, all at once
+            do {
+                if (*str == '\n') {
+                    col = 0;
+                    line++;
+                } else {
+                    col++;
+                }
+                str++;
+            } while (str < stop && CC(*str) == CC_WHITE);
+            break;
+
+        case CC_COMMENT: {
+            // ignore until the end of the line, because its a comment
+            char* nl = memchr(str, '\n', stop - str);
+            if (nl == NULL) {
+                LEX_INCOMPLETE();
+                str = stop;
+            } else {
+                // skip the newline too
+                str = nl + 1;
+                col = 0;
+                line++;
+            }
+            break;
+        }
+
+        case CC_OP:
             SCAN_ADVANCE();
-            // always skip whitespace
-            while (IS_WHITE(*str)) {
-                SCAN_ADVANCE();
+            ADD_INST(GEN_INST(op_tbl[(unsigned char)c]));
+            break;
+
+        case CC_OP2:
+            if (str + 1 >= stop) LEX_INCOMPLETE();
+            if (str + 1 < stop && str[1] == op2_tbl[(unsigned char)c].c2) {
+                str += 2;
+                col += 2;
+                ADD_INST(GEN_INST(op2_tbl[(unsigned char)c].type));
+            } else {
+                ezc_error("Invalid Character: '%c'", c);
+                ezc_printmeta(GEN_INST(EZCI_NONE));
+                LEX_RETURN(NULL);
             }
-        } else if (c == '{') {
+            break;
+
+        case CC_LBRACE: {
             SCAN_ADVANCE();
+            if (st->own_blocks && block_idx == 0) {
+                // a top level block gets a program of its own, so it can be
+                //   freed without the rest of the stream
+                ret = ezcp_new();
+                ezc_str_copy(&ret->src_name, st->prog->src_name);
+            }
+
             // add on a new block onto the list of blocks,
             // to handle multiple levels of scope within blocks
             ezci new_block = GEN_INST(EZCI_BLOCK);
@@ -128,45 +247,30 @@ void ezcp_init(ezcp* ret, ezc_str src_name, ezc_str src) {
             //   to the list of precedent blocks
             blocks = ezc_realloc(blocks, sizeof(struct ezci_block*) * (block_idx+1));
             blocks[block_idx] = &(blocks[inserted_idx]->_block.children[blocks[inserted_idx]->_block.n-1]);
+            break;
+        }
 
-        } else if (c == '}') {
+        case CC_RBRACE:
             SCAN_ADVANCE();
-            // if they are unbalanced, print an error
-            if (block_idx < 0) {
+            // if they are unbalanced (i.e. closing the global block), print an error
+            if (block_idx <= 0) {
                 ezc_error("Extra '}'");
                 ezc_printmeta(GEN_INST(EZCI_NONE));
-                exit(1);
+                LEX_RETURN(NULL);
             }
             
             // just pop off the current block scope
             block_idx--;
 
-        } else if (c == '#') {
-            SCAN_ADVANCE();
-            while (*str != '\0' && *str != '\n') {
-                SCAN_ADVANCE();
+            if (st->own_blocks && block_idx == 0) {
+                // the top level block is done, so its program owns it now
+                ret->body = *blocks[1];
+                ret = st->prog;
             }
-            SCAN_ADVANCE();
-            // ignore, because its a comment
-        }
-        // builtins and operators/stuff
-        BUILTIN_CASE("==", EZCI_EQ)
-        BUILTIN_CASE("<>", EZCI_SWAP)
-        BUILTIN_CASE("!", EZCI_EXEC)
-        BUILTIN_CASE("`", EZCI_DEL)
-        BUILTIN_CASE(":", EZCI_COPY)
-        BUILTIN_CASE("_", EZCI_UNDER)
-        BUILTIN_CASE("$", EZCI_GET)
-        BUILTIN_CASE("+", EZCI_ADD)
-        BUILTIN_CASE("-", EZCI_SUB)
-        BUILTIN_CASE("*", EZCI_MUL)
-        BUILTIN_CASE("/", EZCI_DIV)
-        BUILTIN_CASE("%", EZCI_MOD)
-        BUILTIN_CASE("^", EZCI_POW)
-        BUILTIN_CASE("|", EZCI_WALL)
-        else if (c == '.' || IS_DIGIT_BASE(c, 10)) {
+            break;
+
+        case CC_NUM: {
             // if its a digit, it means it starts a numeric constant
-            char* start = str;
             // whether or not its had a `.` in the constant
             //   (determines whether its an int or real)
             bool had_dot = false;
@@ -181,7 +285,7 @@ void ezcp_init(ezcp* ret, ezc_str src_name, ezc_str src) {
             // base^-i th power, for parsing the fractional
             //   part of real numbers
             ezc_real b2ni = 1.0;
-            while (IS_DIGIT_BASE(*str, base) || (!had_dot && *str == '.')) {
+            while (str < stop && (IS_DIGIT_BASE(*str, base) || (!had_dot && *str == '.'))) {
                 // if its a dot, it means its a real constant,
                 //   rather than an integer
                 if (*str == '.') {
@@ -189,14 +293,16 @@ void ezcp_init(ezcp* ret, ezc_str src_name, ezc_str src) {
                     // start computing real value
                     rval = (ezc_real)ival;
                 } else if (had_dot) {
-                    rval = rval + (b2ni /= base) * (*str - '0');
+                    rval = rval + (b2ni /= base) * DIG_VAL(*str);
                 } else {
-                    ival = ival * base + (*str - '0');
+                    ival = ival * base + DIG_VAL(*str);
                 }
 
-                // advance to the next character
-                SCAN_ADVANCE();
+                // advance to the next character (never a newline)
+                str++;
+                col++;
             }
+            if (str >= stop) LEX_INCOMPLETE();
 
             if (had_dot) {
                 // add a literal real instruction
@@ -209,17 +315,42 @@ void ezcp_init(ezcp* ret, ezc_str src_name, ezc_str src) {
                 new_int._int = ival;
                 ADD_INST(new_int);
             }
+            break;
+        }
 
-        } else if (c == '"') {
+        case CC_STR: {
             SCAN_ADVANCE();
 
+            // find the end of the literal, and whether it has any escape
+            //   codes. If not, it can just be copied all at once
+            char* end = str;
+            while (end < stop && *end != '"' && *end != '\\') end++;
+            if (end >= stop) LEX_INCOMPLETE();
+
+            if (st->views && end < stop && *end == '"') {
+                // no escapes, so just refer to the source
+                ezc_str view = EZC_STR_VIEW(str, end - str);
+                while (str <= end) {
+                    SCAN_ADVANCE();
+                }
+                ezci new_str = GEN_INST(EZCI_STR);
+                new_str._str = view;
+                ADD_INST(new_str);
+                break;
+            }
+
             // start with parsed
             ezc_str parsed = EZC_STR_NULL;
+            ezc_str_copy_cp(&parsed, str, (int)(end - str));
+            while (str < end) {
+                SCAN_ADVANCE();
+            }
 
-            while (*str != '\0' && *str != '"') {
+            while (str < stop && *str != '"') {
                 if (*str == '\\') {
                     // escape character
                     SCAN_ADVANCE();
+                    if (str >= stop) break;
                     // now, do escape code:
                     if (*str == 'n') {
                         ezc_str_append_c(&parsed, '\n');
@@ -230,7 +361,8 @@ void ezcp_init(ezcp* ret, ezc_str src_name, ezc_str src) {
                     } else {
                         ezc_error("Invalid escape code: '\\%c'", *str);
                         ezc_printmeta(GEN_INST(EZCI_NONE));
-                        return;
+                        ezc_str_free(&parsed);
+                        LEX_RETURN(NULL);
                     }
 
                 } else {
@@ -241,54 +373,267 @@ void ezcp_init(ezcp* ret, ezc_str src_name, ezc_str src) {
             }
 
             // ensure it was terminated
-            if (*str == '"') {
+            if (str < stop && *str == '"') {
                 SCAN_ADVANCE();
             } else {
+                if (!final) ezc_str_free(&parsed);
+                LEX_INCOMPLETE();
                 ezc_error("Expected Ending '\"'");
                 ezc_printmeta(GEN_INST(EZCI_NONE));
-                return;
+                ezc_str_free(&parsed);
+                LEX_RETURN(NULL);
             }
 
             // add the string
             ezci new_str = GEN_INST(EZCI_STR);
             new_str._str = parsed;
             ADD_INST(new_str);
+            break;
+        }
 
-        } else if (IS_IDENT_START(c)) {
-            // parse an identifier
+        case CC_IDENT: {
+            // parse an identifier (which never contains a newline)
             char* start = str;
-            int len = 0;
-            while (*str != '\0' && IS_IDENT_MIDDLE(*str)) {
-                len++;
-                SCAN_ADVANCE();
-            }
+            do {
+                str++;
+            } while (str < stop && IS_IDENT_MIDDLE(*str));
+            int len = (int)(str - start);
+            col += len;
+            if (str >= stop) LEX_INCOMPLETE();
+
             // parse from the entire source (which should have no \\ codes,
-            //   so should be linear copying)
+            //   so should be linear copying, or just a view)
             ezc_str parsed = EZC_STR_NULL;
-            ezc_str_copy_cp(&parsed, start, len);
+            if (st->views) {
+                parsed = EZC_STR_VIEW(start, len);
+            } else {
+                ezc_str_copy_cp(&parsed, start, len);
+            }
 
             // add it as an instruction
             ezci new_str = GEN_INST(EZCI_STR);
             new_str._str = parsed;
             ADD_INST(new_str);
-        } else {
+            break;
+        }
+
+        default:
             // something wrong happened
             ezc_error("Invalid Character: '%c'", c);
             ezc_printmeta(GEN_INST(EZCI_NONE));
-            return;
+            LEX_RETURN(NULL);
         }
     }
 
-    // free our hierarchy of blocks (but not the blocks themselves)
-    ezc_free(blocks);
+    LEX_RETURN(str);
+
+    #undef SCAN_ADVANCE
+    #undef GEN_INST
+    #undef ADD_INST
+    #undef LEX_RETURN
+    #undef LEX_INCOMPLETE
+}
+
+void ezcp_stream_init(ezcp_stream* st, ezcp* prog, ezc_str src_name) {
+    // (threads may compile at the same time, but the table is built only once)
+    pthread_once(&dig_once, dig_tbl_init);
+
+    ezc_str_copy(&prog->src_name, src_name);
+
+    // start the program off with a blanked body
+    prog->body = EZCI_EMPTY;
+    prog->body.type = EZCI_BLOCK;
+    prog->body._block.children = NULL;
+    prog->body._block.n = 0;
+
+    st->prog = prog;
+    st->blocks = ezc_malloc(sizeof(ezci*));
+    st->blocks[0] = &prog->body;
+    st->block_idx = 0;
+    st->line = st->col = 0;
+    st->tail = EZC_STR_NULL;
+    st->scanned = 0;
+    st->views = false;
+    st->own_blocks = true;
+    st->err = 0;
+}
+
+// returns the index of the first character of `str[0:n]` which may finish an
+//   unfinished token starting with `first`, or `n` if none can
+static int lex_find_end(char first, const char* str, int n) {
+    const char* end = NULL;
+    int i = 0;
+    switch (CC(first)) {
+    case CC_COMMENT:
+        end = memchr(str, '\n', n);
+        return end == NULL ? n : (int)(end - str);
+    case CC_STR:
+        end = memchr(str, '"', n);
+        return end == NULL ? n : (int)(end - str);
+    case CC_NUM:
+        while (i < n && IS_DIGIT_BASE(str[i], 10)) i++;
+        return i;
+    case CC_IDENT:
+        while (i < n && IS_IDENT_MIDDLE(str[i])) i++;
+        return i;
+    default:
+        return 0;
+    }
+}
+
+int ezcp_stream_feed(ezcp_stream* st, const char* data, int len) {
+    if (st->err != 0) return st->err;
+
+    if (st->tail.len == 0) {
+        // compile straight from `data`, and only keep what's unfinished
+        char* end = ezcp_lex(st, (char*)data, (char*)data + len, false);
+        if (end == NULL) return st->err = 1;
+        ezc_str_copy_cp(&st->tail, end, (int)(data + len - end));
+    } else {
+        // the start of a token is left over, so continue it from this chunk.
+        //   It's only lexed again once something that may finish it comes in,
+        //   so a token spanning lots of chunks isn't lexed over and over
+        ezc_str_append(&st->tail, EZC_STR_VIEW(data, len));
+        st->scanned += lex_find_end(st->tail._[0], st->tail._ + st->scanned, st->tail.len - st->scanned);
+        if (st->scanned >= st->tail.len) return 0;
+
+        char* end = ezcp_lex(st, st->tail._, st->tail._ + st->tail.len, false);
+        if (end == NULL) return st->err = 1;
+        st->tail.len -= (int)(end - st->tail._);
+        memmove(st->tail._, end, st->tail.len);
+        st->tail._[st->tail.len] = '\0';
+    }
+
+    // the lexer went through all of what's left without finishing it
+    st->scanned = st->tail.len;
+    return 0;
+}
+
+int ezcp_stream_ready(ezcp_stream* st) {
+    // everything at the top level is done, except an open block
+    return st->prog->body._block.n - (st->block_idx > 0 ? 1 : 0);
+}
+
+void ezcp_stream_drop(ezcp_stream* st, int n) {
+    ezci* body = &st->prog->body;
+    int i;
+    for (i = 0; i < n; ++i) {
+        // strings were copied when they were pushed, and blocks may still be
+        //   on a stack, or defined as a function, so they are only released
+        ezci* inst = &body->_block.children[i];
+        if (inst->type == EZCI_STR && INST_OWNS_STR(st->prog, *inst)) {
+            ezc_str_free(&inst->_str);
+        } else if (inst->type == EZCI_BLOCK && inst->m_prog != st->prog) {
+            ezcp_decref(inst->m_prog);
+        }
+    }
+    body->_block.n -= n;
+    memmove(body->_block.children, body->_block.children + n, sizeof(ezci) * body->_block.n);
+
+    // the open block (if any) has moved
+    if (st->block_idx > 0) st->blocks[1] = &body->_block.children[body->_block.n - 1];
+}
+
+int ezcp_stream_finish(ezcp_stream* st) {
+    if (st->err == 0 && st->tail.len > 0) {
+        if (ezcp_lex(st, st->tail._, st->tail._ + st->tail.len, true) == NULL) st->err = 1;
+    }
 
     // make sure the blocks were balanced
-    if (block_idx != 0) {
+    if (st->err == 0 && st->block_idx != 0) {
         ezc_error("Unbalanced {}'s");
-        ezc_printmeta(GEN_INST(EZCI_NONE));
-        return;
+        ezc_printmeta((ezci){ .type = EZCI_NONE, .m_line = st->line, .m_col = st->col, .m_len = 0, .m_prog = st->prog });
+        st->err = 1;
+    }
+
+    // a top level block left open is freed along with the program
+    if (st->own_blocks && st->block_idx > 0) st->blocks[1]->m_prog->body = *st->blocks[1];
+
+    // free our hierarchy of blocks (but not the blocks themselves)
+    ezc_free(st->blocks);
+    st->blocks = NULL;
+    ezc_str_free(&st->tail);
+    return st->err;
+}
+
+// compiles all of `ret->src` at once, returning nonzero if there was an error
+static int ezcp_init_src(ezcp* ret, ezc_str src_name) {
+    ezcp_stream st;
+    ezcp_stream_init(&st, ret, src_name);
+
+    // the source lives as long as the program, so strings can refer to it
+    //   (and so can blocks, since the whole program is freed at once)
+    st.views = true;
+    st.own_blocks = false;
+
+    if (ezcp_lex(&st, ret->src._, ret->src._ + ret->src.len, true) == NULL) st.err = 1;
+    return ezcp_stream_finish(&st);
+}
+
+// initializes a program from a source name and a source string
+int ezcp_init(ezcp* ret, ezc_str src_name, ezc_str src) {
+    // keep a copy of the source (for error messages, and profiling)
+    ezc_str_copy(&ret->src, src);
+    ret->src_borrowed = false;
+    return ezcp_init_src(ret, src_name);
+}
+
+int ezcp_init_borrow(ezcp* ret, ezc_str src_name, ezc_str src) {
+    ret->src = src;
+    ret->src_borrowed = true;
+    return ezcp_init_src(ret, src_name);
+}
+
+// frees an instruction's resources (and its children's, for blocks)
+static void ezci_free(ezcp* prog, ezci* inst) {
+    if (inst->type == EZCI_STR) {
+        if (INST_OWNS_STR(prog, *inst)) ezc_str_free(&inst->_str);
+    } else if (inst->type == EZCI_BLOCK && inst->m_prog != NULL && inst->m_prog != prog) {
+        // a top level block of a stream, which has its own program
+        ezcp_decref(inst->m_prog);
+    } else if (inst->type == EZCI_BLOCK) {
+        int i;
+        for (i = 0; i < inst->_block.n; ++i) {
+            ezci_free(prog, &inst->_block.children[i]);
+        }
+        ezc_free(inst->_block.children);
+        inst->_block.children = NULL;
+        inst->_block.n = 0;
     }
+}
+
+// frees a program, and all the instructions compiled under it
+// NOTE: blocks of this program that are still on a stack, or defined as
+//   functions, are no longer valid after this (reference counted programs are
+//   only freed by `ezcp_decref` once those are gone)
+void ezcp_free(ezcp* prog) {
+    ezci_free(prog, &prog->body);
+    ezc_str_free(&prog->src_name);
+    if (!prog->src_borrowed) ezc_str_free(&prog->src);
+    *prog = EZCP_EMPTY;
+}
 
-    return;
+ezcp* ezcp_new() {
+    ezcp* prog = ezc_malloc(sizeof(ezcp));
+    *prog = EZCP_EMPTY;
+    prog->refs = 1;
+    return prog;
 }
 
+// references may be taken and dropped from any thread (i.e. worker VMs), so
+//   the count is atomic. A program which isn't counted has 0 for as long as
+//   it lives, so it's never mistaken for one that is
+void ezcp_incref(ezcp* prog) {
+    if (prog != NULL && __atomic_load_n(&prog->refs, __ATOMIC_RELAXED) > 0) {
+        __atomic_add_fetch(&prog->refs, 1, __ATOMIC_RELAXED);
+    }
+}
+
+void ezcp_decref(ezcp* prog) {
+    if (prog != NULL && __atomic_load_n(&prog->refs, __ATOMIC_RELAXED) > 0) {
+        if (__atomic_sub_fetch(&prog->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+            ezcp_free(prog);
+            ezc_free(prog);
+        }
+    }
+}
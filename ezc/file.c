@@ -0,0 +1,538 @@
+// ezc/file.c - reading files record by record (i.e. line by line), for
+//                `openr!`, `lines!` and `records!`, and writing many pieces
+//                at once, for `writev!`
+//
+// Regular files are memory mapped, and records are handed out as strings
+//   borrowed from the mapping (see EZC_STR_MAPPED), so nothing is copied, and
+//   only the pages that are touched are read in. Since those strings may
+//   outlive the file, each mapping is reference counted (by the file, and by
+//   every string borrowed from it), and unmapped once the last is freed
+//
+// Anything else (pipes, terminals, empty files) is read in blocks into a
+//   buffer, and each record is copied out of it
+//
+// Pieces to write are given to `writev`, up to FILE_IOV_MAX at a time, so
+//   large strings don't have to be copied into a buffer first
+//
+// Files can also be written in the background (see `ezc_file_async`), by a
+//   thread of their own. Writes are collected into blocks, which are pushed
+//   onto a lock-free queue (Dmitry Vyukov's intrusive MPSC queue), so the
+//   writer never waits for the disk. Flushing waits for the queue to be
+//   written, and errors are reported by the next write or flush
+//
+// @author   : Cade Brown <cade@chemicaldevelopment.us>
+// @license  : WTFPL (http://www.wtfpl.net/)
+// @date     : 2019-12-09
+//
+
+// for memmem
+#define _GNU_SOURCE
+
+#include "ezc-impl.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <pthread.h>
+
+// the size of each block read from a stream
+#define FILE_BLOCK (64 * 1024)
+
+// the most pieces given to a single `writev` (POSIX allows at least 16, and
+//   Linux allows 1024)
+#define FILE_IOV_MAX 256
+
+// the most files which can be mapped at once (any more are read in blocks)
+#define FILE_MAPS_MAX 1024
+
+// the mappings currently in use, which are indexed by the strings borrowed
+//   from them (see EZC_STR_MAPPED). The table never moves, so references are
+//   counted without the lock, which only guards taking and releasing a slot
+static struct {
+    void* ptr;
+    size_t len;
+    int refs;
+} g_maps[FILE_MAPS_MAX];
+static pthread_mutex_t g_maps_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// maps all of `fd` (which is `size` bytes) into `f`, returning whether it
+//   could be mapped
+static bool file_map(ezc_file* f, int fd, size_t size) {
+    void* ptr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (ptr == MAP_FAILED) return false;
+    madvise(ptr, size, MADV_SEQUENTIAL);
+
+    // find a free slot, which the file holds the first reference to
+    pthread_mutex_lock(&g_maps_lock);
+    int i;
+    for (i = 0; i < FILE_MAPS_MAX && g_maps[i].ptr != NULL; ++i);
+    if (i == FILE_MAPS_MAX) {
+        pthread_mutex_unlock(&g_maps_lock);
+        munmap(ptr, size);
+        return false;
+    }
+    g_maps[i].ptr = ptr;
+    g_maps[i].len = size;
+    g_maps[i].refs = 1;
+    pthread_mutex_unlock(&g_maps_lock);
+
+    f->buf = ptr;
+    f->len = f->max_len = size;
+    f->mapped = true;
+    f->map = i;
+    f->eof = true;
+    return true;
+}
+
+void ezc_file_map_incref(int map) {
+    __atomic_add_fetch(&g_maps[map].refs, 1, __ATOMIC_RELAXED);
+}
+
+void ezc_file_map_decref(int map) {
+    if (__atomic_sub_fetch(&g_maps[map].refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        pthread_mutex_lock(&g_maps_lock);
+        munmap(g_maps[map].ptr, g_maps[map].len);
+        g_maps[map].ptr = NULL;
+        g_maps[map].len = 0;
+        pthread_mutex_unlock(&g_maps_lock);
+    }
+}
+
+int ezc_file_openr(ezc_file* f, const char* fname) {
+    *f = EZC_FILE_EMPTY;
+    f->reading = true;
+
+    int fd = open(fname, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat sb;
+    if (fstat(fd, &sb) == 0 && S_ISREG(sb.st_mode) && sb.st_size > 0 && file_map(f, fd, sb.st_size)) {
+        close(fd);
+        return 0;
+    }
+
+    // otherwise, it's read as it goes
+    f->fp = fdopen(fd, "r");
+    if (f->fp == NULL) {
+        close(fd);
+        return -1;
+    }
+    return 0;
+}
+
+// reads another block of a stream into `buf`, dropping everything before
+//   `pos`. Returns false at the end of the file
+static bool file_fill(ezc_file* f) {
+    if (f->eof) return false;
+
+    if (f->pos > 0) {
+        memmove(f->buf, f->buf + f->pos, f->len - f->pos);
+        f->len -= f->pos;
+        f->pos = 0;
+    }
+    if (f->max_len - f->len < FILE_BLOCK) {
+        f->max_len = 2 * f->max_len + FILE_BLOCK;
+        f->buf = ezc_realloc(f->buf, f->max_len);
+    }
+
+    // read whatever is available, so records from a pipe come as they're written
+    ssize_t got;
+    do {
+        got = read(fileno(f->fp), f->buf + f->len, f->max_len - f->len);
+    } while (got < 0 && errno == EINTR);
+
+    if (got <= 0) {
+        f->eof = true;
+        return false;
+    }
+    f->len += got;
+    return true;
+}
+
+// returns the first occurence of `sep` in `data[0:len]`, or NULL
+static char* file_find(char* data, size_t len, ezc_str sep) {
+    if (sep.len == 1) return memchr(data, sep._[0], len);
+    return memmem(data, len, sep._, sep.len);
+}
+
+int ezc_file_next(ezc_file* f, ezc_str sep, ezc_str* rec) {
+    // bytes after `pos` which are known not to start `sep`
+    size_t skip = 0;
+    size_t rec_len, next_len;
+
+    while (true) {
+        char* start = f->buf + f->pos;
+        char* end = f->pos + skip < f->len ? file_find(start + skip, f->len - f->pos - skip, sep) : NULL;
+        if (end != NULL) {
+            rec_len = end - start;
+            next_len = rec_len + sep.len;
+            break;
+        }
+        size_t have = f->len - f->pos;
+        if (have >= (size_t)sep.len) skip = have - sep.len + 1;
+        if (!file_fill(f)) {
+            // the last record doesn't need to end with `sep`
+            if (have == 0) return 0;
+            rec_len = next_len = have;
+            break;
+        }
+    }
+
+    if (rec_len > INT_MAX) {
+        ezc_error("Record in '%s' is too long (%zu bytes)", f->src_name._, rec_len);
+        return -1;
+    }
+
+    if (f->mapped) {
+        *rec = EZC_STR_MAPPED(f->buf + f->pos, rec_len, f->map);
+        ezc_file_map_incref(f->map);
+    } else {
+        *rec = EZC_STR_NULL;
+        ezc_str_copy_cp(rec, f->buf + f->pos, (int)rec_len);
+    }
+    f->pos += next_len;
+    return 1;
+}
+
+/* asynchronous writes */
+
+// the kinds of entries in the queue of an `ezc_aio`
+enum {
+    // data to write
+    AIO_DATA = 0,
+    // flush the file, then mark everything before as done
+    AIO_FLUSH,
+    // flush the file, then exit
+    AIO_QUIT
+};
+
+// an entry in the queue, which owns its data
+typedef struct aio_node {
+    struct aio_node* next;
+    int kind;
+    size_t len;
+    char data[];
+} aio_node;
+
+struct ezc_aio {
+
+    // the file being written (only touched by `thread`), and its name
+    FILE* fp;
+    ezc_str name;
+    pthread_t thread;
+
+    // the queue, where `tail` is where entries are pushed, and `head` is the
+    //   last entry taken (only touched by `thread`)
+    aio_node* tail;
+    aio_node* head;
+
+    // the data written since the last push, which is pushed as one block
+    char* buf;
+    size_t len;
+
+    // entries pushed, and entries that `thread` is finished with
+    uint64_t n_pushed, n_done;
+
+    // the first error (an `errno`) from `thread`, reported by the next call
+    int err;
+
+    // whether `thread` is sleeping, waiting for `wake`
+    int waiting;
+    // held while sleeping, or waiting for `done`
+    pthread_mutex_t lock;
+    pthread_cond_t wake, done;
+
+    // every `ezc_aio`, so they can be flushed at exit
+    ezc_aio* prev, * next;
+};
+
+// all the files being written in the background
+static ezc_aio* g_aios = NULL;
+static pthread_mutex_t g_aios_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static aio_node* aio_node_new(int kind, const void* data, size_t len) {
+    aio_node* node = ezc_malloc(sizeof(aio_node) + len);
+    node->next = NULL;
+    node->kind = kind;
+    node->len = len;
+    if (len > 0) memcpy(node->data, data, len);
+    return node;
+}
+
+// adds `node` to the queue, waking the thread if it's asleep
+static void aio_push(ezc_aio* aio, aio_node* node) {
+    aio_node* prev = __atomic_exchange_n(&aio->tail, node, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&prev->next, node, __ATOMIC_SEQ_CST);
+    aio->n_pushed++;
+
+    // (the thread sets `waiting` before checking the queue one last time, so
+    //   either it sees this node, or this sees that it's waiting)
+    if (__atomic_load_n(&aio->waiting, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&aio->lock);
+        pthread_cond_signal(&aio->wake);
+        pthread_mutex_unlock(&aio->lock);
+    }
+}
+
+// pushes the data collected since the last push
+static void aio_push_buf(ezc_aio* aio) {
+    if (aio->len > 0) {
+        aio_push(aio, aio_node_new(AIO_DATA, aio->buf, aio->len));
+        aio->len = 0;
+    }
+}
+
+// returns the next entry of the queue, or NULL if it's empty. The entry stays
+//   valid until the next call
+static aio_node* aio_take(ezc_aio* aio) {
+    aio_node* next = __atomic_load_n(&aio->head->next, __ATOMIC_SEQ_CST);
+    if (next == NULL) return NULL;
+    ezc_free(aio->head);
+    aio->head = next;
+    return next;
+}
+
+// records the first error
+static void aio_fail(ezc_aio* aio) {
+    int err = errno != 0 ? errno : EIO, none = 0;
+    __atomic_compare_exchange_n(&aio->err, &none, err, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
+
+// the thread writing a file
+static void* aio_main(void* _aio) {
+    ezc_aio* aio = _aio;
+    while (true) {
+        aio_node* node = aio_take(aio);
+        if (node == NULL) {
+            pthread_mutex_lock(&aio->lock);
+            __atomic_store_n(&aio->waiting, 1, __ATOMIC_SEQ_CST);
+            if (__atomic_load_n(&aio->head->next, __ATOMIC_SEQ_CST) == NULL) {
+                pthread_cond_wait(&aio->wake, &aio->lock);
+            }
+            __atomic_store_n(&aio->waiting, 0, __ATOMIC_SEQ_CST);
+            pthread_mutex_unlock(&aio->lock);
+            continue;
+        }
+
+        if (node->kind == AIO_DATA) {
+            if (fwrite(node->data, 1, node->len, aio->fp) != node->len) aio_fail(aio);
+        } else if (node->kind == AIO_FLUSH || node->kind == AIO_QUIT) {
+            if (fflush(aio->fp) != 0) aio_fail(aio);
+        }
+
+        pthread_mutex_lock(&aio->lock);
+        __atomic_store_n(&aio->n_done, aio->n_done + 1, __ATOMIC_RELEASE);
+        pthread_cond_broadcast(&aio->done);
+        pthread_mutex_unlock(&aio->lock);
+
+        if (node->kind == AIO_QUIT) break;
+    }
+    return NULL;
+}
+
+// reports (and clears) an error from the thread, returning nonzero if there
+//   was one
+static int aio_check(ezc_aio* aio) {
+    int err = __atomic_exchange_n(&aio->err, 0, __ATOMIC_RELAXED);
+    if (err == 0) return 0;
+    ezc_error("Writing to '%s' failed (in the background): %s", aio->name._, strerror(err));
+    return -1;
+}
+
+// pushes `kind` (after any data collected), and waits for it to be done
+static void aio_wait(ezc_aio* aio, int kind) {
+    aio_push_buf(aio);
+    aio_push(aio, aio_node_new(kind, NULL, 0));
+    uint64_t target = aio->n_pushed;
+
+    pthread_mutex_lock(&aio->lock);
+    while (__atomic_load_n(&aio->n_done, __ATOMIC_ACQUIRE) < target) {
+        pthread_cond_wait(&aio->done, &aio->lock);
+    }
+    pthread_mutex_unlock(&aio->lock);
+}
+
+int ezc_file_async(ezc_file* f) {
+    if (f->aio != NULL) return 0;
+    if (f->fp == NULL || f->reading) return -1;
+
+    // anything written so far goes first
+    fflush(f->fp);
+
+    ezc_aio* aio = ezc_malloc(sizeof(ezc_aio));
+    aio->fp = f->fp;
+    aio->name = EZC_STR_NULL;
+    ezc_str_copy(&aio->name, f->src_name);
+    aio->head = aio->tail = aio_node_new(AIO_DATA, NULL, 0);
+    aio->buf = ezc_malloc(EZC_OUT_BUFSIZE);
+    aio->len = 0;
+    aio->n_pushed = aio->n_done = 0;
+    aio->err = 0;
+    aio->waiting = 0;
+    pthread_mutex_init(&aio->lock, NULL);
+    pthread_cond_init(&aio->wake, NULL);
+    pthread_cond_init(&aio->done, NULL);
+
+    if (pthread_create(&aio->thread, NULL, aio_main, aio) != 0) {
+        pthread_mutex_destroy(&aio->lock);
+        pthread_cond_destroy(&aio->wake);
+        pthread_cond_destroy(&aio->done);
+        ezc_free(aio->head);
+        ezc_free(aio->buf);
+        ezc_str_free(&aio->name);
+        ezc_free(aio);
+        return -1;
+    }
+
+    pthread_mutex_lock(&g_aios_lock);
+    aio->prev = NULL;
+    aio->next = g_aios;
+    if (g_aios != NULL) g_aios->prev = aio;
+    g_aios = aio;
+    pthread_mutex_unlock(&g_aios_lock);
+
+    f->aio = aio;
+    return 0;
+}
+
+// stops the thread (after everything queued is written), reports any error
+//   that hasn't been yet, and frees `aio`
+static void aio_free(ezc_aio* aio) {
+    pthread_mutex_lock(&g_aios_lock);
+    if (aio->prev != NULL) aio->prev->next = aio->next;
+    else g_aios = aio->next;
+    if (aio->next != NULL) aio->next->prev = aio->prev;
+    pthread_mutex_unlock(&g_aios_lock);
+
+    aio_wait(aio, AIO_QUIT);
+    pthread_join(aio->thread, NULL);
+    aio_check(aio);
+
+    pthread_mutex_destroy(&aio->lock);
+    pthread_cond_destroy(&aio->wake);
+    pthread_cond_destroy(&aio->done);
+    ezc_free(aio->head);
+    ezc_free(aio->buf);
+    ezc_str_free(&aio->name);
+    ezc_free(aio);
+}
+
+void ezc_file_flush_all() {
+    pthread_mutex_lock(&g_aios_lock);
+    ezc_aio* aio;
+    for (aio = g_aios; aio != NULL; aio = aio->next) {
+        aio_wait(aio, AIO_FLUSH);
+        aio_check(aio);
+    }
+    pthread_mutex_unlock(&g_aios_lock);
+}
+
+/* writing files */
+
+int ezc_file_write(ezc_file* f, const void* data, size_t len) {
+    ezc_aio* aio = f->aio;
+    if (aio == NULL) return fwrite(data, 1, len, f->fp) == len ? 0 : -1;
+
+    if (aio_check(aio) != 0) return -1;
+    if (aio->len + len > EZC_OUT_BUFSIZE) {
+        aio_push_buf(aio);
+        if (len >= EZC_OUT_BUFSIZE) {
+            // big enough to be a block on its own
+            aio_push(aio, aio_node_new(AIO_DATA, data, len));
+            return 0;
+        }
+    }
+    memcpy(aio->buf + aio->len, data, len);
+    aio->len += len;
+    return 0;
+}
+
+int ezc_file_flush(ezc_file* f) {
+    if (f->aio == NULL) return fflush(f->fp) == 0 ? 0 : -1;
+    aio_wait(f->aio, AIO_FLUSH);
+    return aio_check(f->aio);
+}
+
+int ezc_file_writev(ezc_file* f, ezc_iov* iov, int n) {
+    if (f->aio != NULL) {
+        // the pieces are copied anyway, so they're just queued in order
+        int i;
+        for (i = 0; i < n; ++i) {
+            if (ezc_file_write(f, iov[i].data, iov[i].len) != 0) return -1;
+        }
+        return 0;
+    }
+
+    // anything already buffered goes first
+    if (f->fp == NULL || fflush(f->fp) != 0) return -1;
+    int fd = fileno(f->fp);
+
+    struct iovec vecs[FILE_IOV_MAX];
+    // the first piece left, and how much of it has been written
+    int i = 0;
+    size_t skip = 0;
+    while (i < n) {
+        int k;
+        for (k = 0; k < FILE_IOV_MAX && i + k < n; ++k) {
+            vecs[k].iov_base = (char*)iov[i + k].data;
+            vecs[k].iov_len = iov[i + k].len;
+        }
+        vecs[0].iov_base = (char*)vecs[0].iov_base + skip;
+        vecs[0].iov_len -= skip;
+
+        ssize_t got = writev(fd, vecs, k);
+        if (got < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+
+        // skip past what was written (which may end in the middle of a piece)
+        size_t left = got + skip;
+        while (i < n && left >= iov[i].len) {
+            left -= iov[i].len;
+            i++;
+        }
+        skip = left;
+        // nothing could be written, so don't try forever
+        if (got == 0 && i < n) return -1;
+    }
+    return 0;
+}
+
+void ezc_file_close(ezc_file* f) {
+    if (f->aio != NULL) {
+        aio_free(f->aio);
+        f->aio = NULL;
+    }
+    if (f->fp != NULL) {
+        fclose(f->fp);
+        f->fp = NULL;
+    }
+    // the mapping stays until the strings borrowing from it are freed too
+    if (f->mapped) {
+        ezc_file_map_decref(f->map);
+        f->mapped = false;
+        f->map = -1;
+    } else {
+        ezc_free(f->buf);
+    }
+    f->buf = NULL;
+    f->len = f->pos = f->max_len = 0;
+    ezc_str_free(&f->src_name);
+}
+
+void ezc_file_unmap_all() {
+    pthread_mutex_lock(&g_maps_lock);
+    int i;
+    for (i = 0; i < FILE_MAPS_MAX; ++i) {
+        if (g_maps[i].ptr != NULL) munmap(g_maps[i].ptr, g_maps[i].len);
+        g_maps[i].ptr = NULL;
+        g_maps[i].len = 0;
+        g_maps[i].refs = 0;
+    }
+    pthread_mutex_unlock(&g_maps_lock);
+}
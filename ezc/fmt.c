@@ -0,0 +1,391 @@
+// ezc/fmt.c - fast formatting of numbers, for `repr` and `print!`
+//
+// Integers are written two digits at a time (from a table of the 100 digit
+//   pairs, in `EZC_DIGIT_STR`), straight into the caller's buffer, from the
+//   last digit back
+//
+// Reals are written with the fewest digits that still read back as exactly
+//   the same double, using Grisu2 (Florian Loitsch, "Printing Floating-Point
+//   Numbers Quickly and Accurately with Integers", 2010). Grisu2 only needs
+//   64 bit integer math and a table of cached powers of 10, and its output
+//   always round trips (in rare cases, it may have one more digit than the
+//   shortest possible)
+//
+// @author   : Cade Brown <cade@chemicaldevelopment.us>
+// @license  : WTFPL (http://www.wtfpl.net/)
+// @date     : 2019-12-09
+//
+
+#include "ezc-impl.h"
+
+#include <math.h>
+
+/* integers */
+
+// the digits ints are written with (the same ones the lexer reads)
+static const char fmt_digs[] = EZC_DIGIT_STR;
+
+// "00", "01", ..., "99" (in `EZC_DIGIT_STR`), so two digits can be written at
+//   once
+#define FMT_PAIR(_t, _o) EZC_DIGIT_STR[_t], EZC_DIGIT_STR[_o]
+#define FMT_ROW(_t) FMT_PAIR(_t, 0), FMT_PAIR(_t, 1), FMT_PAIR(_t, 2), FMT_PAIR(_t, 3), FMT_PAIR(_t, 4), \
+    FMT_PAIR(_t, 5), FMT_PAIR(_t, 6), FMT_PAIR(_t, 7), FMT_PAIR(_t, 8), FMT_PAIR(_t, 9)
+static const char fmt_pairs[200] = {
+    FMT_ROW(0), FMT_ROW(1), FMT_ROW(2), FMT_ROW(3), FMT_ROW(4),
+    FMT_ROW(5), FMT_ROW(6), FMT_ROW(7), FMT_ROW(8), FMT_ROW(9),
+};
+#undef FMT_ROW
+#undef FMT_PAIR
+
+// returns the number of decimal digits in `u`
+static int fmt_count(uint64_t u) {
+    int n = 1;
+    while (true) {
+        if (u < 10) return n;
+        if (u < 100) return n + 1;
+        if (u < 1000) return n + 2;
+        if (u < 10000) return n + 3;
+        u /= 10000;
+        n += 4;
+    }
+}
+
+// writes `u` in base 10, returning the number of characters
+static int fmt_u64(char* buf, uint64_t u) {
+    int n = fmt_count(u);
+    char* p = buf + n;
+    while (u >= 100) {
+        int d = (int)(u % 100) * 2;
+        u /= 100;
+        *--p = fmt_pairs[d + 1];
+        *--p = fmt_pairs[d];
+    }
+    if (u >= 10) {
+        int d = (int)u * 2;
+        *--p = fmt_pairs[d + 1];
+        *--p = fmt_pairs[d];
+    } else {
+        *--p = fmt_digs[u];
+    }
+    return n;
+}
+
+int ezc_fmt_int(char* buf, ezc_int x) {
+    int n = 0;
+    // (negating in unsigned, so EZC_INT_MIN works)
+    uint64_t u = (uint64_t)x;
+    if (x < 0) {
+        buf[n++] = '-';
+        u = -u;
+    }
+    n += fmt_u64(buf + n, u);
+    buf[n] = '\0';
+    return n;
+}
+
+/* reals */
+
+// a floating point number with a 64 bit significand, `f * 2^e` (a `diy_fp`
+//   in the paper)
+typedef struct {
+    uint64_t f;
+    int e;
+} fmt_fp;
+
+// cached powers of 10, `10^(8i - 348)`, rounded to 64 bits (enough to cover
+//   the exponents of every double)
+static const fmt_fp fmt_pow10[] = {
+    { 0xfa8fd5a0081c0288ULL, -1220 }, // 1e-348
+    { 0xbaaee17fa23ebf76ULL, -1193 }, // 1e-340
+    { 0x8b16fb203055ac76ULL, -1166 }, // 1e-332
+    { 0xcf42894a5dce35eaULL, -1140 }, // 1e-324
+    { 0x9a6bb0aa55653b2dULL, -1113 }, // 1e-316
+    { 0xe61acf033d1a45dfULL, -1087 }, // 1e-308
+    { 0xab70fe17c79ac6caULL, -1060 }, // 1e-300
+    { 0xff77b1fcbebcdc4fULL, -1034 }, // 1e-292
+    { 0xbe5691ef416bd60cULL, -1007 }, // 1e-284
+    { 0x8dd01fad907ffc3cULL,  -980 }, // 1e-276
+    { 0xd3515c2831559a83ULL,  -954 }, // 1e-268
+    { 0x9d71ac8fada6c9b5ULL,  -927 }, // 1e-260
+    { 0xea9c227723ee8bcbULL,  -901 }, // 1e-252
+    { 0xaecc49914078536dULL,  -874 }, // 1e-244
+    { 0x823c12795db6ce57ULL,  -847 }, // 1e-236
+    { 0xc21094364dfb5637ULL,  -821 }, // 1e-228
+    { 0x9096ea6f3848984fULL,  -794 }, // 1e-220
+    { 0xd77485cb25823ac7ULL,  -768 }, // 1e-212
+    { 0xa086cfcd97bf97f4ULL,  -741 }, // 1e-204
+    { 0xef340a98172aace5ULL,  -715 }, // 1e-196
+    { 0xb23867fb2a35b28eULL,  -688 }, // 1e-188
+    { 0x84c8d4dfd2c63f3bULL,  -661 }, // 1e-180
+    { 0xc5dd44271ad3cdbaULL,  -635 }, // 1e-172
+    { 0x936b9fcebb25c996ULL,  -608 }, // 1e-164
+    { 0xdbac6c247d62a584ULL,  -582 }, // 1e-156
+    { 0xa3ab66580d5fdaf6ULL,  -555 }, // 1e-148
+    { 0xf3e2f893dec3f126ULL,  -529 }, // 1e-140
+    { 0xb5b5ada8aaff80b8ULL,  -502 }, // 1e-132
+    { 0x87625f056c7c4a8bULL,  -475 }, // 1e-124
+    { 0xc9bcff6034c13053ULL,  -449 }, // 1e-116
+    { 0x964e858c91ba2655ULL,  -422 }, // 1e-108
+    { 0xdff9772470297ebdULL,  -396 }, // 1e-100
+    { 0xa6dfbd9fb8e5b88fULL,  -369 }, // 1e-92
+    { 0xf8a95fcf88747d94ULL,  -343 }, // 1e-84
+    { 0xb94470938fa89bcfULL,  -316 }, // 1e-76
+    { 0x8a08f0f8bf0f156bULL,  -289 }, // 1e-68
+    { 0xcdb02555653131b6ULL,  -263 }, // 1e-60
+    { 0x993fe2c6d07b7facULL,  -236 }, // 1e-52
+    { 0xe45c10c42a2b3b06ULL,  -210 }, // 1e-44
+    { 0xaa242499697392d3ULL,  -183 }, // 1e-36
+    { 0xfd87b5f28300ca0eULL,  -157 }, // 1e-28
+    { 0xbce5086492111aebULL,  -130 }, // 1e-20
+    { 0x8cbccc096f5088ccULL,  -103 }, // 1e-12
+    { 0xd1b71758e219652cULL,   -77 }, // 1e-4
+    { 0x9c40000000000000ULL,   -50 }, // 1e4
+    { 0xe8d4a51000000000ULL,   -24 }, // 1e12
+    { 0xad78ebc5ac620000ULL,     3 }, // 1e20
+    { 0x813f3978f8940984ULL,    30 }, // 1e28
+    { 0xc097ce7bc90715b3ULL,    56 }, // 1e36
+    { 0x8f7e32ce7bea5c70ULL,    83 }, // 1e44
+    { 0xd5d238a4abe98068ULL,   109 }, // 1e52
+    { 0x9f4f2726179a2245ULL,   136 }, // 1e60
+    { 0xed63a231d4c4fb27ULL,   162 }, // 1e68
+    { 0xb0de65388cc8ada8ULL,   189 }, // 1e76
+    { 0x83c7088e1aab65dbULL,   216 }, // 1e84
+    { 0xc45d1df942711d9aULL,   242 }, // 1e92
+    { 0x924d692ca61be758ULL,   269 }, // 1e100
+    { 0xda01ee641a708deaULL,   295 }, // 1e108
+    { 0xa26da3999aef774aULL,   322 }, // 1e116
+    { 0xf209787bb47d6b85ULL,   348 }, // 1e124
+    { 0xb454e4a179dd1877ULL,   375 }, // 1e132
+    { 0x865b86925b9bc5c2ULL,   402 }, // 1e140
+    { 0xc83553c5c8965d3dULL,   428 }, // 1e148
+    { 0x952ab45cfa97a0b3ULL,   455 }, // 1e156
+    { 0xde469fbd99a05fe3ULL,   481 }, // 1e164
+    { 0xa59bc234db398c25ULL,   508 }, // 1e172
+    { 0xf6c69a72a3989f5cULL,   534 }, // 1e180
+    { 0xb7dcbf5354e9beceULL,   561 }, // 1e188
+    { 0x88fcf317f22241e2ULL,   588 }, // 1e196
+    { 0xcc20ce9bd35c78a5ULL,   614 }, // 1e204
+    { 0x98165af37b2153dfULL,   641 }, // 1e212
+    { 0xe2a0b5dc971f303aULL,   667 }, // 1e220
+    { 0xa8d9d1535ce3b396ULL,   694 }, // 1e228
+    { 0xfb9b7cd9a4a7443cULL,   720 }, // 1e236
+    { 0xbb764c4ca7a44410ULL,   747 }, // 1e244
+    { 0x8bab8eefb6409c1aULL,   774 }, // 1e252
+    { 0xd01fef10a657842cULL,   800 }, // 1e260
+    { 0x9b10a4e5e9913129ULL,   827 }, // 1e268
+    { 0xe7109bfba19c0c9dULL,   853 }, // 1e276
+    { 0xac2820d9623bf429ULL,   880 }, // 1e284
+    { 0x80444b5e7aa7cf85ULL,   907 }, // 1e292
+    { 0xbf21e44003acdd2dULL,   933 }, // 1e300
+    { 0x8e679c2f5e44ff8fULL,   960 }, // 1e308
+    { 0xd433179d9c8cb841ULL,   986 }, // 1e316
+    { 0x9e19db92b4e31ba9ULL,  1013 }, // 1e324
+    { 0xeb96bf6ebadf77d9ULL,  1039 }, // 1e332
+    { 0xaf87023b9bf0ee6bULL,  1066 }, // 1e340
+};
+
+// 10^i, up to the largest that fits in 64 bits
+static const uint64_t fmt_pow10_64[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL,
+    10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL, 100000000000000ULL,
+    1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL, 1000000000000000000ULL,
+    10000000000000000000ULL
+};
+
+// the product of two numbers, rounded to 64 bits
+static fmt_fp fmt_mul(fmt_fp x, fmt_fp y) {
+    const uint64_t M32 = 0xFFFFFFFFULL;
+    uint64_t a = x.f >> 32, b = x.f & M32, c = y.f >> 32, d = y.f & M32;
+    uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    uint64_t tmp = (bd >> 32) + (ad & M32) + (bc & M32);
+    // round
+    tmp += 1ULL << 31;
+    return (fmt_fp){ ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), x.e + y.e + 64 };
+}
+
+// shifts `x` so its top bit is set
+static fmt_fp fmt_normalize(fmt_fp x) {
+    while (!(x.f & (1ULL << 63))) {
+        x.f <<= 1;
+        x.e--;
+    }
+    return x;
+}
+
+// computes the halfway points between `d` and its neighbors, `m` (below) and
+//   `p` (above), which are the bounds that still round to `d`. Returns `d`
+//   itself as a `fmt_fp`
+static fmt_fp fmt_bounds(double d, fmt_fp* m, fmt_fp* p) {
+    const uint64_t hidden = 1ULL << 52;
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    int be = (int)((bits >> 52) & 0x7FF);
+    uint64_t sig = bits & (hidden - 1);
+
+    fmt_fp v;
+    if (be != 0) v = (fmt_fp){ sig + hidden, be - 1075 };
+    else v = (fmt_fp){ sig, -1074 };
+
+    // the upper bound, normalized
+    fmt_fp pl = (fmt_fp){ (v.f << 1) + 1, v.e - 1 };
+    while (!(pl.f & (hidden << 1))) {
+        pl.f <<= 1;
+        pl.e--;
+    }
+    pl.f <<= 64 - 52 - 2;
+    pl.e -= 64 - 52 - 2;
+
+    // the lower bound is closer when `d` is a power of 2 (the spacing below
+    //   it is half as big), and is scaled to the same exponent
+    fmt_fp mi = v.f == hidden ? (fmt_fp){ (v.f << 2) - 1, v.e - 2 } : (fmt_fp){ (v.f << 1) - 1, v.e - 1 };
+    mi.f <<= mi.e - pl.e;
+    mi.e = pl.e;
+
+    *m = mi;
+    *p = pl;
+    return v;
+}
+
+// moves the last digit closer to `w` (while staying in the bounds)
+static void fmt_round(char* buf, int len, uint64_t delta, uint64_t rest, uint64_t ten_kappa, uint64_t wp_w) {
+    while (rest < wp_w && delta - rest >= ten_kappa && (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+        buf[len - 1]--;
+        rest += ten_kappa;
+    }
+}
+
+// generates the digits of `w`, stopping as soon as they are within `delta`
+//   of the upper bound `mp`. Sets `*len`, and adds the exponent to `*K`
+static void fmt_digits(fmt_fp w, fmt_fp mp, uint64_t delta, char* buf, int* len, int* K) {
+    fmt_fp one = (fmt_fp){ 1ULL << -mp.e, mp.e };
+    uint64_t wp_w = mp.f - w.f;
+    uint32_t p1 = (uint32_t)(mp.f >> -one.e);
+    uint64_t p2 = mp.f & (one.f - 1);
+    int kappa = fmt_count(p1);
+    *len = 0;
+
+    // the integer part
+    while (kappa > 0) {
+        uint32_t d = p1 / (uint32_t)fmt_pow10_64[kappa - 1];
+        p1 %= (uint32_t)fmt_pow10_64[kappa - 1];
+        if (d || *len) buf[(*len)++] = (char)('0' + d);
+        kappa--;
+        uint64_t tmp = ((uint64_t)p1 << -one.e) + p2;
+        if (tmp <= delta) {
+            *K += kappa;
+            fmt_round(buf, *len, delta, tmp, fmt_pow10_64[kappa] << -one.e, wp_w);
+            return;
+        }
+    }
+
+    // the fractional part
+    while (true) {
+        p2 *= 10;
+        delta *= 10;
+        char d = (char)(p2 >> -one.e);
+        if (d || *len) buf[(*len)++] = (char)('0' + d);
+        p2 &= one.f - 1;
+        kappa--;
+        if (p2 < delta) {
+            *K += kappa;
+            // (the distance to `w` is scaled like the digits, so rounding still
+            //   picks the closest last digit this far into the fraction)
+            fmt_round(buf, *len, delta, p2, one.f, -kappa < 20 ? wp_w * fmt_pow10_64[-kappa] : 0);
+            return;
+        }
+    }
+}
+
+// writes the shortest digits of `d` (which must be positive and finite) into
+//   `buf`, such that `d = digits * 10^K`, and returns how many there are
+static int fmt_grisu2(double d, char* buf, int* K) {
+    fmt_fp m, p;
+    fmt_fp v = fmt_normalize(fmt_bounds(d, &m, &p));
+
+    // find a cached power that brings the upper bound's exponent into
+    //   [-60, -32], so the integer part of the digits fits in 32 bits
+    double dk = (-61 - p.e) * 0.30102999566398114 + 347;
+    int k = (int)dk;
+    if (dk - k > 0.0) k++;
+    int idx = (k >> 3) + 1;
+    *K = -(-348 + idx * 8);
+    fmt_fp c = fmt_pow10[idx];
+
+    fmt_fp w = fmt_mul(v, c), wp = fmt_mul(p, c), wm = fmt_mul(m, c);
+    // (the bounds are inexact after multiplying, so stay strictly inside)
+    wm.f++;
+    wp.f--;
+
+    int len;
+    fmt_digits(w, wp, wp.f - wm.f, buf, &len, K);
+    return len;
+}
+
+// writes the exponent of scientific notation, like `e+21` or `e-7`
+static int fmt_exp(char* buf, int e) {
+    int n = 0;
+    buf[n++] = 'e';
+    buf[n++] = e < 0 ? '-' : '+';
+    // (reals are always written with '0'-'9', so this doesn't use `fmt_u64`)
+    if (e < 0) e = -e;
+    if (e >= 100) buf[n++] = (char)('0' + e / 100);
+    if (e >= 10) buf[n++] = (char)('0' + e / 10 % 10);
+    buf[n++] = (char)('0' + e % 10);
+    return n;
+}
+
+int ezc_fmt_real(char* buf, ezc_real x) {
+    int n = 0;
+    if (isnan(x)) {
+        memcpy(buf, "nan", 4);
+        return 3;
+    }
+    if (signbit(x)) {
+        buf[n++] = '-';
+        x = -x;
+    }
+    if (isinf(x)) {
+        memcpy(buf + n, "inf", 4);
+        return n + 3;
+    }
+    if (x == 0.0) {
+        memcpy(buf + n, "0.0", 4);
+        return n + 3;
+    }
+
+    char* p = buf + n;
+    int K, len = fmt_grisu2(x, p, &K);
+    // `x` is in [10^(kk-1), 10^kk)
+    int kk = len + K;
+
+    if (K >= 0 && kk <= 21) {
+        // a whole number, like `1234000.0`
+        memset(p + len, '0', K);
+        memcpy(p + kk, ".0", 2);
+        n += kk + 2;
+    } else if (kk > 0 && kk <= 21) {
+        // a decimal point in the digits, like `12.34`
+        memmove(p + kk + 1, p + kk, len - kk);
+        p[kk] = '.';
+        n += len + 1;
+    } else if (kk > -6 && kk <= 0) {
+        // a small number, like `0.001234`
+        int z = 2 - kk;
+        memmove(p + z, p, len);
+        p[0] = '0';
+        p[1] = '.';
+        memset(p + 2, '0', -kk);
+        n += len + z;
+    } else if (len == 1) {
+        // one digit, like `1e+30`
+        n += 1 + fmt_exp(p + 1, kk - 1);
+    } else {
+        // scientific notation, like `1.234e+30`
+        memmove(p + 2, p + 1, len - 1);
+        p[1] = '.';
+        n += len + 1 + fmt_exp(p + len + 1, kk - 1);
+    }
+
+    buf[n] = '\0';
+    return n;
+}
@@ -1,34 +1,7 @@
 #include "ezc-impl.h"
 
 
-/* text formatting macros */
-
-// Resets all formatting
-#define EC_RST   "\033[0m"
-// Sets text to be bold
-#define EC_BLD   "\033[1m"
-// Sets text to be underline
-#define EC_ULN   "\033[4m"
-// Sets text to be italicized
-#define EC_ITA   "\033[3m"
-
-// Sets text to be white (default)
-#define EC_WHT   "\033[37m"
-// Sets text to be red
-#define EC_RED   "\033[31m"
-// Sets text to be green
-#define EC_GRN   "\033[32m"
-// Sets text to be yellow
-#define EC_YLW   "\033[33m"
-// Sets text to be blue
-#define EC_BLU   "\033[34m"
-// Sets text to be magenta
-#define EC_MAG   "\033[35m"
-// Sets text to be cyan
-#define EC_CYN   "\033[36m"
-
-
-// current level 
+// current level (read and written atomically, since any thread may log)
 static int _lvl = EZC_LOG_INFO;
 
 static const char* _lvl_names[] = {
@@ -41,18 +14,19 @@ static const char* _lvl_names[] = {
 
 
 int ezc_log_get_level() {
-    return _lvl;
+    return __atomic_load_n(&_lvl, __ATOMIC_RELAXED);
 }
 
 void ezc_log_set_level(int new_lvl) {
     if (new_lvl < EZC_LOG_TRACE) new_lvl = EZC_LOG_TRACE;
     else if (new_lvl > EZC_LOG_ERROR) new_lvl = EZC_LOG_ERROR;
     else {
-        _lvl = new_lvl;
+        __atomic_store_n(&_lvl, new_lvl, __ATOMIC_RELAXED);
     }
 }
 
 void ezc_print(const char* fmt, ...) {
+    ezc_out_sync();
     va_list args;
     va_start(args, fmt);
     vfprintf(stdout, fmt, args);
@@ -62,6 +36,7 @@ void ezc_print(const char* fmt, ...) {
 }
 
 void ezc_printr(const char* fmt, ...) {
+    ezc_out_sync();
     va_list args;
     va_start(args, fmt);
     vfprintf(stdout, fmt, args);
@@ -71,9 +46,13 @@ void ezc_printr(const char* fmt, ...) {
 void ezc_printmeta(ezci inst) {
     ezc_print("In %*s, @ Line %d, Col %d:", inst.m_prog->src_name.len, inst.m_prog->src_name._, inst.m_line+1, inst.m_col+1);
 
-    char* posp = inst.m_prog->src._;
+    // the source isn't kept for streamed programs, so there's nothing to show
+    if (inst.m_prog->src._ == NULL) return;
+
+    // the source may be borrowed (i.e. memory mapped), so it may not be NUL terminated
+    char* posp = inst.m_prog->src._, * stop = inst.m_prog->src._ + inst.m_prog->src.len;
     int _line = 0;
-    while (*posp && _line < inst.m_line) {
+    while (posp < stop && _line < inst.m_line) {
         if (*posp == '\n') {
             _line++;
         }
@@ -83,7 +62,7 @@ void ezc_printmeta(ezci inst) {
     int i = 0;
     //printf("'%s'\n", lstart);
     // now, at beginning of line
-    while (*posp && *posp != '\n') {
+    while (posp < stop && *posp != '\n') {
         if (i == inst.m_col) {
             ezc_printr(EC_RED EC_BLD);
         } else if (i >= inst.m_col + inst.m_len) {
@@ -115,6 +94,9 @@ void ezc_log(int level, const char *file, int line, const char* fmt, ...) {
         return;
     }
 
+    // anything printed before the log should come before it
+    ezc_out_sync();
+
     fprintf(stdout, EC_BLD "%s" EC_RST ": ", _lvl_names[level]);
 
     va_list args;
@@ -1,8 +1,47 @@
 
 #include "ezc-impl.h"
 
+// glibc can report the size of an allocation, which is used to keep track of
+//   how many bytes are live
+#ifdef __GLIBC__
+#include <malloc.h>
+#define MEM_SIZE(_ptr) malloc_usable_size(_ptr)
+#else
+#define MEM_SIZE(_ptr) ((size_t)0)
+#endif
+
+// the number of users of the live count (i.e. tracers). Allocations are only
+//   counted while there are any, so otherwise they don't pay for looking up
+//   their size and for an atomic add on a shared counter
+static int g_counting = 0;
+
+// net number of bytes allocated since counting started (updated atomically,
+//   since programs may be compiled on other threads)
+static int64_t g_live = 0;
+
+// whether allocations are being counted
+#define COUNTING() (__atomic_load_n(&g_counting, __ATOMIC_RELAXED) > 0)
+
+// adds `_n` bytes to the live count
+#define LIVE_ADD(_n) __atomic_add_fetch(&g_live, (_n), __ATOMIC_RELAXED)
+
+void ezc_mem_count_start() {
+    if (__atomic_fetch_add(&g_counting, 1, __ATOMIC_ACQ_REL) == 0) {
+        __atomic_store_n(&g_live, 0, __ATOMIC_RELAXED);
+    }
+}
+
+void ezc_mem_count_stop() {
+    __atomic_sub_fetch(&g_counting, 1, __ATOMIC_ACQ_REL);
+}
+
+int64_t ezc_mem_live() {
+    return __atomic_load_n(&g_live, __ATOMIC_RELAXED);
+}
+
 void* ezc_malloc(size_t sz) {
     void* ptr = malloc(sz);
+    if (ptr != NULL && COUNTING()) LIVE_ADD((int64_t)MEM_SIZE(ptr));
     ezc_trace("ezc_malloc(%lu) -> %p", sz, ptr);
     // debug on allocations larger than
     if (sz > 1024 * 1024) {
@@ -16,12 +55,18 @@ void* ezc_malloc(size_t sz) {
 
 void ezc_free(void* ptr) {
     ezc_trace("ezc_free(%p)", ptr);
-    if (ptr != NULL) free(ptr);
+    if (ptr != NULL) {
+        if (COUNTING()) LIVE_ADD(-(int64_t)MEM_SIZE(ptr));
+        free(ptr);
+    }
 }
 
 void* ezc_realloc(void* ptr, size_t sz) {
     if (ptr == NULL) return ezc_malloc(sz);
+    bool counting = COUNTING();
+    size_t old_sz = counting ? MEM_SIZE(ptr) : 0;
     void* new_ptr = realloc(ptr, sz);
+    if (new_ptr != NULL && counting) LIVE_ADD((int64_t)MEM_SIZE(new_ptr) - (int64_t)old_sz);
     ezc_trace("ezc_realloc(%p, %lu) -> %p", ptr, sz, new_ptr);
     if (sz > 1e6) {
         ezc_debug("[LARGE ] realloc'ing %lu%s", ezc_bytesize_dig(sz), ezc_bytesize_name(sz));
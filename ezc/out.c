@@ -0,0 +1,117 @@
+// ezc/out.c - the buffered output of a VM, for `print!` and friends
+//
+// Everything a VM prints goes into its own buffer (formatted straight into
+//   it, for numbers), which is written to stdout in one call once it fills
+//   up, instead of going through stdio (and its lock) for each print. When
+//   stdout is a terminal, or the mode is EZC_OUT_UNBUFFERED, it is written
+//   out after every print instead, so output shows up right away
+//
+// Logs (and errors) are written to stdout directly, so the last VM that
+//   printed on each thread is remembered, and written out first (see
+//   `ezc_out_sync`). A VM's output must be written out (i.e. with
+//   `ezc_out_flush`) before it is used on another thread
+//
+// @author   : Cade Brown <cade@chemicaldevelopment.us>
+// @license  : WTFPL (http://www.wtfpl.net/)
+// @date     : 2019-12-09
+//
+
+// for isatty
+#define _DEFAULT_SOURCE
+
+#include "ezc-impl.h"
+
+#include <unistd.h>
+
+// the VM on this thread which may have output buffered
+static __thread ezc_vm* g_pending = NULL;
+
+// writes the buffer of `vm` to stdout (without flushing stdout itself)
+static void out_drain(ezc_vm* vm) {
+    if (vm->out.len > 0) {
+        fwrite(vm->out.buf, 1, vm->out.len, stdout);
+        vm->out.len = 0;
+    }
+    if (g_pending == vm) g_pending = NULL;
+}
+
+char* ezc_out_reserve(ezc_vm* vm, int len) {
+    if (g_pending != vm) {
+        // keep the order between VMs printing on the same thread
+        if (g_pending != NULL) out_drain(g_pending);
+        g_pending = vm;
+    }
+    if (vm->out.len + len > vm->out.max_len) {
+        out_drain(vm);
+        g_pending = vm;
+        if (len > vm->out.max_len) {
+            vm->out.max_len = len > EZC_OUT_BUFSIZE ? len : EZC_OUT_BUFSIZE;
+            vm->out.buf = ezc_realloc(vm->out.buf, vm->out.max_len);
+        }
+    }
+    return vm->out.buf + vm->out.len;
+}
+
+void ezc_out_commit(ezc_vm* vm, int len) {
+    vm->out.len += len;
+}
+
+void ezc_out_write(ezc_vm* vm, const char* data, int len) {
+    if (len >= EZC_OUT_BUFSIZE) {
+        // too big to be worth copying
+        ezc_out_sync();
+        fwrite(data, 1, len, stdout);
+        return;
+    }
+    memcpy(ezc_out_reserve(vm, len), data, len);
+    vm->out.len += len;
+}
+
+void ezc_out_printf(ezc_vm* vm, const char* fmt, ...) {
+    va_list args;
+    int room = 256;
+    char* buf = ezc_out_reserve(vm, room);
+
+    va_start(args, fmt);
+    int len = vsnprintf(buf, room, fmt, args);
+    va_end(args);
+
+    if (len >= room) {
+        // didn't fit, so try again with enough room
+        buf = ezc_out_reserve(vm, len + 1);
+        va_start(args, fmt);
+        vsnprintf(buf, len + 1, fmt, args);
+        va_end(args);
+    }
+    if (len > 0) vm->out.len += len;
+}
+
+void ezc_out_end(ezc_vm* vm) {
+    if (!vm->out.init) {
+        vm->out.eager = vm->out.mode == EZC_OUT_UNBUFFERED || (vm->out.mode == EZC_OUT_AUTO && isatty(STDOUT_FILENO));
+        vm->out.init = true;
+    }
+    if (vm->out.eager) ezc_out_flush(vm);
+}
+
+void ezc_out_flush(ezc_vm* vm) {
+    out_drain(vm);
+    fflush(stdout);
+}
+
+void ezc_out_sync() {
+    if (g_pending != NULL) out_drain(g_pending);
+}
+
+void ezc_out_set_mode(ezc_vm* vm, int mode) {
+    ezc_out_flush(vm);
+    vm->out.mode = mode;
+    vm->out.init = false;
+}
+
+void ezc_out_free(ezc_vm* vm) {
+    ezc_out_flush(vm);
+    ezc_free(vm->out.buf);
+    vm->out.buf = NULL;
+    vm->out.len = vm->out.max_len = 0;
+}
@@ -0,0 +1,267 @@
+// ezc/perf.c - hardware performance counters (cycles, instructions, cache
+//                misses, etc) around a whole run, and per user function
+//
+// This uses Linux's `perf_event_open`. On other systems, or when the counters
+//   are restricted (i.e. `/proc/sys/kernel/perf_event_paranoid`, or seccomp
+//   inside containers), nothing is opened and the reports say so
+//
+// @author   : Cade Brown <cade@chemicaldevelopment.us>
+// @license  : WTFPL (http://www.wtfpl.net/)
+// @date     : 2019-12-03
+//
+
+// for syscall()
+#define _GNU_SOURCE
+
+#include "ezc-impl.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+static const char* g_perf_names[EZC_PERF_N] = {
+    "cycles",
+    "instructions",
+    "branch-misses",
+    "L1-dcache-load-misses",
+    "LLC-misses"
+};
+
+const char* ezc_perf_name(int idx) {
+    return (idx >= 0 && idx < EZC_PERF_N) ? g_perf_names[idx] : "?";
+}
+
+#ifdef __linux__
+
+// the layout read from a counter, with PERF_FORMAT_TOTAL_TIME_*
+struct perf_readfmt {
+    uint64_t value;
+    uint64_t time_enabled;
+    uint64_t time_running;
+};
+
+// opens a single counter for this process (user-space only, so that the
+//   default `perf_event_paranoid` of 2 still allows it)
+static int perf_open1(uint32_t type, uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+#endif
+
+int ezc_perf_open(ezc_perf* perf) {
+    memset(perf, 0, sizeof(*perf));
+    int i;
+    for (i = 0; i < EZC_PERF_N; ++i) perf->fds[i] = -1;
+
+#ifdef __linux__
+    const uint64_t cache_rd_miss = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    const uint32_t types[EZC_PERF_N] = {
+        PERF_TYPE_HARDWARE,
+        PERF_TYPE_HARDWARE,
+        PERF_TYPE_HARDWARE,
+        PERF_TYPE_HW_CACHE,
+        PERF_TYPE_HARDWARE
+    };
+    const uint64_t configs[EZC_PERF_N] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_BRANCH_MISSES,
+        PERF_COUNT_HW_CACHE_L1D | cache_rd_miss,
+        PERF_COUNT_HW_CACHE_MISSES
+    };
+
+    int err = 0;
+    for (i = 0; i < EZC_PERF_N; ++i) {
+        perf->fds[i] = perf_open1(types[i], configs[i]);
+        if (perf->fds[i] < 0) {
+            if (err == 0) err = errno;
+            ezc_debug("Couldn't open counter '%s' (errno %d)", g_perf_names[i], errno);
+        } else {
+            perf->n_open++;
+        }
+    }
+
+    if (perf->n_open == 0) {
+        if (err == EACCES || err == EPERM) {
+            ezc_warn("Hardware counters are restricted (see /proc/sys/kernel/perf_event_paranoid), continuing without them");
+        } else {
+            ezc_warn("Hardware counters are unavailable (errno %d), continuing without them", err);
+        }
+        return 0;
+    }
+
+    for (i = 0; i < EZC_PERF_N; ++i) {
+        if (perf->fds[i] >= 0) {
+            ioctl(perf->fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(perf->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+#else
+    ezc_warn("Hardware counters are only supported on Linux, continuing without them");
+#endif
+
+    ezc_perf_read(perf, &perf->start);
+    return perf->n_open;
+}
+
+void ezc_perf_read(ezc_perf* perf, ezc_perf_vals* vals) {
+    int i;
+    for (i = 0; i < EZC_PERF_N; ++i) {
+        vals->_[i] = 0;
+#ifdef __linux__
+        struct perf_readfmt rf;
+        if (perf->fds[i] >= 0 && read(perf->fds[i], &rf, sizeof(rf)) == sizeof(rf)) {
+            // scale up if the counter was multiplexed with others
+            if (rf.time_running > 0 && rf.time_running < rf.time_enabled) {
+                vals->_[i] = (uint64_t)((double)rf.value * rf.time_enabled / rf.time_running);
+            } else {
+                vals->_[i] = rf.value;
+            }
+        }
+#endif
+    }
+}
+
+/* per function counts */
+
+// finds (or adds) a function's index in the table
+static int perf_funci(ezc_perf* perf, ezc_str name) {
+    int i;
+    for (i = 0; i < perf->funcs.n; ++i) {
+        if (ezc_str_eq(name, perf->funcs.keys[i])) return i;
+    }
+    i = perf->funcs.n++;
+    perf->funcs.keys = ezc_realloc(perf->funcs.keys, sizeof(ezc_str) * perf->funcs.n);
+    perf->funcs.calls = ezc_realloc(perf->funcs.calls, sizeof(int) * perf->funcs.n);
+    perf->funcs.self = ezc_realloc(perf->funcs.self, sizeof(ezc_perf_vals) * perf->funcs.n);
+    perf->funcs.keys[i] = EZC_STR_NULL;
+    ezc_str_copy(&perf->funcs.keys[i], name);
+    perf->funcs.calls[i] = 0;
+    memset(&perf->funcs.self[i], 0, sizeof(ezc_perf_vals));
+    return i;
+}
+
+static void perf_enter(ezc_vm* vm, ezc_str name, void* data) {
+    ezc_perf* perf = data;
+    int idx = perf->frames.n++;
+    if (perf->frames.n > perf->frames.max_n) {
+        perf->frames.max_n = (int)(1.5 * perf->frames.n + 10);
+        perf->frames.start = ezc_realloc(perf->frames.start, sizeof(ezc_perf_vals) * perf->frames.max_n);
+        perf->frames.child = ezc_realloc(perf->frames.child, sizeof(ezc_perf_vals) * perf->frames.max_n);
+    }
+    memset(&perf->frames.child[idx], 0, sizeof(ezc_perf_vals));
+    // read last, so the bookkeeping above isn't counted
+    ezc_perf_read(perf, &perf->frames.start[idx]);
+}
+
+static void perf_leave(ezc_vm* vm, ezc_str name, void* data) {
+    ezc_perf* perf = data;
+    ezc_perf_vals now;
+    ezc_perf_read(perf, &now);
+    if (perf->frames.n <= 0) return;
+
+    int idx = --perf->frames.n;
+    int fi = perf_funci(perf, name);
+    perf->funcs.calls[fi]++;
+
+    int i;
+    for (i = 0; i < EZC_PERF_N; ++i) {
+        uint64_t incl = now._[i] - perf->frames.start[idx]._[i];
+        uint64_t child = perf->frames.child[idx]._[i];
+        perf->funcs.self[fi]._[i] += incl > child ? incl - child : 0;
+        // the caller shouldn't count this as its own
+        if (idx > 0) perf->frames.child[idx - 1]._[i] += incl;
+    }
+}
+
+void ezc_perf_attach(ezc_perf* perf, ezc_vm* vm) {
+    if (perf->n_open == 0) return;
+    ezc_vm_addhook(vm, EZC_HOOK(perf_enter, perf_leave, perf));
+}
+
+/* reporting */
+
+// prints `num/den` as a rate per 1000, or `-` if not available
+static void perf_print_rate(FILE* out, ezc_perf* perf, int num, int den, const ezc_perf_vals* v) {
+    if (perf->fds[num] < 0 || perf->fds[den] < 0 || v->_[den] == 0) {
+        fprintf(out, " %10s", "-");
+    } else {
+        fprintf(out, " %10.3f", 1000.0 * v->_[num] / v->_[den]);
+    }
+}
+
+void ezc_perf_report(ezc_perf* perf, FILE* out) {
+    if (perf->n_open == 0) {
+        fprintf(out, "Hardware counters were not available\n");
+        return;
+    }
+
+    ezc_perf_vals now;
+    ezc_perf_read(perf, &now);
+
+    fprintf(out, "Performance counter stats:\n\n");
+    int i;
+    for (i = 0; i < EZC_PERF_N; ++i) {
+        if (perf->fds[i] < 0) {
+            fprintf(out, "  %20s  %s\n", "<not supported>", g_perf_names[i]);
+        } else {
+            fprintf(out, "  %20llu  %s\n", (unsigned long long)(now._[i] - perf->start._[i]), g_perf_names[i]);
+        }
+    }
+    if (perf->fds[EZC_PERF_CYCLES] >= 0 && perf->fds[EZC_PERF_INSTS] >= 0 && now._[EZC_PERF_CYCLES] > perf->start._[EZC_PERF_CYCLES]) {
+        fprintf(out, "  %20.3f  insts per cycle\n", (double)(now._[EZC_PERF_INSTS] - perf->start._[EZC_PERF_INSTS]) / (now._[EZC_PERF_CYCLES] - perf->start._[EZC_PERF_CYCLES]));
+    }
+
+    if (perf->funcs.n == 0) return;
+
+    // per function (self) counts
+    fprintf(out, "\nPer function (excluding callees; misses per 1000 instructions):\n\n");
+    fprintf(out, "  %-20s %10s %14s %14s %10s %10s %10s %10s\n", "function", "calls", "cycles", "instructions", "IPC", "br-miss", "L1d-miss", "LLC-miss");
+    for (i = 0; i < perf->funcs.n; ++i) {
+        ezc_perf_vals* v = &perf->funcs.self[i];
+        fprintf(out, "  %-20.*s %10d %14llu %14llu", perf->funcs.keys[i].len, perf->funcs.keys[i]._, perf->funcs.calls[i],
+            (unsigned long long)v->_[EZC_PERF_CYCLES], (unsigned long long)v->_[EZC_PERF_INSTS]);
+        if (perf->fds[EZC_PERF_CYCLES] < 0 || perf->fds[EZC_PERF_INSTS] < 0 || v->_[EZC_PERF_CYCLES] == 0) {
+            fprintf(out, " %10s", "-");
+        } else {
+            fprintf(out, " %10.3f", (double)v->_[EZC_PERF_INSTS] / v->_[EZC_PERF_CYCLES]);
+        }
+        perf_print_rate(out, perf, EZC_PERF_BRANCH_MISSES, EZC_PERF_INSTS, v);
+        perf_print_rate(out, perf, EZC_PERF_L1D_MISSES, EZC_PERF_INSTS, v);
+        perf_print_rate(out, perf, EZC_PERF_LLC_MISSES, EZC_PERF_INSTS, v);
+        fprintf(out, "\n");
+    }
+}
+
+void ezc_perf_close(ezc_perf* perf) {
+    int i;
+#ifdef __linux__
+    for (i = 0; i < EZC_PERF_N; ++i) {
+        if (perf->fds[i] >= 0) close(perf->fds[i]);
+        perf->fds[i] = -1;
+    }
+#endif
+    for (i = 0; i < perf->funcs.n; ++i) {
+        ezc_str_free(&perf->funcs.keys[i]);
+    }
+    ezc_free(perf->funcs.keys);
+    ezc_free(perf->funcs.calls);
+    ezc_free(perf->funcs.self);
+    ezc_free(perf->frames.start);
+    ezc_free(perf->frames.child);
+    memset(perf, 0, sizeof(*perf));
+    for (i = 0; i < EZC_PERF_N; ++i) perf->fds[i] = -1;
+}
@@ -0,0 +1,217 @@
+// ezc/pool.c - a work-stealing thread pool, which runs batches of
+//                independent tasks (i.e. the items of `pforeach!`)
+//
+// Each batch of tasks `[0, n)` is split evenly between the workers. A worker
+//   takes tasks from the front of its own range, and when it runs out, steals
+//   the back half of another worker's range, so a few slow tasks don't leave
+//   the other workers idle
+//
+// The thread which calls `ezc_pool_run` is worker 0, and helps with the batch
+//   instead of just waiting. If the pool is already busy (i.e. a `pforeach!`
+//   inside of a `pforeach!`), the tasks are just ran on the calling thread
+//
+// @author   : Cade Brown <cade@chemicaldevelopment.us>
+// @license  : WTFPL (http://www.wtfpl.net/)
+// @date     : 2019-12-07
+//
+
+// for sysconf
+#define _DEFAULT_SOURCE
+
+#include "ezc-impl.h"
+
+#include <unistd.h>
+
+// the argument for a worker thread
+typedef struct {
+    ezc_pool* pool;
+    int worker;
+} pool_arg;
+
+// returns the next task for `worker`, stealing from the others if it has run
+//   out, or -1 if there are no tasks left anywhere
+static int pool_take(ezc_pool* pool, int worker) {
+    ezc_pool_deque* own = &pool->deques[worker];
+    pthread_mutex_lock(&own->lock);
+    if (own->lo < own->hi) {
+        int task = own->lo++;
+        pthread_mutex_unlock(&own->lock);
+        return task;
+    }
+    pthread_mutex_unlock(&own->lock);
+
+    // start with the next worker, so thieves spread out
+    int i;
+    for (i = 1; i < pool->n_workers; ++i) {
+        ezc_pool_deque* other = &pool->deques[(worker + i) % pool->n_workers];
+        pthread_mutex_lock(&other->lock);
+        int n = other->hi - other->lo;
+        if (n > 0) {
+            // take the back half (at least 1), run the first task of it, and
+            //   keep the rest as our own range
+            int lo = other->hi - (n + 1) / 2, hi = other->hi;
+            other->hi = lo;
+            pthread_mutex_unlock(&other->lock);
+
+            pthread_mutex_lock(&own->lock);
+            own->lo = lo + 1;
+            own->hi = hi;
+            pthread_mutex_unlock(&own->lock);
+            return lo;
+        }
+        pthread_mutex_unlock(&other->lock);
+    }
+    return -1;
+}
+
+// runs tasks as `worker` until there are none left
+static void pool_work(ezc_pool* pool, int worker) {
+    int task;
+    while ((task = pool_take(pool, worker)) >= 0) {
+        pool->fn(pool->data, worker, task);
+    }
+}
+
+// the main loop of a worker thread, which sleeps until a batch starts
+static void* pool_main(void* _arg) {
+    pool_arg arg = *(pool_arg*)_arg;
+    ezc_free(_arg);
+    ezc_pool* pool = arg.pool;
+
+    unsigned seen = 0;
+    pthread_mutex_lock(&pool->lock);
+    while (true) {
+        while (!pool->quit && pool->gen == seen) {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+        if (pool->quit) break;
+        seen = pool->gen;
+        pthread_mutex_unlock(&pool->lock);
+
+        pool_work(pool, arg.worker);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->n_running == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+void ezc_pool_init(ezc_pool* pool, int n_workers) {
+    memset(pool, 0, sizeof(*pool));
+    if (n_workers < 1) n_workers = 1;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    pool->deques = ezc_malloc(sizeof(ezc_pool_deque) * n_workers);
+    pool->threads = ezc_malloc(sizeof(pthread_t) * n_workers);
+    pool->n_workers = 1;
+    pthread_mutex_init(&pool->deques[0].lock, NULL);
+    pool->deques[0].lo = pool->deques[0].hi = 0;
+
+    // start the threads, keeping however many could be started
+    while (pool->n_workers < n_workers) {
+        int w = pool->n_workers;
+        pthread_mutex_init(&pool->deques[w].lock, NULL);
+        pool->deques[w].lo = pool->deques[w].hi = 0;
+
+        pool_arg* arg = ezc_malloc(sizeof(pool_arg));
+        *arg = (pool_arg){ .pool = pool, .worker = w };
+        if (pthread_create(&pool->threads[w], NULL, pool_main, arg) != 0) {
+            ezc_warn("Couldn't start pool thread, using %d worker(s)", w);
+            pthread_mutex_destroy(&pool->deques[w].lock);
+            ezc_free(arg);
+            break;
+        }
+        pool->n_workers++;
+    }
+    ezc_debug("Started pool with %d worker(s)", pool->n_workers);
+}
+
+void ezc_pool_run(ezc_pool* pool, int n_tasks, ezc_pool_fn fn, void* data) {
+    int i;
+    int busy = 0;
+    if (pool->n_workers < 2 || n_tasks < 2 || !__atomic_compare_exchange_n(&pool->busy, &busy, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        // not worth (or not able to) use the other workers
+        for (i = 0; i < n_tasks; ++i) {
+            fn(data, 0, i);
+        }
+        return;
+    }
+
+    // split the tasks evenly
+    for (i = 0; i < pool->n_workers; ++i) {
+        pthread_mutex_lock(&pool->deques[i].lock);
+        pool->deques[i].lo = (int)((int64_t)n_tasks * i / pool->n_workers);
+        pool->deques[i].hi = (int)((int64_t)n_tasks * (i + 1) / pool->n_workers);
+        pthread_mutex_unlock(&pool->deques[i].lock);
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->fn = fn;
+    pool->data = data;
+    pool->n_running = pool->n_workers - 1;
+    pool->gen++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    // help out, then wait for the others to finish their last tasks
+    pool_work(pool, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->n_running > 0) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    __atomic_store_n(&pool->busy, 0, __ATOMIC_RELEASE);
+}
+
+void ezc_pool_free(ezc_pool* pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = true;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    int i;
+    for (i = 1; i < pool->n_workers; ++i) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    for (i = 0; i < pool->n_workers; ++i) {
+        pthread_mutex_destroy(&pool->deques[i].lock);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+
+    ezc_free(pool->deques);
+    ezc_free(pool->threads);
+    memset(pool, 0, sizeof(*pool));
+}
+
+/* the shared pool */
+
+// the number of workers requested for the shared pool (0 for one per CPU)
+static int g_pool_workers = 0;
+
+// the shared pool, which is started once, and lives until the process exits
+static ezc_pool g_pool;
+static pthread_once_t g_pool_once = PTHREAD_ONCE_INIT;
+
+static void pool_shared_init() {
+    int n = __atomic_load_n(&g_pool_workers, __ATOMIC_RELAXED);
+    if (n < 1) n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    ezc_pool_init(&g_pool, n);
+}
+
+void ezc_pool_set_workers(int n_workers) {
+    __atomic_store_n(&g_pool_workers, n_workers, __ATOMIC_RELAXED);
+}
+
+ezc_pool* ezc_pool_shared() {
+    pthread_once(&g_pool_once, pool_shared_init);
+    return &g_pool;
+}
@@ -0,0 +1,262 @@
+// ezc/prof.c - a sampling profiler for EZC programs, which attributes samples
+//                to the instruction currently executing, then annotates the
+//                source with where the time went
+//
+// Samples are taken either every N instructions (deterministic, and cheap),
+//   or from a SIGPROF timer, in which case the signal handler only bumps a
+//   counter, and the VM attributes it once the current instruction finishes
+//
+// @author   : Cade Brown <cade@chemicaldevelopment.us>
+// @license  : WTFPL (http://www.wtfpl.net/)
+// @date     : 2019-12-02
+//
+
+// for sigaction/setitimer
+#define _DEFAULT_SOURCE
+
+#include "ezc-impl.h"
+
+#include <signal.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+// number of timer samples which haven't been attributed to an instruction yet.
+//   Only accessed atomically (lock free, so it's safe in the signal handler),
+//   since the handler may interrupt the VM in the middle of taking them
+static int g_pending = 0;
+
+// the VM which owns the profiling timer (if any). The timer is per process,
+//   so only one VM (on any thread) may use it at a time
+static ezc_vm* g_timer_vm = NULL;
+
+// signal handler for SIGPROF, just record that a sample should be taken
+static void prof_sigprof(int sig) {
+    __atomic_add_fetch(&g_pending, 1, __ATOMIC_RELAXED);
+}
+
+// hashes the key of a profile entry
+static ezc_hash_t prof_hash(ezcp* prog, int line, int col) {
+    ezc_hash_t h = (ezc_hash_t)((uintptr_t)prog >> 4);
+    h = h * 31 + line;
+    h = h * 31 + col;
+    return h ^ (h >> 15);
+}
+
+// records `ct` samples for the instruction `inst`
+static void prof_record(ezc_vm* vm, ezci* inst, int ct) {
+    // keep the table at most half full, so probe sequences stay short
+    if (2 * (vm->prof.n + 1) > vm->prof.max_n) {
+        int old_max_n = vm->prof.max_n;
+        ezc_prof_ent* old_ents = vm->prof.ents;
+
+        vm->prof.max_n = old_max_n == 0 ? 256 : 2 * old_max_n;
+        vm->prof.ents = ezc_malloc(sizeof(ezc_prof_ent) * vm->prof.max_n);
+        memset(vm->prof.ents, 0, sizeof(ezc_prof_ent) * vm->prof.max_n);
+
+        // re-insert everything
+        int i;
+        for (i = 0; i < old_max_n; ++i) {
+            if (old_ents[i].prog == NULL) continue;
+            ezc_hash_t j = prof_hash(old_ents[i].prog, old_ents[i].line, old_ents[i].col) & (vm->prof.max_n - 1);
+            while (vm->prof.ents[j].prog != NULL) j = (j + 1) & (vm->prof.max_n - 1);
+            vm->prof.ents[j] = old_ents[i];
+        }
+        ezc_free(old_ents);
+    }
+
+    ezc_hash_t j = prof_hash(inst->m_prog, inst->m_line, inst->m_col) & (vm->prof.max_n - 1);
+    while (vm->prof.ents[j].prog != NULL) {
+        ezc_prof_ent* ent = &vm->prof.ents[j];
+        if (ent->prog == inst->m_prog && ent->line == inst->m_line && ent->col == inst->m_col) {
+            ent->count += ct;
+            vm->prof.n_samples += ct;
+            return;
+        }
+        j = (j + 1) & (vm->prof.max_n - 1);
+    }
+
+    // new entry, which keeps the program alive for the annotation
+    ezcp_incref(inst->m_prog);
+    vm->prof.ents[j] = (ezc_prof_ent){ .prog = inst->m_prog, .line = inst->m_line, .col = inst->m_col, .len = inst->m_len, .count = ct };
+    vm->prof.n++;
+    vm->prof.n_samples += ct;
+}
+
+void ezc_prof_start(ezc_vm* vm, int period) {
+    if (period < 1) period = 1;
+    vm->prof.mode = EZC_PROF_INSTS;
+    vm->prof.period = period;
+    vm->prof.left = period;
+}
+
+void ezc_prof_start_timer(ezc_vm* vm, int usec) {
+    ezc_vm* owner = NULL;
+    if (!__atomic_compare_exchange_n(&g_timer_vm, &owner, vm, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) && owner != vm) {
+        ezc_warn("Profiling timer is already in use by another VM");
+        return;
+    }
+    if (usec < 1) usec = 1;
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = prof_sigprof;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGPROF, &sa, NULL) != 0) {
+        ezc_warn("Couldn't install SIGPROF handler, profiling by instruction count instead");
+        __atomic_store_n(&g_timer_vm, NULL, __ATOMIC_RELEASE);
+        ezc_prof_start(vm, 1);
+        return;
+    }
+
+    struct itimerval it;
+    it.it_interval.tv_sec = usec / 1000000;
+    it.it_interval.tv_usec = usec % 1000000;
+    it.it_value = it.it_interval;
+
+    __atomic_store_n(&g_pending, 0, __ATOMIC_RELAXED);
+    vm->prof.mode = EZC_PROF_TIMER;
+    setitimer(ITIMER_PROF, &it, NULL);
+}
+
+void ezc_prof_stop(ezc_vm* vm) {
+    if (vm->prof.mode == EZC_PROF_TIMER) {
+        struct itimerval it;
+        memset(&it, 0, sizeof(it));
+        setitimer(ITIMER_PROF, &it, NULL);
+        signal(SIGPROF, SIG_DFL);
+        __atomic_store_n(&g_timer_vm, NULL, __ATOMIC_RELEASE);
+    }
+    vm->prof.mode = EZC_PROF_OFF;
+}
+
+void ezc_prof_tick(ezc_vm* vm, ezci* inst) {
+    if (vm->prof.mode == EZC_PROF_INSTS) {
+        if (--vm->prof.left <= 0) {
+            vm->prof.left = vm->prof.period;
+            prof_record(vm, inst, 1);
+        }
+    } else if (vm->prof.mode == EZC_PROF_TIMER) {
+        // (a plain load first, so most instructions don't write to it)
+        if (__atomic_load_n(&g_pending, __ATOMIC_RELAXED) > 0) {
+            int ct = __atomic_exchange_n(&g_pending, 0, __ATOMIC_RELAXED);
+            if (ct > 0) prof_record(vm, inst, ct);
+        }
+    }
+}
+
+// orders the programs samples were taken in. Programs without a source (i.e.
+//   the top level blocks of a stream, which each have their own) are ordered
+//   by name, so a stream is annotated all together
+static int prof_prog_cmp(ezcp* a, ezcp* b) {
+    if (a == b) return 0;
+    bool na = a->src._ == NULL, nb = b->src._ == NULL;
+    if (na != nb) return na ? 1 : -1;
+    if (na) return ezc_str_cmp(a->src_name, b->src_name);
+    return (uintptr_t)a < (uintptr_t)b ? -1 : 1;
+}
+
+// orders entries by program, then position
+static int prof_ent_cmp(const void* _a, const void* _b) {
+    const ezc_prof_ent* a = _a, * b = _b;
+    int c = prof_prog_cmp(a->prog, b->prog);
+    if (c != 0) return c;
+    if (a->line != b->line) return (int)a->line - (int)b->line;
+    return (int)a->col - (int)b->col;
+}
+
+// prints a single program's source, with entries `ents[0:n]` (all in this program)
+static void prof_annotate_prog(ezc_vm* vm, FILE* out, bool color, ezcp* prog, ezc_prof_ent* ents, int n) {
+    int prog_samples = 0, i;
+    for (i = 0; i < n; ++i) prog_samples += ents[i].count;
+
+    fprintf(out, "%s Percent |  Line | Source: %.*s (%d samples, %.2f%% of total)%s\n", color ? EC_BLD : "",
+        prog->src_name.len, prog->src_name._, prog_samples, 100.0 * prog_samples / vm->prof.n_samples, color ? EC_RST : "");
+    fprintf(out, "---------+-------+---------------------------------------\n");
+
+    if (prog->src._ == NULL) {
+        // the source wasn't retained, so just list the positions
+        for (i = 0; i < n; ++i) {
+            fprintf(out, " %6.2f%% | %5d | (col %d)\n", 100.0 * ents[i].count / vm->prof.n_samples, ents[i].line + 1, ents[i].col + 1);
+        }
+        fprintf(out, "\n");
+        return;
+    }
+
+    char* posp = prog->src._, * stop = prog->src._ + prog->src.len;
+    int line = 0, ei = 0;
+    while (posp < stop) {
+        char* linestart = posp;
+        while (posp < stop && *posp != '\n') posp++;
+        int linelen = (int)(posp - linestart);
+
+        // sum up the samples on this line
+        int line_ct = 0, ej = ei;
+        while (ej < n && ents[ej].line == line) line_ct += ents[ej++].count;
+
+        double pct = 100.0 * line_ct / vm->prof.n_samples;
+        if (line_ct > 0) {
+            fprintf(out, "%s %6.2f%%%s | %5d | %.*s\n", color ? (pct >= 5.0 ? EC_RED EC_BLD : EC_YLW) : "", pct, color ? EC_RST : "", line + 1, linelen, linestart);
+        } else {
+            fprintf(out, "         | %5d | %.*s\n", line + 1, linelen, linestart);
+        }
+
+        // now, mark each token sampled on this line
+        for (; ei < ej; ++ei) {
+            int j, tlen = ents[ei].len > 0 ? ents[ei].len : 1;
+            fprintf(out, "         |       | ");
+            for (j = 0; j < ents[ei].col && j < linelen; ++j) {
+                // keep tabs so the markers line up
+                fputc(linestart[j] == '\t' ? '\t' : ' ', out);
+            }
+            if (color) fprintf(out, EC_RED EC_BLD);
+            fputc('^', out);
+            for (j = 1; j < tlen; ++j) fputc('~', out);
+            fprintf(out, " %.2f%%%s\n", 100.0 * ents[ei].count / vm->prof.n_samples, color ? EC_RST : "");
+        }
+
+        line++;
+        // skip the newline
+        if (posp < stop) posp++;
+    }
+    fprintf(out, "\n");
+}
+
+void ezc_prof_annotate(ezc_vm* vm, FILE* out) {
+    if (vm->prof.n_samples == 0) {
+        fprintf(out, "No profiling samples were taken\n");
+        return;
+    }
+
+    // compact the hash table into a sorted list
+    ezc_prof_ent* ents = ezc_malloc(sizeof(ezc_prof_ent) * vm->prof.n);
+    int n = 0, i;
+    for (i = 0; i < vm->prof.max_n; ++i) {
+        if (vm->prof.ents[i].prog != NULL) ents[n++] = vm->prof.ents[i];
+    }
+    qsort(ents, n, sizeof(ezc_prof_ent), prof_ent_cmp);
+
+    bool color = isatty(fileno(out));
+
+    // annotate each program
+    int start = 0;
+    for (i = 1; i <= n; ++i) {
+        if (i == n || prof_prog_cmp(ents[i].prog, ents[start].prog) != 0) {
+            prof_annotate_prog(vm, out, color, ents[start].prog, ents + start, i - start);
+            start = i;
+        }
+    }
+
+    ezc_free(ents);
+}
+
+void ezc_prof_free(ezc_vm* vm) {
+    ezc_prof_stop(vm);
+    int i;
+    for (i = 0; i < vm->prof.max_n; ++i) {
+        if (vm->prof.ents[i].prog != NULL) ezcp_decref(vm->prof.ents[i].prog);
+    }
+    ezc_free(vm->prof.ents);
+    vm->prof.ents = NULL;
+    vm->prof.n = vm->prof.max_n = vm->prof.n_samples = 0;
+}
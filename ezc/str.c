@@ -2,11 +2,24 @@
 #include "ezc-impl.h"
 
 
+// resizes `str` to hold `max_len` characters (and the NUL). A borrowed string
+//   (see EZC_STR_BORROW) gets memory of its own, with its contents copied
+static void str_resize(ezc_str* str, int max_len) {
+    if (str->max_len < 0) {
+        char* from = str->_;
+        str->_ = ezc_malloc(max_len + 1);
+        ezc_memcpy(str->_, from, str->len);
+        // it doesn't need what it borrowed from anymore
+        if (EZC_STR_MAP(*str) >= 0) ezc_file_map_decref(EZC_STR_MAP(*str));
+    } else {
+        str->_ = ezc_realloc(str->_, max_len + 1);
+    }
+    str->max_len = max_len;
+}
 
 void ezc_str_copy_cp(ezc_str* str, char* charp, int len) {
     if (str->_ == NULL || str->max_len < len) {
-        str->max_len = (int)(1.5 * len + 10);
-        str->_ = ezc_realloc(str->_, str->max_len + 1);
+        str_resize(str, (int)(1.5 * len + 10));
     }
     str->len = len;
     ezc_memcpy(str->_, charp, len);
@@ -22,8 +35,7 @@ void ezc_str_append(ezc_str* str, ezc_str A) {
     int start_len = str->len;
     int new_len = str->len + A.len;
     if (str->_ == NULL || str->max_len < new_len) {
-        str->max_len = (int)(1.5 * new_len + 10);
-        str->_ = ezc_realloc(str->_, str->max_len + 1);
+        str_resize(str, (int)(1.5 * new_len + 10));
     }
     str->len = new_len;
     //ezc_memcpy(str->_, A._, A.len);
@@ -35,8 +47,7 @@ void ezc_str_append(ezc_str* str, ezc_str A) {
 void ezc_str_concat(ezc_str* str, ezc_str A, ezc_str B) {
     int new_len = A.len + B.len;
     if (str->_ == NULL || str->max_len < new_len) {
-        str->max_len = (int)(1.5 * new_len + 10);
-        str->_ = ezc_realloc(str->_, str->max_len + 1);
+        str_resize(str, (int)(1.5 * new_len + 10));
     }
     str->len = new_len;
     ezc_memcpy(str->_, A._, A.len);
@@ -45,11 +56,10 @@ void ezc_str_concat(ezc_str* str, ezc_str A, ezc_str B) {
 }
 
 void ezc_str_append_c(ezc_str* str, char c) {
-    str->len++;
-    if (str->_ == NULL || str->max_len < str->len) {
-        str->max_len = str->len;
-        str->_ = ezc_realloc(str->_, str->max_len + 1);
+    if (str->_ == NULL || str->max_len < str->len + 1) {
+        str_resize(str, str->len + 1);
     }
+    str->len++;
     str->_[str->len-1] = c;
     str->_[str->len] = '\0';
 }
@@ -58,8 +68,18 @@ int ezc_str_cmp(ezc_str A, ezc_str B) {
     return (A.len == B.len) ? memcmp(A._, B._, A.len) : A.len - B.len;
 }
 
+void ezc_str_own(ezc_str* str) {
+    if (str->max_len < 0) {
+        str_resize(str, str->len);
+        str->_[str->len] = '\0';
+    }
+}
+
 void ezc_str_free(ezc_str* str) {
-    ezc_free(str->_);
+    // borrowed strings aren't ours to free, but may hold a reference to what
+    //   they borrow from
+    if (str->max_len >= 0) ezc_free(str->_);
+    else if (EZC_STR_MAP(*str) >= 0) ezc_file_map_decref(EZC_STR_MAP(*str));
 
     // reset it
     *str = EZC_STR_NULL;
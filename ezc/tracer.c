@@ -0,0 +1,171 @@
+// ezc/tracer.c - records spans (user functions, top level programs) and
+//                  counters (stack depth, live memory) and exports them in the
+//                  Chrome trace event format
+//
+// Events are buffered in memory, and only written out in `ezc_tracer_write`,
+//   so tracing doesn't add any I/O while the program is running. The output
+//   can be loaded by chrome://tracing, or https://ui.perfetto.dev
+//
+// A tracer may be attached to VMs on different threads; events are recorded
+//   under a lock, and each thread shows up as its own track (`tid`)
+//
+// Live memory is counted from when the first tracer is initialized (see
+//   `ezc_mem_count_start`), so allocations are cheaper when nothing is traced
+//
+// @author   : Cade Brown <cade@chemicaldevelopment.us>
+// @license  : WTFPL (http://www.wtfpl.net/)
+// @date     : 2019-12-04
+//
+
+#include "ezc-impl.h"
+
+// names of the counters recorded for a VM
+#define TRACER_STACK  "stack depth"
+#define TRACER_MEMORY "live memory"
+
+// returns the index of `name` in the tracer's names, adding it if it's new
+static int tracer_name(ezc_tracer* tr, ezc_str name) {
+    // search from the end, since recently used names are the most likely
+    int i;
+    for (i = tr->names.n - 1; i >= 0; --i) {
+        if (ezc_str_eq(name, tr->names.keys[i])) return i;
+    }
+    i = tr->names.n++;
+    tr->names.keys = ezc_realloc(tr->names.keys, sizeof(ezc_str) * tr->names.n);
+    tr->names.keys[i] = EZC_STR_NULL;
+    ezc_str_copy(&tr->names.keys[i], name);
+    return i;
+}
+
+// returns the tid of the calling thread, adding it if it's new
+static int tracer_tid(ezc_tracer* tr) {
+    pthread_t self = pthread_self();
+    int i;
+    for (i = 0; i < tr->tids.n; ++i) {
+        if (pthread_equal(self, tr->tids.vals[i])) return i + 1;
+    }
+    i = tr->tids.n++;
+    tr->tids.vals = ezc_realloc(tr->tids.vals, sizeof(pthread_t) * tr->tids.n);
+    tr->tids.vals[i] = self;
+    return i + 1;
+}
+
+// adds an event to the buffer (the lock must be held)
+static void tracer_add(ezc_tracer* tr, char ph, ezc_str name, int64_t val) {
+    int idx = tr->evs.n++;
+    if (tr->evs.n > tr->evs.max_n) {
+        tr->evs.max_n = (int)(1.5 * tr->evs.n + 1024);
+        tr->evs.vals = ezc_realloc(tr->evs.vals, sizeof(ezc_tracer_ev) * tr->evs.max_n);
+    }
+    tr->evs.vals[idx] = (ezc_tracer_ev){ .ph = ph, .name = tracer_name(tr, name), .ts = 1.0e6 * (ezc_time() - tr->t0), .val = val, .tid = tracer_tid(tr) };
+}
+
+// records the counters for a VM (the lock must be held)
+static void tracer_counters(ezc_tracer* tr, ezc_vm* vm) {
+    tracer_add(tr, 'C', EZC_STR_CONST(TRACER_STACK), vm->stk.n);
+    tracer_add(tr, 'C', EZC_STR_CONST(TRACER_MEMORY), ezc_mem_live());
+}
+
+void ezc_tracer_init(ezc_tracer* tr) {
+    memset(tr, 0, sizeof(*tr));
+    tr->t0 = ezc_time();
+    pthread_mutex_init(&tr->lock, NULL);
+    ezc_mem_count_start();
+}
+
+void ezc_tracer_begin(ezc_tracer* tr, ezc_vm* vm, ezc_str name) {
+    pthread_mutex_lock(&tr->lock);
+    if (vm != NULL) tracer_counters(tr, vm);
+    tracer_add(tr, 'B', name, 0);
+    pthread_mutex_unlock(&tr->lock);
+}
+
+void ezc_tracer_end(ezc_tracer* tr, ezc_vm* vm, ezc_str name) {
+    pthread_mutex_lock(&tr->lock);
+    tracer_add(tr, 'E', name, 0);
+    if (vm != NULL) tracer_counters(tr, vm);
+    pthread_mutex_unlock(&tr->lock);
+}
+
+void ezc_tracer_counter(ezc_tracer* tr, ezc_str name, int64_t val) {
+    pthread_mutex_lock(&tr->lock);
+    tracer_add(tr, 'C', name, val);
+    pthread_mutex_unlock(&tr->lock);
+}
+
+static void tracer_enter(ezc_vm* vm, ezc_str name, void* data) {
+    ezc_tracer_begin((ezc_tracer*)data, vm, name);
+}
+
+static void tracer_leave(ezc_vm* vm, ezc_str name, void* data) {
+    ezc_tracer_end((ezc_tracer*)data, vm, name);
+}
+
+void ezc_tracer_attach(ezc_tracer* tr, ezc_vm* vm) {
+    ezc_vm_addhook(vm, EZC_HOOK(tracer_enter, tracer_leave, tr));
+}
+
+// writes a string as a JSON string literal
+static void tracer_write_str(FILE* fp, ezc_str str) {
+    fputc('"', fp);
+    int i;
+    for (i = 0; i < str.len; ++i) {
+        unsigned char c = str._[i];
+        if (c == '"' || c == '\\') {
+            fputc('\\', fp);
+            fputc(c, fp);
+        } else if (c < 0x20) {
+            fprintf(fp, "\\u%04x", c);
+        } else {
+            fputc(c, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+int ezc_tracer_write(ezc_tracer* tr, const char* fname) {
+    FILE* fp = fopen(fname, "w");
+    if (fp == NULL) {
+        ezc_error("Couldn't open trace output '%s'", fname);
+        return 1;
+    }
+
+    pthread_mutex_lock(&tr->lock);
+    fprintf(fp, "{\"traceEvents\":[\n");
+    int i;
+    for (i = 0; i < tr->evs.n; ++i) {
+        ezc_tracer_ev* ev = &tr->evs.vals[i];
+        fprintf(fp, "{\"name\":");
+        tracer_write_str(fp, tr->names.keys[ev->name]);
+        fprintf(fp, ",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d", ev->ph, ev->ts, ev->tid);
+        if (ev->ph == 'C') {
+            fprintf(fp, ",\"args\":{\"value\":%lld}", (long long)ev->val);
+        }
+        fprintf(fp, i < tr->evs.n - 1 ? "},\n" : "}\n");
+    }
+    fprintf(fp, "],\"displayTimeUnit\":\"ms\"}\n");
+    int n_evs = tr->evs.n;
+    pthread_mutex_unlock(&tr->lock);
+
+    int status = ferror(fp) ? 1 : 0;
+    if (fclose(fp) != 0) status = 1;
+    if (status != 0) {
+        ezc_error("Failed writing trace output '%s'", fname);
+    } else {
+        ezc_debug("Wrote %d trace events to '%s'", n_evs, fname);
+    }
+    return status;
+}
+
+void ezc_tracer_free(ezc_tracer* tr) {
+    int i;
+    for (i = 0; i < tr->names.n; ++i) {
+        ezc_str_free(&tr->names.keys[i]);
+    }
+    ezc_free(tr->names.keys);
+    ezc_free(tr->evs.vals);
+    ezc_free(tr->tids.vals);
+    pthread_mutex_destroy(&tr->lock);
+    memset(tr, 0, sizeof(*tr));
+    ezc_mem_count_stop();
+}
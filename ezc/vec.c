@@ -0,0 +1,185 @@
+// ezc/vec.c - vectorized kernels for arithmetic on packed arrays (see
+//               `ezc_array`)
+//
+// The loops are written so the compiler can vectorize them, and are compiled
+//   twice on x86: once for the baseline (SSE2 on x86_64), and once for AVX2.
+//   Which one is used is decided at runtime, based on what the CPU supports,
+//   so the same binary runs everywhere
+//
+// Each operation has three loops: array op array, array op scalar, and
+//   scalar op array, so the scalar can be kept in a register
+//
+// Integer arithmetic wraps around on overflow (it is done unsigned, so this is
+//   well defined), since an array can't hold `zint`s. Dividing by 0 is checked
+//   by the caller
+//
+// Reductions keep 8 independent accumulators, which the compiler turns into
+//   vector registers (a single accumulator can't be vectorized without
+//   reassociating floating point math). Sums of reals are also split in half
+//   recursively (pairwise summation), which is nearly as accurate as Kahan
+//   summation, but just as fast as a plain loop
+//
+// @author   : Cade Brown <cade@chemicaldevelopment.us>
+// @license  : WTFPL (http://www.wtfpl.net/)
+// @date     : 2019-12-08
+//
+
+#include "ezc-impl.h"
+
+#include <math.h>
+
+// whether the AVX2 versions are compiled (they require GCC/clang on x86)
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VEC_HAVE_AVX2
+#endif
+
+// integer power, with the same rules as `pow!` (negative powers are 0)
+static inline ezc_int vec_ipow(ezc_int a, ezc_int b) {
+    // unsigned, so overflow wraps instead of being undefined
+    uint64_t r = 1, ua = (uint64_t)a;
+    if (b < 0) return 0;
+    while (b > 0) {
+        if (b & 1) r *= ua;
+        ua *= ua;
+        b >>= 1;
+    }
+    return (ezc_int)r;
+}
+
+// the number of reals summed directly, before splitting in half (must be a
+//   multiple of 8)
+#define VEC_PAIRWISE_BLOCK 128
+
+// returns the reduction of `a[0:n]`, where `_step` combines the accumulator
+//   `x` with the next value `y`, and `_init` is the identity
+#define VEC_REDUCE(_T, _init, _step) { \
+    _T acc[8], x, y; \
+    int i, j; \
+    for (j = 0; j < 8; ++j) acc[j] = (_init); \
+    for (i = 0; i + 8 <= n; i += 8) { \
+        for (j = 0; j < 8; ++j) { x = acc[j]; y = (_T)a[i + j]; acc[j] = (_step); } \
+    } \
+    for (; i < n; ++i) { x = acc[0]; y = (_T)a[i]; acc[0] = (_step); } \
+    x = acc[0]; \
+    for (j = 1; j < 8; ++j) { y = acc[j]; x = (_step); } \
+    return x; \
+}
+
+// runs `_expr` (of `x` and `y`) for every element, with the three cases of
+//   which side is a scalar
+#define VEC_LOOP(_expr) { \
+    int i; \
+    if (sa) { \
+        _T x = a[0]; \
+        for (i = 0; i < n; ++i) { _T y = b[i]; r[i] = (_expr); } \
+    } else if (sb) { \
+        _T y = b[0]; \
+        for (i = 0; i < n; ++i) { _T x = a[i]; r[i] = (_expr); } \
+    } else { \
+        for (i = 0; i < n; ++i) { _T x = a[i], y = b[i]; r[i] = (_expr); } \
+    } \
+}
+
+// defines the kernels for reals, and for ints, with a given suffix and
+//   attributes (i.e. the target ISA)
+#define VEC_KERNELS(_sfx, _attr) \
+_attr static void vec_real##_sfx(int op, int n, ezc_real* r, const ezc_real* a, bool sa, const ezc_real* b, bool sb) { \
+    typedef ezc_real _T; \
+    switch (op) { \
+        case EZC_VEC_ADD: VEC_LOOP(x + y); break; \
+        case EZC_VEC_SUB: VEC_LOOP(x - y); break; \
+        case EZC_VEC_MUL: VEC_LOOP(x * y); break; \
+        case EZC_VEC_DIV: VEC_LOOP(x / y); break; \
+        case EZC_VEC_POW: VEC_LOOP(pow(x, y)); break; \
+        case EZC_VEC_MIN: VEC_LOOP(y < x ? y : x); break; \
+        case EZC_VEC_MAX: VEC_LOOP(y > x ? y : x); break; \
+    } \
+} \
+_attr static void vec_int##_sfx(int op, int n, ezc_int* r, const ezc_int* a, bool sa, const ezc_int* b, bool sb) { \
+    typedef ezc_int _T; \
+    switch (op) { \
+        case EZC_VEC_ADD: VEC_LOOP((_T)((uint64_t)x + (uint64_t)y)); break; \
+        case EZC_VEC_SUB: VEC_LOOP((_T)((uint64_t)x - (uint64_t)y)); break; \
+        case EZC_VEC_MUL: VEC_LOOP((_T)((uint64_t)x * (uint64_t)y)); break; \
+        case EZC_VEC_DIV: VEC_LOOP(y == -1 ? (_T)(0 - (uint64_t)x) : x / y); break; \
+        case EZC_VEC_POW: VEC_LOOP(vec_ipow(x, y)); break; \
+        case EZC_VEC_MIN: VEC_LOOP(y < x ? y : x); break; \
+        case EZC_VEC_MAX: VEC_LOOP(y > x ? y : x); break; \
+    } \
+} \
+_attr static void vec_itor##_sfx(int n, ezc_real* r, const ezc_int* a) { \
+    int i; \
+    for (i = 0; i < n; ++i) r[i] = (ezc_real)a[i]; \
+} \
+_attr static ezc_real vec_reduce_real##_sfx(int op, int n, const ezc_real* a) { \
+    if (op == EZC_VEC_ADD && n > VEC_PAIRWISE_BLOCK) { \
+        int h = (n / 2) & ~7; \
+        return vec_reduce_real##_sfx(op, h, a) + vec_reduce_real##_sfx(op, n - h, a + h); \
+    } \
+    switch (op) { \
+        case EZC_VEC_ADD: VEC_REDUCE(ezc_real, 0.0, x + y); \
+        case EZC_VEC_MUL: VEC_REDUCE(ezc_real, 1.0, x * y); \
+        case EZC_VEC_MIN: VEC_REDUCE(ezc_real, INFINITY, y < x ? y : x); \
+        case EZC_VEC_MAX: VEC_REDUCE(ezc_real, -INFINITY, y > x ? y : x); \
+    } \
+    return 0.0; \
+} \
+_attr static ezc_int vec_reduce_int##_sfx(int op, int n, const ezc_int* a) { \
+    switch (op) { \
+        case EZC_VEC_ADD: VEC_REDUCE(uint64_t, 0, x + y); \
+        case EZC_VEC_MUL: VEC_REDUCE(uint64_t, 1, x * y); \
+        case EZC_VEC_MIN: VEC_REDUCE(ezc_int, INT64_MAX, y < x ? y : x); \
+        case EZC_VEC_MAX: VEC_REDUCE(ezc_int, INT64_MIN, y > x ? y : x); \
+    } \
+    return 0; \
+}
+
+VEC_KERNELS(_base, )
+
+#ifdef VEC_HAVE_AVX2
+
+VEC_KERNELS(_avx2, __attribute__((target("avx2"))))
+
+// -1 if not checked yet, otherwise whether the CPU supports AVX2
+static int g_avx2 = -1;
+
+static bool vec_avx2() {
+    int res = __atomic_load_n(&g_avx2, __ATOMIC_RELAXED);
+    if (res < 0) {
+        __builtin_cpu_init();
+        res = __builtin_cpu_supports("avx2") ? 1 : 0;
+        __atomic_store_n(&g_avx2, res, __ATOMIC_RELAXED);
+        ezc_debug("Using %s kernels for arrays", res ? "AVX2" : "baseline");
+    }
+    return res != 0;
+}
+
+#define VEC_DISPATCH(_name, ...) { if (vec_avx2()) _name##_avx2(__VA_ARGS__); else _name##_base(__VA_ARGS__); }
+#define VEC_DISPATCH_RET(_name, ...) { if (vec_avx2()) return _name##_avx2(__VA_ARGS__); else return _name##_base(__VA_ARGS__); }
+
+#else
+
+#define VEC_DISPATCH(_name, ...) { _name##_base(__VA_ARGS__); }
+#define VEC_DISPATCH_RET(_name, ...) { return _name##_base(__VA_ARGS__); }
+
+#endif
+
+void ezc_vec_real(int op, int n, ezc_real* r, const ezc_real* a, bool sa, const ezc_real* b, bool sb) {
+    VEC_DISPATCH(vec_real, op, n, r, a, sa, b, sb);
+}
+
+void ezc_vec_int(int op, int n, ezc_int* r, const ezc_int* a, bool sa, const ezc_int* b, bool sb) {
+    VEC_DISPATCH(vec_int, op, n, r, a, sa, b, sb);
+}
+
+void ezc_vec_itor(int n, ezc_real* r, const ezc_int* a) {
+    VEC_DISPATCH(vec_itor, n, r, a);
+}
+
+ezc_real ezc_vec_reduce_real(int op, int n, const ezc_real* a) {
+    VEC_DISPATCH_RET(vec_reduce_real, op, n, a);
+}
+
+ezc_int ezc_vec_reduce_int(int op, int n, const ezc_int* a) {
+    VEC_DISPATCH_RET(vec_reduce_int, op, n, a);
+}
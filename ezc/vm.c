@@ -1,8 +1,68 @@
 
 #include "ezc-impl.h"
 
+void ezc_vm_init_shared(ezc_vm* vm, ezc_vm* from) {
+    *vm = EZC_VM_EMPTY;
+
+    // the tables are copied (so each VM can define more of its own), but the
+    //   values are shallow, so functions written in EZC still point at the
+    //   bodies in `from`'s programs, which are never modified after compiling
+    vm->types.n = from->types.n;
+    vm->types.keys = ezc_malloc(sizeof(ezc_str) * from->types.n);
+    vm->types.vals = ezc_malloc(sizeof(ezct) * from->types.n);
+    int i;
+    for (i = 0; i < from->types.n; ++i) {
+        vm->types.keys[i] = EZC_STR_NULL;
+        ezc_str_copy(&vm->types.keys[i], from->types.keys[i]);
+        vm->types.vals[i] = from->types.vals[i];
+    }
+
+    vm->funcs.n = from->funcs.n;
+    vm->funcs.keys = ezc_malloc(sizeof(ezc_str) * from->funcs.n);
+    vm->funcs.vals = ezc_malloc(sizeof(ezc_func) * from->funcs.n);
+    for (i = 0; i < from->funcs.n; ++i) {
+        vm->funcs.keys[i] = EZC_STR_NULL;
+        ezc_str_copy(&vm->funcs.keys[i], from->funcs.keys[i]);
+        vm->funcs.vals[i] = from->funcs.vals[i];
+        if (vm->funcs.vals[i].type == EZC_FUNC_TYPE_EZC) ezcp_incref(vm->funcs.vals[i]._ezc.m_prog);
+    }
+
+    // the tables are in the same order, so so are the builtins
+    memcpy(vm->builtins, from->builtins, sizeof(vm->builtins));
+
+    vm->zreal_prec = from->zreal_prec;
+    vm->out.mode = from->out.mode;
+}
+
 void ezc_vm_free(ezc_vm* vm) {
+    ezc_out_free(vm);
+
+    // free what's left on the stack (which may hold blocks, and so programs)
+    int i;
+    for (i = 0; i < vm->stk.n; ++i) {
+        if (vm->stk.base[i].type < vm->types.n) ezc_obj_free(vm, &vm->stk.base[i]);
+    }
     ezc_stk_free(&vm->stk);
+    ezc_prof_free(vm);
+    ezc_free(vm->hooks.vals);
+    vm->hooks.vals = NULL;
+    vm->hooks.n = 0;
+
+    for (i = 0; i < vm->types.n; ++i) {
+        ezc_str_free(&vm->types.keys[i]);
+    }
+    ezc_free(vm->types.keys);
+    ezc_free(vm->types.vals);
+    for (i = 0; i < vm->funcs.n; ++i) {
+        ezc_str_free(&vm->funcs.keys[i]);
+        if (vm->funcs.vals[i].type == EZC_FUNC_TYPE_EZC) ezcp_decref(vm->funcs.vals[i]._ezc.m_prog);
+    }
+    ezc_free(vm->funcs.keys);
+    ezc_free(vm->funcs.vals);
+    vm->types.n = vm->funcs.n = 0;
+    vm->types.keys = vm->funcs.keys = NULL;
+    vm->types.vals = NULL;
+    vm->funcs.vals = NULL;
 }
 
 
@@ -14,6 +74,8 @@ int ezc_vm_addfunc(ezc_vm* vm, ezc_str name, ezc_func func) {
     vm->funcs.keys[idx] = EZC_STR_NULL;
     ezc_str_copy(vm->funcs.keys + idx, name);
 
+    // functions written in EZC keep the program they were compiled in alive
+    if (func.type == EZC_FUNC_TYPE_EZC) ezcp_incref(func._ezc.m_prog);
     vm->funcs.vals[idx] = func;
 
     return idx; 
@@ -31,6 +93,83 @@ int ezc_vm_addtype(ezc_vm* vm, ezc_str name, ezct type) {
     return idx; 
 }
 
+int ezc_obj_copy(ezc_vm* vm, ezc_obj* obj, ezc_obj* from) {
+    ezct* T = &vm->types.vals[from->type];
+    if (!T->shared) {
+        obj->type = from->type;
+        obj->_rc = NULL;
+        return T->f_copy(obj, from);
+    }
+
+    // the count is allocated on the first copy, so objects which are never
+    //   copied don't pay for it. Copies may be freed on other threads (i.e.
+    //   items of `pforeach!`), so it's atomic
+    if (from->_rc == NULL) {
+        from->_rc = ezc_malloc(sizeof(int));
+        *from->_rc = 2;
+    } else {
+        __atomic_add_fetch(from->_rc, 1, __ATOMIC_RELAXED);
+    }
+    *obj = *from;
+    return 0;
+}
+
+int ezc_obj_free(ezc_vm* vm, ezc_obj* obj) {
+    int status = 0;
+    if (obj->_rc != NULL) {
+        if (__atomic_sub_fetch(obj->_rc, 1, __ATOMIC_ACQ_REL) == 0) {
+            ezc_free(obj->_rc);
+            obj->_rc = NULL;
+            status = vm->types.vals[obj->type].f_free(obj);
+        }
+    } else {
+        status = vm->types.vals[obj->type].f_free(obj);
+    }
+    obj->_rc = NULL;
+    return status;
+}
+
+int ezc_obj_unshare(ezc_vm* vm, ezc_obj* obj) {
+    if (obj->_rc == NULL) return 0;
+
+    if (__atomic_load_n(obj->_rc, __ATOMIC_ACQUIRE) == 1) {
+        // the others are gone, so it's ours already
+        ezc_free(obj->_rc);
+        obj->_rc = NULL;
+        return 0;
+    }
+
+    ezc_obj own = (ezc_obj){ .type = obj->type, ._rc = NULL };
+    int status = vm->types.vals[obj->type].f_copy(&own, obj);
+
+    // let go of the shared one (which may have been the last, if the others
+    //   were freed in the meantime)
+    ezc_obj_free(vm, obj);
+    *obj = own;
+    return status;
+}
+
+int ezc_vm_addhook(ezc_vm* vm, ezc_hook hook) {
+    int idx = vm->hooks.n++;
+    vm->hooks.vals = ezc_realloc(vm->hooks.vals, sizeof(ezc_hook) * vm->hooks.n);
+    vm->hooks.vals[idx] = hook;
+    return idx;
+}
+
+void ezc_vm_hook_enter(ezc_vm* vm, ezc_str name) {
+    int i;
+    for (i = 0; i < vm->hooks.n; ++i) {
+        if (vm->hooks.vals[i].f_enter != NULL) vm->hooks.vals[i].f_enter(vm, name, vm->hooks.vals[i].data);
+    }
+}
+
+void ezc_vm_hook_leave(ezc_vm* vm, ezc_str name) {
+    int i;
+    for (i = vm->hooks.n - 1; i >= 0; --i) {
+        if (vm->hooks.vals[i].f_leave != NULL) vm->hooks.vals[i].f_leave(vm, name, vm->hooks.vals[i].data);
+    }
+}
+
 // returns index of function, or -1
 int ezc_vm_getfunci(ezc_vm* vm, ezc_str name) {
     int i;